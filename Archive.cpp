@@ -0,0 +1,400 @@
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <zlib.h>
+
+#include "include/Archive.hpp"
+#include "include/Profile.hpp"
+#include "include/Tools.hpp"
+
+using namespace dbtool; 
+
+static unsigned GetLittle16 (const std::string& data, std::size_t offset) {
+	return static_cast<unsigned char>(data[offset]) | (static_cast<unsigned char>(data[offset + 1]) << 8); 
+}
+
+static unsigned GetLittle32 (const std::string& data, std::size_t offset) {
+	return GetLittle16(data, offset) | (GetLittle16(data, offset + 2) << 16); 
+}
+
+static void PutLittle16 (std::string& data, unsigned value) {
+	data += static_cast<char>(value & 0xFF); 
+	data += static_cast<char>((value >> 8) & 0xFF); 
+}
+
+static void PutLittle32 (std::string& data, unsigned value) {
+	PutLittle16(data, value & 0xFFFF); 
+	PutLittle16(data, value >> 16); 
+}
+
+static bool Inflate (const char* data, unsigned size, unsigned expected, std::string& out) {
+	out.resize(expected); 
+	uLongf length = expected; 
+	if (expected == 0) {
+		return true; 
+	}
+	return (uncompress(reinterpret_cast<Bytef*>(&out[0]), &length, reinterpret_cast<const Bytef*>(data), size) == Z_OK) && (length == expected); 
+}
+
+static bool Deflate (const std::string& in, std::string& out) {
+	uLongf length = compressBound(in.size()); 
+	out.resize(length); 
+	if (compress2(reinterpret_cast<Bytef*>(&out[0]), &length, reinterpret_cast<const Bytef*>(in.data()), in.size(), Z_DEFAULT_COMPRESSION) != Z_OK) {
+		return false; 
+	}
+	out.resize(length); 
+	return true; 
+}
+
+// A stream that happens to be as long as its content would read as stored, so it is stored as is
+static bool Pack (const std::string& in, std::string& out, bool compress) {
+	if ((compress == true) && (!Deflate(in, out))) {
+		return false; 
+	}
+	if ((compress == false) || (out.size() == in.size())) {
+		out = in; 
+	}
+	return true; 
+}
+
+Archive::Archive ()
+	:m_entryList(), m_entryIndex(), m_chunkList(), m_listFilename(), m_imageFilename(), m_image() {} 
+Archive::~Archive () {} 
+
+bool Archive::open (const std::string& listFilename, const std::string& imageFilename) {
+	Print("Reading archive file list \"%s\"...", listFilename.c_str()); 
+	PrintStart(); 
+	this->m_entryList.clear(); 
+	this->m_entryIndex.clear(); 
+	this->m_chunkList.clear(); 
+	this->m_image.close(); 
+	this->m_listFilename = listFilename; 
+	this->m_imageFilename = imageFilename; 
+	
+	std::string list; 
+	if (!ReadWholeFile(listFilename, list)) {
+		PrintError("Couldn't open file \"%s\".", listFilename.c_str()); 
+		PrintAbort(); 
+		return false; 
+	}
+	
+	unsigned chunkTable = (list.size() >= 12)? GetLittle32(list, 0) : 0; 
+	unsigned chunkData = (list.size() >= 12)? GetLittle32(list, 4) : 0; 
+	unsigned count = (list.size() >= 12)? GetLittle32(list, 8) : 0; 
+	if ((list.size() < 12) || (chunkTable < 12 + count * 8ULL) || (chunkData < chunkTable) || (chunkData > list.size())) {
+		PrintError("Invalid file list header."); 
+		PrintAbort(); 
+		return false; 
+	}
+	
+	std::vector<std::string> paths((chunkData - chunkTable) / 12); 
+	for (unsigned i = 0 ; i < paths.size() ; i++) {
+		unsigned size = GetLittle32(list, chunkTable + i * 12); 
+		unsigned compressedSize = GetLittle32(list, chunkTable + i * 12 + 4); 
+		unsigned long long offset = chunkData + static_cast<unsigned long long>(GetLittle32(list, chunkTable + i * 12 + 8)); 
+		if (offset + compressedSize > list.size()) {
+			PrintError("Chunk %u is out of the file list.", i); 
+			PrintAbort(); 
+			return false; 
+		}
+		
+		PathChunk chunk; 
+		chunk.data = list.substr(offset, compressedSize); 
+		chunk.size = size; 
+		chunk.modified = false; 
+		if (size == compressedSize) {
+			paths[i] = chunk.data; 
+		} else if (!Inflate(chunk.data.data(), compressedSize, size, paths[i])) {
+			PrintError("Couldn't decompress chunk %u.", i); 
+			PrintAbort(); 
+			return false; 
+		}
+		this->m_chunkList.push_back(chunk); 
+	}
+	
+	this->m_entryList.resize(count); 
+	for (unsigned i = 0 ; i < count ; i++) {
+		Entry& entry = this->m_entryList[i]; 
+		entry.code = GetLittle32(list, 12 + i * 8); 
+		entry.pathOffset = GetLittle16(list, 12 + i * 8 + 4); 
+		entry.chunk = GetLittle16(list, 12 + i * 8 + 6); 
+		if ((entry.chunk >= paths.size()) || (entry.pathOffset >= paths[entry.chunk].size())) {
+			PrintError("Path of file %u is out of the file list.", i); 
+			PrintAbort(); 
+			return false; 
+		}
+		
+		const char* info = paths[entry.chunk].c_str() + entry.pathOffset; 
+		int length = 0; 
+		if (sscanf(info, "%x:%x:%x:%n", &entry.position, &entry.size, &entry.compressedSize, &length) != 3) {
+			PrintError("Invalid path \"%s\" for file %u.", info, i); 
+			PrintAbort(); 
+			return false; 
+		}
+		entry.path = info + length; 
+		this->m_entryIndex[entry.path] = i; 
+	}
+	
+	Print("%u files found.", count); 
+	PrintDone(); 
+	return true; 
+}
+
+bool Archive::import (const std::list<std::string>& files, const std::string& folder) {
+	std::vector<std::string> paths; 
+	for (auto it = files.begin() ; it != files.end() ; it++) {
+		if (std::find(paths.begin(), paths.end(), *it) == paths.end()) {
+			paths.push_back(*it); 
+		}
+	}
+	
+	// Reading and compressing the files is independent, only writing them to the image is sequential
+	enum State { Missing, Unreadable, Failed, Ready }; 
+	std::vector<std::string> contents(paths.size()); 
+	std::vector<unsigned> sizes(paths.size(), 0); 
+	std::vector<State> states(paths.size(), Missing); 
+	ParallelFor(paths.size(), [&](std::size_t i) {
+		ArchiveEntryIndex::const_iterator it = this->m_entryIndex.find(paths[i]); 
+		std::string content; 
+		if (it == this->m_entryIndex.end()) {
+			states[i] = Missing; 
+		} else if (!ReadWholeFile(strfmt("%s/%s", folder.c_str(), paths[i].c_str()), content)) {
+			states[i] = Unreadable; 
+		} else {
+			const Entry& entry = this->m_entryList[it->second]; 
+			states[i] = Pack(content, contents[i], entry.size != entry.compressedSize)? Ready : Failed; 
+			sizes[i] = content.size(); 
+		}
+	}); 
+	
+	this->m_image.close(); 
+	std::fstream image(this->m_imageFilename, std::fstream::in | std::fstream::out | std::fstream::binary); 
+	if (!image.is_open()) {
+		PrintError("Couldn't open file \"%s\".", this->m_imageFilename.c_str()); 
+		return false; 
+	}
+	image.seekg(0, std::fstream::end); 
+	unsigned long long end = image.tellg(); 
+	end = (end + SectorSize - 1) / SectorSize; 
+	
+	// Files only go to sectors the list on disk doesn't reference, the gaps left by older copies or the end of the image. 
+	// Until the new list replaces it, the old one still describes whole files. 
+	struct Gap {
+		unsigned long long		start; 
+		unsigned long long		end; 
+	}; 
+	std::vector<Gap> gaps; 
+	std::vector<const Entry*> stored; 
+	for (auto it = this->m_entryList.begin() ; it != this->m_entryList.end() ; it++) {
+		stored.push_back(&(*it)); 
+	}
+	std::sort(stored.begin(), stored.end(), [](const Entry* a, const Entry* b) {
+		return a->position < b->position; 
+	}); 
+	unsigned long long reached = (stored.size() > 0)? stored.front()->position : 0; 
+	for (auto it = stored.begin() ; it != stored.end() ; it++) {
+		if ((*it)->position > reached) {
+			gaps.push_back({ reached, (*it)->position }); 
+		}
+		reached = std::max(reached, (*it)->position + ((*it)->compressedSize + SectorSize - 1ULL) / SectorSize); 
+	}
+	end = std::max(end, reached); 
+	
+	bool modified = false; 
+	for (unsigned i = 0 ; i < paths.size() ; i++) {
+		Print("Importing file \"%s\"...", paths[i].c_str()); 
+		PrintStart(); 
+		if (states[i] == Missing) {
+			PrintError("File \"%s\" is not in the archive.", paths[i].c_str()); 
+			PrintAbort(); 
+			continue; 
+		} else if (states[i] == Unreadable) {
+			PrintError("Couldn't open file \"%s/%s\".", folder.c_str(), paths[i].c_str()); 
+			PrintAbort(); 
+			continue; 
+		} else if (states[i] == Failed) {
+			PrintError("Couldn't compress file \"%s\".", paths[i].c_str()); 
+			PrintAbort(); 
+			continue; 
+		}
+		
+		// The first gap the file fits in, the end of the image otherwise
+		Entry& entry = this->m_entryList[this->m_entryIndex[paths[i]]]; 
+		const std::string& content = contents[i]; 
+		unsigned long long sectors = (content.size() + SectorSize - 1) / SectorSize; 
+		auto gap = std::find_if(gaps.begin(), gaps.end(), [sectors](const Gap& gap) {
+			return gap.end - gap.start >= sectors; 
+		}); 
+		unsigned long long sector = end; 
+		if (gap != gaps.end()) {
+			sector = gap->start; 
+			gap->start += sectors; 
+		} else {
+			end += sectors; 
+		}
+		unsigned long long offset = sector * SectorSize; 
+		if (sector > 0xFFFFFFFFULL) {
+			PrintError("The image is too large for file \"%s\".", paths[i].c_str()); 
+			PrintAbort(); 
+			return false; 
+		}
+		PrintVerbose("Written to sector %llX.", sector); 
+		
+		std::string padded = content; 
+		padded.resize(sectors * SectorSize, '\0'); 
+		image.seekp(offset, std::fstream::beg); 
+		image.write(padded.data(), padded.size()); 
+		Profile::Count(ProfileCounter::BytesWritten, padded.size()); 
+		if (!image.good()) {
+			PrintError("Couldn't write file \"%s\".", this->m_imageFilename.c_str()); 
+			PrintAbort(); 
+			return false; 
+		}
+		
+		entry.position = sector; 
+		entry.size = sizes[i]; 
+		entry.compressedSize = content.size(); 
+		this->m_chunkList[entry.chunk].modified = true; 
+		modified = true; 
+		PrintDone(); 
+	}
+	image.close(); 
+	ForgetFileStatus(this->m_imageFilename); 
+	if (image.fail()) {
+		PrintError("Couldn't write file \"%s\".", this->m_imageFilename.c_str()); 
+		return false; 
+	}
+	
+	return (modified == false) || this->saveList(); 
+}
+
+bool Archive::saveList () {
+	Print("Building archive file list \"%s\"...", this->m_listFilename.c_str()); 
+	PrintStart(); 
+	
+	// Only the chunks holding the paths of imported files are built again
+	for (unsigned i = 0 ; i < this->m_chunkList.size() ; i++) {
+		PathChunk& chunk = this->m_chunkList[i]; 
+		if (chunk.modified == false) {
+			continue; 
+		}
+		
+		std::vector<Entry*> entries; 
+		for (auto it = this->m_entryList.begin() ; it != this->m_entryList.end() ; it++) {
+			if (it->chunk == i) {
+				entries.push_back(&(*it)); 
+			}
+		}
+		std::stable_sort(entries.begin(), entries.end(), [](const Entry* a, const Entry* b) {
+			return a->pathOffset < b->pathOffset; 
+		}); 
+		
+		std::string paths; 
+		for (auto it = entries.begin() ; it != entries.end() ; it++) {
+			if (paths.size() > 0xFFFF) {
+				PrintError("Chunk %u is too large.", i); 
+				PrintAbort(); 
+				return false; 
+			}
+			(*it)->pathOffset = paths.size(); 
+			paths += strfmt("%x:%x:%x:%s", (*it)->position, (*it)->size, (*it)->compressedSize, (*it)->path.c_str()); 
+			paths += '\0'; 
+		}
+		if (!Pack(paths, chunk.data, true)) {
+			PrintError("Couldn't compress chunk %u.", i); 
+			PrintAbort(); 
+			return false; 
+		}
+		chunk.size = paths.size(); 
+		chunk.modified = false; 
+	}
+	
+	std::string list; 
+	unsigned chunkTable = 12 + this->m_entryList.size() * 8; 
+	PutLittle32(list, chunkTable); 
+	PutLittle32(list, chunkTable + this->m_chunkList.size() * 12); 
+	PutLittle32(list, this->m_entryList.size()); 
+	for (auto it = this->m_entryList.begin() ; it != this->m_entryList.end() ; it++) {
+		PutLittle32(list, it->code); 
+		PutLittle16(list, it->pathOffset); 
+		PutLittle16(list, it->chunk); 
+	}
+	unsigned chunkOffset = 0; 
+	for (auto it = this->m_chunkList.begin() ; it != this->m_chunkList.end() ; it++) {
+		PutLittle32(list, it->size); 
+		PutLittle32(list, it->data.size()); 
+		PutLittle32(list, chunkOffset); 
+		chunkOffset += it->data.size(); 
+	}
+	for (auto it = this->m_chunkList.begin() ; it != this->m_chunkList.end() ; it++) {
+		list += it->data; 
+	}
+	
+	// Replaced in one step, the list on disk is either the old one or the new one
+	std::string temporary = this->m_listFilename + ".tmp"; 
+	std::ofstream out(temporary, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary); 
+	out.write(list.data(), list.size()); 
+	out.close(); 
+	bool written; 
+	if ((out.fail()) || (!ReplaceFile(this->m_listFilename, temporary, written))) {
+		std::error_code error; 
+		std::filesystem::remove(temporary, error); 
+		PrintError("Couldn't write file \"%s\".", this->m_listFilename.c_str()); 
+		PrintAbort(); 
+		return false; 
+	}
+	
+	PrintDone(); 
+	return true; 
+}
+
+bool Archive::mapImage () {
+	if (!this->m_image.open(this->m_imageFilename)) {
+		PrintError("Couldn't open file \"%s\".", this->m_imageFilename.c_str()); 
+		return false; 
+	}
+	return true; 
+}
+
+bool Archive::read (const std::string& path, std::string_view& data, std::string& buffer) const {
+	ArchiveEntryIndex::const_iterator it = this->m_entryIndex.find(path); 
+	if ((it == this->m_entryIndex.end()) || (!this->m_image.isOpen())) {
+		return false; 
+	}
+	
+	const Entry& entry = this->m_entryList[it->second]; 
+	unsigned long long offset = static_cast<unsigned long long>(entry.position) * SectorSize; 
+	if (offset + entry.compressedSize > this->m_image.size()) {
+		return false; 
+	}
+	
+	const char* stored = this->m_image.data() + offset; 
+	Profile::Count(ProfileCounter::BytesRead, entry.compressedSize); 
+	if (entry.size == entry.compressedSize) {
+		data = std::string_view(stored, entry.size); 
+		return true; 
+	} else if (!Inflate(stored, entry.compressedSize, entry.size, buffer)) {
+		return false; 
+	}
+	data = std::string_view(buffer.data(), buffer.size()); 
+	return true; 
+}
+
+unsigned Archive::getEntryCount () const {
+	return this->m_entryList.size(); 
+}
+
+bool Archive::hasEntry (const std::string& path) const {
+	return this->m_entryIndex.find(path) != this->m_entryIndex.end(); 
+}
+
+unsigned long long Archive::getFileSize (const std::string& path) const {
+	ArchiveEntryIndex::const_iterator it = this->m_entryIndex.find(path); 
+	return (it != this->m_entryIndex.end())? this->m_entryList[it->second].size : 0; 
+}
+
+const std::string& Archive::getImageFilename () const {
+	return this->m_imageFilename; 
+}
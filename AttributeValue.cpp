@@ -1,71 +1,59 @@
 
-#include <algorithm>
+#include <type_traits>
 
 #include "include/AttributeValue.hpp"
 
 using namespace dbtool; 
+
+// Copied around by value on every conversion, it must stay a handful of bytes with nothing to allocate or free
+static_assert(std::is_trivially_copyable<AttributeValue>::value, "AttributeValue must be trivially copyable"); 
+static_assert(sizeof(AttributeValue) <= 16, "AttributeValue must stay small"); 
 	
 AttributeValue::AttributeValue()
-	:m_value(), m_type(AttributeType::Unsigned) {
+	:m_value(), m_size(0), m_type(AttributeType::Unsigned) {
 		this->m_value.u = 0; 
 	}
 AttributeValue::AttributeValue(bool b)
-	:m_value(), m_type(AttributeType::Boolean) {
+	:m_value(), m_size(0), m_type(AttributeType::Boolean) {
 		this->m_value.b = b; 
 	}
 AttributeValue::AttributeValue(unsigned u)
-	:m_value(), m_type(AttributeType::Unsigned) {
+	:m_value(), m_size(0), m_type(AttributeType::Unsigned) {
 		this->m_value.u = u; 
 	}
 AttributeValue::AttributeValue(int i)
-	:m_value(), m_type(AttributeType::Signed) {
+	:m_value(), m_size(0), m_type(AttributeType::Signed) {
 		this->m_value.i = i; 
 	}
 AttributeValue::AttributeValue(float f)
-	:m_value(), m_type(AttributeType::Float) {
+	:m_value(), m_size(0), m_type(AttributeType::Float) {
 		this->m_value.f = f; 
 	}
-AttributeValue::AttributeValue(const std::string& s)
-	:m_value(), m_type(AttributeType::String) {
-		this->m_value.s = new std::string(s); 
-	}
-AttributeValue::AttributeValue(const AttributeValue& value)
-	:m_value(), m_type(value.m_type) {
-		if (this->m_type == AttributeType::String) {
-			this->m_value.s = new std::string(*value.m_value.s); 
-		} else {
-			this->m_value = value.m_value; 
-		}
-	}
-AttributeValue::AttributeValue(AttributeValue&& value)
-	:m_value(value.m_value), m_type(value.m_type) {
-		value.m_type = AttributeType::Unsigned; 
+AttributeValue::AttributeValue(std::string_view s)
+	:m_value(), m_size(s.size()), m_type(AttributeType::String) {
+		this->m_value.s = s.data(); 
 	}
-AttributeValue::~AttributeValue() {
-	if (this->m_type == AttributeType::String) {
-		delete this->m_value.s;
-	}
-}
 
-AttributeValue& AttributeValue::operator = (const AttributeValue& value) {
-	if (this != &value) {
-		if (this->m_type == AttributeType::String) {
-			delete this->m_value.s; 
-		}
-		this->m_type = value.m_type; 
-		if (this->m_type == AttributeType::String) {
-			this->m_value.s = new std::string(*value.m_value.s); 
-		} else {
-			this->m_value = value.m_value; 
-		}
+bool AttributeValue::operator == (const AttributeValue& value) const {
+	if (this->m_type != value.m_type) {
+		return false; 
+	}
+	switch (this->m_type) {
+		case AttributeType::Boolean: 
+			return this->m_value.b == value.m_value.b; 
+		case AttributeType::Signed: 
+			return this->m_value.i == value.m_value.i; 
+		case AttributeType::Float: 
+			return this->m_value.f == value.m_value.f; 
+		case AttributeType::String: 
+			return this->getString() == value.getString(); 
+		default: 
+			return this->m_value.u == value.m_value.u; 
 	}
-	return *this; 
 }
 
-AttributeValue& AttributeValue::operator = (AttributeValue&& value) {
-	std::swap(this->m_type, value.m_type); 
-	std::swap(this->m_value, value.m_value); 
-	return *this; 
+bool AttributeValue::operator != (const AttributeValue& value) const {
+	return !(*this == value); 
 }
 
 AttributeType AttributeValue::getType() const {
@@ -100,49 +88,35 @@ float AttributeValue::getFloat() const {
 	return this->m_value.f; 
 }
 
-std::string AttributeValue::getString() const {
+std::string_view AttributeValue::getString() const {
 	if (this->m_type != AttributeType::String) {
 		throw std::logic_error("Attribute value is not a String."); 
 	}
-	return *this->m_value.s; 
+	return std::string_view(this->m_value.s, this->m_size); 
 }
 
 void AttributeValue::setBoolean(bool b) {
-	if (this->m_type == AttributeType::String) {
-		delete this->m_value.s;
-	}
 	this->m_type = AttributeType::Boolean; 
 	this->m_value.b = b; 
 }
 
 void AttributeValue::setUnsigned(unsigned u) {
-	if (this->m_type == AttributeType::String) {
-		delete this->m_value.s;
-	}
 	this->m_type = AttributeType::Unsigned; 
 	this->m_value.u = u; 
 }
 
 void AttributeValue::setSigned(int i) {
-	if (this->m_type == AttributeType::String) {
-		delete this->m_value.s;
-	}
 	this->m_type = AttributeType::Signed; 
 	this->m_value.i = i; 
 }
 
 void AttributeValue::setFloat(float f) {
-	if (this->m_type == AttributeType::String) {
-		delete this->m_value.s;
-	}
 	this->m_type = AttributeType::Float; 
 	this->m_value.f = f; 
 }
 
-void AttributeValue::setString(const std::string& s) {
-	if (this->m_type == AttributeType::String) {
-		delete this->m_value.s;
-	}
+void AttributeValue::setString(std::string_view s) {
 	this->m_type = AttributeType::String; 
-	this->m_value.s = new std::string(s); 
+	this->m_value.s = s.data(); 
+	this->m_size = s.size(); 
 }
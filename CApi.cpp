@@ -0,0 +1,198 @@
+
+#include <cstring>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "include/WPDFile.hpp"
+#include "include/dbtool.h"
+
+using namespace dbtool; 
+
+struct dbtool_file {
+	WPDFile			file; 
+	std::string		error; 
+	
+	// Output that didn't fit the caller's buffer, and the arguments it was made with
+	std::string		pending; 
+	std::string		pendingKey; 
+}; 
+
+namespace {
+	
+	// What a call prints is dropped, only its errors are kept, in the file
+	class Call {
+		private: 
+			dbtool_file* m_file; 
+			std::string m_output; 
+			int m_indent; 
+			
+		public: 
+			Call (dbtool_file* file)
+				:m_file(file), m_output(), m_indent(GetPrintIndent()) {
+					this->m_file->error.clear(); 
+					SetPrintBuffer(&this->m_output); 
+					SetErrorBuffer(&this->m_file->error); 
+					SetPrintIndent(0); 
+				}
+			~Call () {
+				SetPrintBuffer(nullptr); 
+				SetErrorBuffer(nullptr); 
+				SetPrintIndent(this->m_indent); 
+			}
+			
+			// Turns what the library threw into an error of the call
+			int fail (const char* what) {
+				this->m_file->error += what; 
+				this->m_file->error += '\n'; 
+				return DBTOOL_ERROR; 
+			}
+	}; 
+	
+	// Copies the output if it fits, keeps it for the next call otherwise
+	int CopyOutput(dbtool_file* file, const std::string& key, std::string&& output, void* buffer, std::size_t capacity, std::size_t* size) {
+		*size = output.size(); 
+		if (output.size() > capacity) {
+			file->pending = std::move(output); 
+			file->pendingKey = key; 
+			return DBTOOL_BUFFER_TOO_SMALL; 
+		}
+		if (!output.empty()) {
+			std::memcpy(buffer, output.data(), output.size()); 
+		}
+		file->pending.clear(); 
+		file->pendingKey.clear(); 
+		return DBTOOL_OK; 
+	}
+	
+	bool TakePending(dbtool_file* file, const std::string& key, std::string& output) {
+		if ((file->pendingKey.empty()) || (file->pendingKey != key)) {
+			file->pending.clear(); 
+			file->pendingKey.clear(); 
+			return false; 
+		}
+		output = std::move(file->pending); 
+		return true; 
+	}
+	
+}
+
+int dbtool_get_version(void) {
+	return DBTOOL_API_VERSION; 
+}
+
+dbtool_file* dbtool_create(void) {
+	return new (std::nothrow) dbtool_file(); 
+}
+
+void dbtool_destroy(dbtool_file* file) {
+	delete file; 
+}
+
+int dbtool_open(dbtool_file* file, const char* path) {
+	if ((file == nullptr) || (path == nullptr)) {
+		return DBTOOL_INVALID_ARGUMENT; 
+	}
+	Call call(file); 
+	file->pendingKey.clear(); 
+	try {
+		return file->file.load(path)? DBTOOL_OK : DBTOOL_ERROR; 
+	} catch (const std::exception& e) {
+		return call.fail(e.what()); 
+	}
+}
+
+int dbtool_open_buffer(dbtool_file* file, const void* data, size_t size) {
+	if ((file == nullptr) || ((data == nullptr) && (size > 0))) {
+		return DBTOOL_INVALID_ARGUMENT; 
+	}
+	Call call(file); 
+	file->pendingKey.clear(); 
+	try {
+		return file->file.load("buffer", std::string_view(static_cast<const char*>(data), size))? DBTOOL_OK : DBTOOL_ERROR; 
+	} catch (const std::exception& e) {
+		return call.fail(e.what()); 
+	}
+}
+
+int dbtool_patch(dbtool_file* file, const char* path, const char* format) {
+	if ((file == nullptr) || (path == nullptr) || (format == nullptr)) {
+		return DBTOOL_INVALID_ARGUMENT; 
+	}
+	Call call(file); 
+	file->pendingKey.clear(); 
+	try {
+		return file->file.patch(path, format)? DBTOOL_OK : DBTOOL_ERROR; 
+	} catch (const std::exception& e) {
+		return call.fail(e.what()); 
+	}
+}
+
+int dbtool_patch_buffer(dbtool_file* file, const char* text, size_t size, const char* format) {
+	if ((file == nullptr) || ((text == nullptr) && (size > 0)) || (format == nullptr)) {
+		return DBTOOL_INVALID_ARGUMENT; 
+	}
+	Call call(file); 
+	file->pendingKey.clear(); 
+	try {
+		return file->file.patch("buffer", std::string_view(text, size), format)? DBTOOL_OK : DBTOOL_ERROR; 
+	} catch (const std::exception& e) {
+		return call.fail(e.what()); 
+	}
+}
+
+int dbtool_convert(dbtool_file* file, const char* format, const char* filter, int show_hidden, char* buffer, size_t capacity, size_t* size) {
+	if ((file == nullptr) || (size == nullptr) || ((buffer == nullptr) && (capacity > 0))) {
+		return DBTOOL_INVALID_ARGUMENT; 
+	}
+	Call call(file); 
+	try {
+		std::string key = strfmt("convert|%s|%s|%d", (format != nullptr)? format : "", (filter != nullptr)? filter : "*", show_hidden != 0); 
+		std::string output; 
+		if (!TakePending(file, key, output)) {
+			std::ostringstream out; 
+			if (!file->file.convert(out, (format != nullptr)? format : "", (filter != nullptr)? filter : "*", show_hidden != 0)) {
+				return DBTOOL_ERROR; 
+			}
+			output = out.str(); 
+		}
+		return CopyOutput(file, key, std::move(output), buffer, capacity, size); 
+	} catch (const std::exception& e) {
+		return call.fail(e.what()); 
+	}
+}
+
+int dbtool_save(dbtool_file* file, const char* path) {
+	if ((file == nullptr) || (path == nullptr)) {
+		return DBTOOL_INVALID_ARGUMENT; 
+	}
+	Call call(file); 
+	try {
+		return file->file.save(path)? DBTOOL_OK : DBTOOL_ERROR; 
+	} catch (const std::exception& e) {
+		return call.fail(e.what()); 
+	}
+}
+
+int dbtool_save_buffer(dbtool_file* file, void* buffer, size_t capacity, size_t* size) {
+	if ((file == nullptr) || (size == nullptr) || ((buffer == nullptr) && (capacity > 0))) {
+		return DBTOOL_INVALID_ARGUMENT; 
+	}
+	Call call(file); 
+	try {
+		std::string output; 
+		if (!TakePending(file, "save", output)) {
+			std::ostringstream out(std::ios_base::out | std::ios_base::binary); 
+			file->file.save(out); 
+			output = out.str(); 
+		}
+		return CopyOutput(file, "save", std::move(output), buffer, capacity, size); 
+	} catch (const std::exception& e) {
+		return call.fail(e.what()); 
+	}
+}
+
+const char* dbtool_get_error(const dbtool_file* file) {
+	return (file != nullptr)? file->error.c_str() : ""; 
+}
@@ -7,13 +7,14 @@
 #include <stdexcept>
 
 #include "include/Chunk.hpp"
+#include "include/Log.hpp"
 
 using namespace dbtool; 
 
 Chunk::Chunk ()
-	:m_data(nullptr), m_size(0) {}
+	:m_data(nullptr), m_size(0), m_tag(MemoryTag::Chunks) {} 
 Chunk::Chunk (unsigned size)
-	:m_data(nullptr), m_size(0) {
+	:m_data(nullptr), m_size(0), m_tag(MemoryTag::Chunks) {
 		if (size > 0) {
 			try {
 				if (size % 4 != 0) {
@@ -21,14 +22,15 @@ Chunk::Chunk (unsigned size)
 				}
 				this->m_data = new char [size]; 
 				this->m_size = size; 
+				MemoryStats::Allocate(this->m_tag, size); 
 				this->clear(); 
 			} catch (const std::bad_alloc& e) {
-				std::cout << "Failed to allocate " << size*sizeof(char) << " bytes." << std::endl; 
+				PrintError("Failed to allocate %zu bytes.", size*sizeof(char)); 
 			}
 		}
 	}
 Chunk::Chunk (std::istream& in, int size)
-	:m_data(nullptr), m_size(0) {
+	:m_data(nullptr), m_size(0), m_tag(MemoryTag::Chunks) {
 		if (size > 0) {
 			try {
 				if (size % 4 != 0) {
@@ -36,14 +38,15 @@ Chunk::Chunk (std::istream& in, int size)
 				}
 				this->m_data = new char [size]; 
 				this->m_size = size; 
+				MemoryStats::Allocate(this->m_tag, size); 
 				this->read(in); 
 			} catch (const std::bad_alloc& e) {
-				std::cout << "Failed to allocate " << size*sizeof(char) << " bytes." << std::endl; 
+				PrintError("Failed to allocate %zu bytes.", size*sizeof(char)); 
 			}
 		}
 	}
 Chunk::Chunk (std::istream& in, int offset, int size)
-	:m_data(nullptr), m_size(0) {
+	:m_data(nullptr), m_size(0), m_tag(MemoryTag::Chunks) {
 		if (size > 0) {
 			try {
 				if (size % 4 != 0) {
@@ -51,26 +54,28 @@ Chunk::Chunk (std::istream& in, int offset, int size)
 				}
 				this->m_data = new char [size]; 
 				this->m_size = size; 
+				MemoryStats::Allocate(this->m_tag, size); 
 				this->read(in, offset); 
 			} catch (const std::bad_alloc& e) {
-				std::cout << "Failed to allocate " << size*sizeof(char) << " bytes." << std::endl; 
+				PrintError("Failed to allocate %zu bytes.", size*sizeof(char)); 
 			}
 		}
 	}
 Chunk::Chunk (const Chunk& chunk)
-	:m_data(nullptr), m_size(0) {
+	:m_data(nullptr), m_size(0), m_tag(chunk.m_tag) {
 		if (chunk.m_size > 0) {
 			try {
 				this->m_data = new char [chunk.m_size]; 
 				this->m_size = chunk.m_size; 
+				MemoryStats::Allocate(this->m_tag, chunk.m_size); 
 				std::memcpy(this->m_data, chunk.m_data, chunk.m_size); 
 			} catch (const std::bad_alloc& e) {
-				std::cout << "Failed to allocate " << chunk.m_size*sizeof(char) << " bytes." << std::endl; 
+				PrintError("Failed to allocate %zu bytes.", chunk.m_size*sizeof(char)); 
 			}
 		}
 	}
 Chunk::Chunk (Chunk&& chunk)
-	:m_data(chunk.m_data), m_size(chunk.m_size) {
+	:m_data(chunk.m_data), m_size(chunk.m_size), m_tag(chunk.m_tag) {
 		chunk.m_data = nullptr; 
 		chunk.m_size = 0; 
 	}
@@ -81,12 +86,14 @@ Chunk::~Chunk () {
 Chunk& Chunk::operator = (const Chunk& chunk) {
 	if (this != &chunk) {
 		this->release(); 
+		this->m_tag = chunk.m_tag; 
 		try {
 			this->m_data = new char [chunk.m_size]; 
 			this->m_size = chunk.m_size; 
+			MemoryStats::Allocate(this->m_tag, chunk.m_size); 
 			std::memcpy(this->m_data, chunk.m_data, chunk.m_size); 
 		} catch (const std::bad_alloc& e) {
-			std::cout << "Failed to allocate " << chunk.m_size*sizeof(char) << " bytes." << std::endl; 
+			PrintError("Failed to allocate %zu bytes.", chunk.m_size*sizeof(char)); 
 		}
 	}
 	return *this; 
@@ -96,6 +103,7 @@ Chunk& Chunk::operator = (Chunk&& chunk) {
 		this->release(); 
 		this->m_data = chunk.m_data; 
 		this->m_size = chunk.m_size; 
+		this->m_tag = chunk.m_tag; 
 		chunk.m_data = nullptr; 
 		chunk.m_size = 0; 
 	}
@@ -110,6 +118,7 @@ void Chunk::clear () {
 void Chunk::release () {
 	if (this->m_data != nullptr) {
 		delete [] this->m_data; 
+		MemoryStats::Release(this->m_tag, this->m_size); 
 		this->m_data = nullptr; 
 		this->m_size = 0; 
 	}
@@ -127,6 +136,7 @@ void Chunk::resize (unsigned size) {
 				size += 4 - size % 4; 
 			}
 			char* data = new char [size]; 
+			MemoryStats::Allocate(this->m_tag, size); 
 			std::memset(data, 0, size*sizeof(char)); 
 			if (this->m_data != nullptr) {
 				if (size > this->m_size) {
@@ -135,15 +145,26 @@ void Chunk::resize (unsigned size) {
 					std::memcpy(data, this->m_data, size); 
 				}
 				delete [] this->m_data; 
+				MemoryStats::Release(this->m_tag, this->m_size); 
 			}
 			this->m_data = data; 
 			this->m_size = size; 
 		} catch (const std::bad_alloc& e) {
-			std::cout << "Failed to allocate " << size*sizeof(char) << " bytes." << std::endl; 
+			PrintError("Failed to allocate %zu bytes.", size*sizeof(char)); 
 		}
 	}
 }
 			
+MemoryTag Chunk::getTag () const {
+	return this->m_tag; 
+}
+void Chunk::setTag (MemoryTag tag) {
+	if (this->m_data != nullptr) {
+		MemoryStats::Retag(this->m_tag, tag, this->m_size); 
+	}
+	this->m_tag = tag; 
+}
+			
 void Chunk::read (std::istream& in) {
 	in.read(this->m_data, this->m_size); 
 }
@@ -169,6 +190,13 @@ char Chunk::operator [] (unsigned offset) const {
 	return this->m_data[offset]; 
 }
 
+const char* Chunk::data () const {
+	return this->m_data; 
+}
+char* Chunk::data () {
+	return this->m_data; 
+}
+
 bool Chunk::getBoolean (unsigned offset, unsigned bit) const {
 	return (this->getUnsignedMask(offset, bit, 1) != 0); 
 }
@@ -255,6 +283,11 @@ std::string Chunk::getString (unsigned offset) const {
 	std::string s(&this->m_data[offset]); 
 	return s; 
 }
+std::string_view Chunk::getStringView (unsigned offset) const {
+	if (offset > this->m_size-1)
+		throw std::range_error("Index out of range."); 
+	return std::string_view(&this->m_data[offset], strnlen(&this->m_data[offset], this->m_size-offset)); 
+}
 void Chunk::setString (unsigned offset, const std::string& string) {
 	if (offset > this->m_size-string.size()-1)
 		throw std::range_error("Index out of range."); 
@@ -1,17 +1,43 @@
 
+#include <algorithm>
 #include <cstring>
+#include <vector>
 
 #include "include/Enum.hpp"
+#include "include/MemoryStats.hpp"
+#include "include/Profile.hpp"
+#include "include/SchemaCache.hpp"
 #include "tinyxml2/tinyxml2.h"
 
 using namespace dbtool; 
 
 EnumMap Enum::s_enums; 
+std::shared_mutex Enum::s_mutex; 
+std::unordered_map<std::string, std::string> Enum::s_waiting; 
+std::mutex Enum::s_waitingMutex; 
 
 Enum::Enum()
-	:m_values(), m_type(AttributeType::Unsigned), m_name(""), m_strict(false) {}
+	:m_values(), m_type(AttributeType::Unsigned), m_name(""), m_strict(false), m_filenames(), m_strings() {} 
 Enum::~Enum() {} 
 
+void Enum::clear() {
+	this->m_values.clear(); 
+	this->m_type = AttributeType::Unsigned; 
+	this->m_name = ""; 
+	this->m_strict = false; 
+	this->m_filenames.clear(); 
+	this->m_strings.clear(); 
+}
+
+std::string_view Enum::addString(std::string_view s) {
+	this->m_strings.emplace_back(s); 
+	return this->m_strings.back(); 
+}
+
+void Enum::setString(const std::string& name, std::string_view s) {
+	this->m_values[name].setString(this->addString(s)); 
+}
+
 AttributeType Enum::getType() const {
 	return this->m_type; 
 }
@@ -20,6 +46,14 @@ bool Enum::getStrict() const {
 	return this->m_strict; 
 }
 
+const std::list<std::string>& Enum::getFilenames() const {
+	return this->m_filenames; 
+}
+
+const AttributeValueMap& Enum::getValues() const {
+	return this->m_values; 
+}
+
 unsigned Enum::getUnsigned(const std::string& name) const {
 	AttributeValueMap::const_iterator it = this->m_values.find(name); 
 	if (it == this->m_values.end()) {
@@ -44,7 +78,7 @@ float Enum::getFloat(const std::string& name) const {
 	return it->second.getFloat(); 
 }
 
-std::string Enum::getString(const std::string& name) const {
+std::string_view Enum::getString(const std::string& name) const {
 	AttributeValueMap::const_iterator it = this->m_values.find(name); 
 	if (it == this->m_values.end()) {
 		throw std::logic_error(strfmt("Key \"%s\" is not defined in enumeration %s.", name.c_str(), this->m_name.c_str())); 
@@ -52,7 +86,7 @@ std::string Enum::getString(const std::string& name) const {
 	return it->second.getString(); 
 }
 
-std::string Enum::getName(unsigned u) const {
+const std::string& Enum::getName(unsigned u) const {
 	AttributeValueMap::const_iterator it; 
 	for (it = this->m_values.begin() ; it != this->m_values.end() ; it++) {
 		if (it->second.getUnsigned() == u)
@@ -61,7 +95,7 @@ std::string Enum::getName(unsigned u) const {
 	throw std::logic_error(strfmt("Value %u is not defined in enumeration %s.", u, this->m_name.c_str())); 
 }
 
-std::string Enum::getName(int i) const {
+const std::string& Enum::getName(int i) const {
 	AttributeValueMap::const_iterator it; 
 	for (it = this->m_values.begin() ; it != this->m_values.end() ; it++) {
 		if (it->second.getSigned() == i)
@@ -70,7 +104,7 @@ std::string Enum::getName(int i) const {
 	throw std::logic_error(strfmt("Value %d is not defined in enumeration %s.", i, this->m_name.c_str())); 
 }
 
-std::string Enum::getName(float f) const {
+const std::string& Enum::getName(float f) const {
 	AttributeValueMap::const_iterator it; 
 	for (it = this->m_values.begin() ; it != this->m_values.end() ; it++) {
 		if (it->second.getFloat() == f)
@@ -79,130 +113,237 @@ std::string Enum::getName(float f) const {
 	throw std::logic_error(strfmt("Value %f is not defined in enumeration %s.", f, this->m_name.c_str())); 
 }
 
-std::string Enum::getName(const std::string& s) const {
+const std::string& Enum::getName(std::string_view s) const {
 	AttributeValueMap::const_iterator it; 
 	for (it = this->m_values.begin() ; it != this->m_values.end() ; it++) {
 		if (it->second.getString() == s)
 			return it->first; 
 	}
-	throw std::logic_error(strfmt("Value \"%s\" is not defined in enumeration %s.", s.c_str(), this->m_name.c_str())); 
+	throw std::logic_error(strfmt("Value \"%.*s\" is not defined in enumeration %s.", static_cast<int>(s.size()), s.data(), this->m_name.c_str())); 
 }
 
 Enum* Enum::GetEnum(const std::string& name) {
-	EnumMap::iterator it = Enum::s_enums.find(name); 
-	if (it == Enum::s_enums.end()) {
-		Print("Loading enumeration %s...", name.c_str()); 
-		PrintStart(); 
-		
-		tinyxml2::XMLDocument xml; 
-		std::string filename = strfmt("xml/enum/%s.xml", name.c_str()); 
-		xml.LoadFile(filename.c_str()); 
-		if (xml.Error()) {
-			Print("Couldn't open XML file \"%s\".", filename.c_str()); 
-			PrintAbort(); 
-			return nullptr; 
+	// Enumerations being loaded by this thread, the last one is asking for its parent
+	static thread_local std::vector<std::string> loading; 
+	if ((!loading.empty()) && (Enum::WaitFor(loading.back(), name))) {
+		PrintError("Enumeration %s extends itself.", name.c_str()); 
+		return nullptr; 
+	}
+	
+	EnumSlot* slot = nullptr; 
+	{
+		std::shared_lock<std::shared_mutex> lock(Enum::s_mutex); 
+		EnumMap::const_iterator it = Enum::s_enums.find(name); 
+		if (it != Enum::s_enums.end()) {
+			slot = it->second.get(); 
 		}
-		
-		tinyxml2::XMLElement* xmlenum = xml.FirstChildElement("enum"); 
-		if (xmlenum == nullptr) {
-			Print("Couldn't find \"%s\" element in XML file \"%s\".", "enum", filename.c_str()); 
-			PrintAbort(); 
-			return nullptr; 
+	}
+	if (slot == nullptr) {
+		std::unique_lock<std::shared_mutex> lock(Enum::s_mutex); 
+		std::unique_ptr<EnumSlot>& entry = Enum::s_enums[name]; 
+		if (!entry) {
+			entry.reset(new EnumSlot()); 
 		}
-		
-		Enum& enumInfo = Enum::s_enums[name]; 
-		enumInfo.m_name = name; 
-		
-		const char* enumType = xmlenum->Attribute("type"); 
-		if (enumType == nullptr) {
-			Print("Missing \"%s\" attribute.", "type"); 
-		} else if (strcmp(enumType, "Unsigned") == 0) {
-			enumInfo.m_type = AttributeType::Unsigned; 
-		} else if (strcmp(enumType, "Signed") == 0) {
-			enumInfo.m_type = AttributeType::Signed; 
-		} else if (strcmp(enumType, "Float") == 0) {
-			enumInfo.m_type = AttributeType::Float; 
-		} else if (strcmp(enumType, "String") == 0) {
-			enumInfo.m_type = AttributeType::String; 
-		} else {
-			Print("Unexpected \"%s\" attribute value (\"%s\").", "type", enumType); 
+		slot = entry.get(); 
+	}
+	
+	// Only one thread loads a given enumeration, the others wait for it
+	std::call_once(slot->once, [&name, slot]() {
+		Profile::Scope scope("enum", name); 
+		loading.push_back(name); 
+		std::unique_ptr<Enum> enumInfo(new Enum()); 
+		if (Enum::LoadEnum(name, *enumInfo)) {
+			MemoryStats::Allocate(MemoryTag::Schemas, enumInfo->getFootprint()); 
+			slot->enumInfo = std::move(enumInfo); 
 		}
-		
-		const char* enumStrict = xmlenum->Attribute("strict"); 
-		if ((enumStrict != nullptr) && (strcmp(enumStrict, "true") == 0)) {
-			enumInfo.m_strict = true; 
+		loading.pop_back(); 
+	}); 
+	if (!loading.empty()) {
+		std::lock_guard<std::mutex> lock(Enum::s_waitingMutex); 
+		Enum::s_waiting.erase(loading.back()); 
+	}
+	return slot->enumInfo.get(); 
+}
+
+// Records that the enumeration being loaded waits for its parent, unless following who waits for whom from the parent leads back to it. 
+// Loads of an "extends" cycle may have started on different threads, each waiting for the next one: the last to get here sees the cycle. 
+bool Enum::WaitFor(const std::string& child, const std::string& parent) {
+	std::lock_guard<std::mutex> lock(Enum::s_waitingMutex); 
+	const std::string* next = &parent; 
+	for (std::size_t steps = 0 ; steps <= Enum::s_waiting.size() ; steps++) {
+		if (*next == child) {
+			return true; 
 		}
-		
-		bool enumHexa = false; 
-		const char* enumFormat = xmlenum->Attribute("format"); 
-		if ((enumFormat != nullptr) && (strcmp(enumFormat, "hexa") == 0)) {
-			enumHexa = true; 
+		auto it = Enum::s_waiting.find(*next); 
+		if (it == Enum::s_waiting.end()) {
+			break; 
 		}
-		
-		const char* enumExtends = xmlenum->Attribute("extends"); 
-		if (enumExtends != nullptr) {
-			Enum* enumParent = Enum::GetEnum(enumExtends); 
-			if (enumParent != nullptr) {
-				if (enumInfo.m_type != enumParent->m_type) {
-					Print("Enumerations %s and %s do not have the same type.", enumInfo.m_name.c_str(), enumExtends); 
-				} else {
-					enumInfo.m_values = enumParent->m_values; 
+		next = &it->second; 
+	}
+	Enum::s_waiting[child] = parent; 
+	return false; 
+}
+
+// Forgets everything read from the file so it is loaded again on next use, no other thread may be using the registry. 
+// Those that failed to load are forgotten too, the file may be what fixes them. 
+void Enum::Unload(const std::string& filename) {
+	std::unique_lock<std::shared_mutex> lock(Enum::s_mutex); 
+	for (auto it = Enum::s_enums.begin() ; it != Enum::s_enums.end() ; ) {
+		const Enum* enumInfo = it->second->enumInfo.get(); 
+		if ((enumInfo == nullptr) || (std::find(enumInfo->m_filenames.begin(), enumInfo->m_filenames.end(), filename) != enumInfo->m_filenames.end())) {
+			if (enumInfo != nullptr) {
+				MemoryStats::Release(MemoryTag::Schemas, enumInfo->getFootprint()); 
+			}
+			it = Enum::s_enums.erase(it); 
+		} else {
+			it++; 
+		}
+	}
+}
+
+std::size_t Enum::getFootprint() const {
+	// A hash node is the value, a link and the cached hash, next to its bucket
+	std::size_t size = sizeof(Enum) + MemoryStats::GetHeapSize(this->m_name) + this->m_values.bucket_count() * sizeof(void*); 
+	for (auto it = this->m_values.begin() ; it != this->m_values.end() ; it++) {
+		size += sizeof(*it) + sizeof(void*) + sizeof(std::size_t) + MemoryStats::GetHeapSize(it->first); 
+	}
+	for (auto it = this->m_filenames.begin() ; it != this->m_filenames.end() ; it++) {
+		size += sizeof(std::string) + 2 * sizeof(void*) + MemoryStats::GetHeapSize(*it); 
+	}
+	for (auto it = this->m_strings.begin() ; it != this->m_strings.end() ; it++) {
+		size += sizeof(std::string) + MemoryStats::GetHeapSize(*it); 
+	}
+	return size; 
+}
+
+bool Enum::LoadEnum(const std::string& name, Enum& enumInfo) {
+	if (SchemaCache::ReadEnum(name, enumInfo)) {
+		PrintVerbose("Loaded enumeration %s from schema cache.", name.c_str()); 
+		return true; 
+	}
+	enumInfo.clear(); 
+	
+	Print("Loading enumeration %s...", name.c_str()); 
+	PrintStart(); 
+	
+	tinyxml2::XMLDocument xml; 
+	std::string filename = strfmt("xml/enum/%s.xml", name.c_str()); 
+	xml.LoadFile(filename.c_str()); 
+	if (xml.Error()) {
+		PrintError("Couldn't open XML file \"%s\".", filename.c_str()); 
+		PrintAbort(); 
+		return false; 
+	}
+	
+	tinyxml2::XMLElement* xmlenum = xml.FirstChildElement("enum"); 
+	if (xmlenum == nullptr) {
+		PrintError("Couldn't find \"%s\" element in XML file \"%s\".", "enum", filename.c_str()); 
+		PrintAbort(); 
+		return false; 
+	}
+	
+	enumInfo.m_name = name; 
+	enumInfo.m_filenames.push_back(filename); 
+	
+	const char* enumType = xmlenum->Attribute("type"); 
+	if (enumType == nullptr) {
+		PrintError("Missing \"%s\" attribute.", "type"); 
+	} else if (strcmp(enumType, "Unsigned") == 0) {
+		enumInfo.m_type = AttributeType::Unsigned; 
+	} else if (strcmp(enumType, "Signed") == 0) {
+		enumInfo.m_type = AttributeType::Signed; 
+	} else if (strcmp(enumType, "Float") == 0) {
+		enumInfo.m_type = AttributeType::Float; 
+	} else if (strcmp(enumType, "String") == 0) {
+		enumInfo.m_type = AttributeType::String; 
+	} else {
+		PrintError("Unexpected \"%s\" attribute value (\"%s\").", "type", enumType); 
+	}
+	
+	const char* enumStrict = xmlenum->Attribute("strict"); 
+	if ((enumStrict != nullptr) && (strcmp(enumStrict, "true") == 0)) {
+		enumInfo.m_strict = true; 
+	}
+	
+	bool enumHexa = false; 
+	const char* enumFormat = xmlenum->Attribute("format"); 
+	if ((enumFormat != nullptr) && (strcmp(enumFormat, "hexa") == 0)) {
+		enumHexa = true; 
+	}
+	
+	const char* enumExtends = xmlenum->Attribute("extends"); 
+	if (enumExtends != nullptr) {
+		Enum* enumParent = Enum::GetEnum(enumExtends); 
+		if (enumParent != nullptr) {
+			if (enumInfo.m_type != enumParent->m_type) {
+				PrintError("Enumerations %s and %s do not have the same type.", enumInfo.m_name.c_str(), enumExtends); 
+			} else {
+				// Strings are copied, the parent may be unloaded on its own
+				for (auto it = enumParent->m_values.begin() ; it != enumParent->m_values.end() ; it++) {
+					if (it->second.getType() == AttributeType::String) {
+						enumInfo.setString(it->first, it->second.getString()); 
+					} else {
+						enumInfo.m_values[it->first] = it->second; 
+					}
 				}
 			}
+			enumInfo.m_filenames.insert(enumInfo.m_filenames.end(), enumParent->m_filenames.begin(), enumParent->m_filenames.end()); 
+		}
+	}
+	
+	tinyxml2::XMLElement* xmloption; 
+	for (xmloption = xmlenum->FirstChildElement("option") ; xmloption != nullptr ; xmloption = xmloption->NextSiblingElement("option")) {
+		const char* optionName = xmloption->Attribute("name"); 
+		if (optionName == nullptr) {
+			PrintError("Missing option \"%s\" attribute.", "name"); 
+			continue; 
 		}
 		
-		tinyxml2::XMLElement* xmloption; 
-		for (xmloption = xmlenum->FirstChildElement("option") ; xmloption != nullptr ; xmloption = xmloption->NextSiblingElement("option")) {
-			const char* optionName = xmloption->Attribute("name"); 
-			if (optionName == nullptr) {
-				Print("Missing option \"%s\" attribute.", "name"); 
-				continue; 
-			}
-			
-			const char* optionValue = xmloption->Attribute("value"); 
-			if (optionName == nullptr) {
-				Print("Missing option \"%s\" attribute.", "value"); 
-				continue; 
-			}
-			
-			switch (enumInfo.m_type) {
-				case AttributeType::Unsigned: 
-					if (enumHexa) {
-						try {
-							enumInfo.m_values[optionName].setUnsigned(lexical_cast<unsigned>(optionValue, std::hex)); 
-						} catch (const std::logic_error& e) {
-							Print("Unexpected hexadecimal value (\"%s\").", optionValue); 
-						}
+		const char* optionValue = xmloption->Attribute("value"); 
+		if (optionValue == nullptr) {
+			PrintError("Missing option \"%s\" attribute.", "value"); 
+			continue; 
+		}
+		
+		unsigned u; 
+		int i; 
+		float f; 
+		switch (enumInfo.m_type) {
+			case AttributeType::Unsigned: 
+				if (enumHexa) {
+					if (ParseHexadecimal(optionValue, u) == std::errc()) {
+						enumInfo.m_values[optionName].setUnsigned(u); 
 					} else {
-						try {
-							enumInfo.m_values[optionName].setUnsigned(lexical_cast<unsigned>(optionValue)); 
-						} catch (const std::logic_error& e) {
-							Print("Unexpected unsigned value (\"%s\").", optionValue); 
-						}
-					}
-					break; 
-				case AttributeType::Signed: 
-					try {
-						enumInfo.m_values[optionName].setSigned(lexical_cast<int>(optionValue)); 
-					} catch (const std::logic_error& e) {
-						Print("Unexpected signed value (\"%s\").", optionValue); 
+						PrintError("Unexpected hexadecimal value (\"%s\").", optionValue); 
 					}
-					break; 
-				case AttributeType::Float: 
-					try {
-						enumInfo.m_values[optionName].setFloat(lexical_cast<float>(optionValue)); 
-					} catch (const std::logic_error& e) {
-						Print("Unexpected float value (\"%s\").", optionValue); 
+				} else {
+					if (ParseUnsigned(optionValue, u) == std::errc()) {
+						enumInfo.m_values[optionName].setUnsigned(u); 
+					} else {
+						PrintError("Unexpected unsigned value (\"%s\").", optionValue); 
 					}
-					break; 
-				case AttributeType::String: 
-					enumInfo.m_values[optionName].setString(optionValue); 
-			}
+				}
+				break; 
+			case AttributeType::Signed: 
+				if (ParseSigned(optionValue, i) == std::errc()) {
+					enumInfo.m_values[optionName].setSigned(i); 
+				} else {
+					PrintError("Unexpected signed value (\"%s\").", optionValue); 
+				}
+				break; 
+			case AttributeType::Float: 
+				if (ParseFloat(optionValue, f) == std::errc()) {
+					enumInfo.m_values[optionName].setFloat(f); 
+				} else {
+					PrintError("Unexpected float value (\"%s\").", optionValue); 
+				}
+				break; 
+			case AttributeType::String: 
+				enumInfo.setString(optionName, optionValue); 
 		}
-		
-		PrintDone(); 
-		return &enumInfo; 
-	} else {
-		return &it->second; 
 	}
+	
+	SchemaCache::WriteEnum(enumInfo); 
+	PrintDone(); 
+	return true; 
 }
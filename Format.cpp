@@ -1,11 +1,20 @@
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
 #include "include/Enum.hpp"
 #include "include/Format.hpp"
+#include "include/MemoryStats.hpp"
+#include "include/Profile.hpp"
+#include "include/SchemaCache.hpp"
 #include "tinyxml2/tinyxml2.h"
 
 using namespace dbtool; 
 
 Format::Formats Format::s_formats; 
+std::shared_mutex Format::s_mutex; 
 
 Format::Attribute::Attribute()
 	:name(""), type(AttributeType::Unsigned), format(AttributeFormat::Decimal), enumName(""), offset(0), bit(0), size(32), hidden(false) {}
@@ -23,16 +32,21 @@ Format::Attribute& Format::Attribute::operator = (const Format::Attribute& attri
 		this->size		= attribute.size; 
 		this->hidden	= attribute.hidden; 
 	}
+	return *this; 
 }
 
 Format::Format()
-	:m_attributes(), m_size(0), m_name("") {}
+	:m_attributes(), m_size(0), m_name(""), m_filenames() {} 
 Format::~Format() {}
 
 unsigned Format::getSize() const {
 	return this->m_size; 
 }
 
+const std::list<std::string>& Format::getFilenames() const {
+	return this->m_filenames; 
+}
+
 const Format::Attributes& Format::getAttributes() const {
 	return this->m_attributes; 
 }
@@ -47,167 +61,293 @@ const Format::Attribute& Format::getAttribute(const std::string& name) const {
 	throw std::logic_error(strfmt("Attribute \"%s\" is not defined in format \"%s\".", name.c_str(), this->m_name.c_str())); 
 }
 
+bool Format::GetRawAttribute(const std::string& name, const std::string& value, Format::Attribute& attribute) {
+	unsigned offset, bit, size; 
+	int length = 0; 
+	if ((sscanf(name.c_str(), "[0x%X|%u|%u]%n", &offset, &bit, &size, &length) != 3) || (static_cast<unsigned>(length) != name.size())) {
+		return false; 
+	} else if ((size == 0) || (bit + size > 32)) {
+		return false; 
+	}
+	
+	attribute.name = name; 
+	attribute.type = AttributeType::Unsigned; 
+	attribute.format = AttributeFormat::Hexadecimal; 
+	attribute.enumName = ""; 
+	attribute.offset = offset; 
+	attribute.bit = bit; 
+	attribute.size = size; 
+	attribute.hidden = true; 
+	if ((bit == 0) && (size == 32)) {
+		if ((!value.empty()) && (value[0] == '"')) {
+			attribute.type = AttributeType::String; 
+		} else if (value.find('.') != std::string::npos) {
+			attribute.type = AttributeType::Float; 
+			attribute.format = AttributeFormat::Decimal; 
+		}
+	}
+	return true; 
+}
+
 Format* Format::GetFormat(const std::string& name) {
-	Format::Formats::iterator it = Format::s_formats.find(name); 
-	if (it == Format::s_formats.end()) {
-		Print("Loading format \"%s\"...", name.c_str()); 
-		PrintStart(); 
-		
-		tinyxml2::XMLDocument xml; 
-		std::string filename = strfmt("xml/fmt/%s", name.c_str()); 
-		xml.LoadFile(filename.c_str()); 
-		if (xml.Error()) {
-			Print("Couldn't open XML file \"%s\".", filename.c_str()); 
-			PrintAbort(); 
-			return nullptr; 
+	FormatSlot* slot = nullptr; 
+	{
+		std::shared_lock<std::shared_mutex> lock(Format::s_mutex); 
+		Format::Formats::const_iterator it = Format::s_formats.find(name); 
+		if (it != Format::s_formats.end()) {
+			slot = it->second.get(); 
 		}
-		
-		tinyxml2::XMLElement* xmlstruct = xml.FirstChildElement("struct"); 
-		if (xmlstruct == nullptr) {
-			Print("Couldn't find \"%s\" element in XML file \"%s\".", "struct", filename.c_str()); 
-			PrintAbort(); 
-			return nullptr; 
+	}
+	if (slot == nullptr) {
+		std::unique_lock<std::shared_mutex> lock(Format::s_mutex); 
+		std::unique_ptr<FormatSlot>& entry = Format::s_formats[name]; 
+		if (!entry) {
+			entry.reset(new FormatSlot()); 
 		}
-		
-		Format& formatInfo = Format::s_formats[name]; 
-		formatInfo.m_name = name; 
-		
-		const char* formatSize = xmlstruct->Attribute("size"); 
-		if (formatSize == nullptr) {
-			Print("Missing \"%s\" attribute.", "size"); 
-		} else {
-			try {
-				formatInfo.m_size = lexical_cast<unsigned>(formatSize); 
-			} catch (const std::logic_error& e) {
-				Print(e.what()); 
-				Print("Unexpected \"%s\" attribute value (\"%s\").", "size", formatSize); 
-			}
+		slot = entry.get(); 
+	}
+	
+	// Only one thread loads a given format, the others wait for it
+	std::call_once(slot->once, [&name, slot]() {
+		Profile::Scope scope("format", name); 
+		std::unique_ptr<Format> format(new Format()); 
+		if (Format::LoadFormat(name, *format)) {
+			MemoryStats::Allocate(MemoryTag::Schemas, format->getFootprint()); 
+			slot->format = std::move(format); 
 		}
-		
-		tinyxml2::XMLElement* xmldata; 
-		for (xmldata = xmlstruct->FirstChildElement("data") ; xmldata != nullptr ; xmldata = xmldata->NextSiblingElement("data")) {
-			Attribute attribute; 
-			
-			const char* dataType = xmldata->Attribute("type"); 
-			if (dataType == nullptr) {
-				Print("Missing data \"%s\" attribute.", "type"); 
-				continue; 
-			} else if (strcmp(dataType, "Boolean") == 0) {
-				attribute.type = AttributeType::Boolean; 
-			} else if (strcmp(dataType, "Unsigned") == 0) {
-				attribute.type = AttributeType::Unsigned; 
-			} else if (strcmp(dataType, "Signed") == 0) {
-				attribute.type = AttributeType::Signed; 
-			} else if (strcmp(dataType, "Float") == 0) {
-				attribute.type = AttributeType::Float; 
-			} else if (strcmp(dataType, "String") == 0) {
-				attribute.type = AttributeType::String; 
-			} else {
-				Print("Unexpected \"%s\" attribute value (\"%s\").", "type", dataType); 
+	}); 
+	return slot->format.get(); 
+}
+
+// Forgets everything read from the file so it is loaded again on next use, no other thread may be using the registry. 
+// Those that failed to load are forgotten too, the file may be what fixes them. 
+void Format::Unload(const std::string& filename) {
+	std::unique_lock<std::shared_mutex> lock(Format::s_mutex); 
+	for (auto it = Format::s_formats.begin() ; it != Format::s_formats.end() ; ) {
+		const Format* format = it->second->format.get(); 
+		if ((format == nullptr) || (std::find(format->m_filenames.begin(), format->m_filenames.end(), filename) != format->m_filenames.end())) {
+			if (format != nullptr) {
+				MemoryStats::Release(MemoryTag::Schemas, format->getFootprint()); 
 			}
-			
-			const char* dataOffset = xmldata->Attribute("offset"); 
-			if (dataOffset == nullptr) {
-				Print("Missing data \"%s\" attribute.", "offset"); 
-				continue; 
-			} else {
-				try {
-					attribute.offset = lexical_cast<unsigned>(dataOffset, std::hex); 
-				} catch (const std::logic_error& e) {
-					Print(e.what()); 
-					Print("Unexpected \"%s\" attribute value (\"%s\").", "offset", dataOffset); 
-					continue; 
+			it = Format::s_formats.erase(it); 
+		} else {
+			it++; 
+		}
+	}
+}
+
+std::size_t Format::getFootprint() const {
+	// A list node is the attribute and two links
+	std::size_t size = sizeof(Format) + MemoryStats::GetHeapSize(this->m_name); 
+	for (auto it = this->m_attributes.begin() ; it != this->m_attributes.end() ; it++) {
+		size += sizeof(Attribute) + 2 * sizeof(void*) + MemoryStats::GetHeapSize(it->name) + MemoryStats::GetHeapSize(it->enumName); 
+	}
+	for (auto it = this->m_filenames.begin() ; it != this->m_filenames.end() ; it++) {
+		size += sizeof(std::string) + 2 * sizeof(void*) + MemoryStats::GetHeapSize(*it); 
+	}
+	return size; 
+}
+
+// Each item prints to its own buffer, and the buffers once they are all done in item order, like the jobs of RunJobs
+template<typename F>
+static void PreloadBuffered(std::size_t count, unsigned threads, F function) {
+	std::vector<std::string> outputs(count); 
+	ParallelFor(count, [&outputs, &function](std::size_t i) {
+		SetPrintBuffer(&outputs[i]); 
+		function(i); 
+		SetPrintBuffer(nullptr); 
+	}, threads); 
+	for (auto it = outputs.begin() ; it != outputs.end() ; it++) {
+		PrintBuffered(*it); 
+	}
+}
+
+void Format::Preload(const std::list<std::string>& names, unsigned threads) {
+	std::vector<std::string> formats(names.begin(), names.end()); 
+	if (formats.empty()) {
+		return; 
+	}
+	
+	Print("Preloading %zu formats...", formats.size()); 
+	PrintStart(); 
+	
+	// Loading formats, then every enumeration they reference
+	std::vector<Format*> loaded(formats.size(), nullptr); 
+	PreloadBuffered(formats.size(), threads, [&formats, &loaded](std::size_t i) {
+		loaded[i] = Format::GetFormat(formats[i]); 
+	}); 
+	
+	std::vector<std::string> enums; 
+	for (auto it = loaded.begin() ; it != loaded.end() ; it++) {
+		if (*it != nullptr) {
+			for (auto attribute = (*it)->m_attributes.begin() ; attribute != (*it)->m_attributes.end() ; attribute++) {
+				if ((attribute->enumName != "") && (std::find(enums.begin(), enums.end(), attribute->enumName) == enums.end())) {
+					enums.push_back(attribute->enumName); 
 				}
 			}
-			
-			if ((attribute.type == AttributeType::Boolean) || (attribute.type == AttributeType::Unsigned) || (attribute.type == AttributeType::Signed)) {
-				const char* dataBit	= xmldata->Attribute("bit"); 
-				if (dataBit != nullptr) {
-					try {
-						attribute.bit = lexical_cast<unsigned>(dataBit); 
-					} catch (const std::logic_error& e) {
-						Print("Unexpected \"%s\" attribute value (\"%s\").", "bit", dataBit); 
-						continue; 
-					}
-				} else if (attribute.type == AttributeType::Boolean) {
-					Print("Missing data \"%s\" attribute.", "bit"); 
+		}
+	}
+	PreloadBuffered(enums.size(), threads, [&enums](std::size_t i) {
+		Enum::GetEnum(enums[i]); 
+	}); 
+	
+	PrintDone(); 
+}
+
+bool Format::LoadFormat(const std::string& name, Format& formatInfo) {
+	if (SchemaCache::ReadFormat(name, formatInfo)) {
+		PrintVerbose("Loaded format \"%s\" from schema cache.", name.c_str()); 
+		return true; 
+	}
+	formatInfo = Format(); 
+	
+	Print("Loading format \"%s\"...", name.c_str()); 
+	PrintStart(); 
+	
+	tinyxml2::XMLDocument xml; 
+	std::string filename = strfmt("xml/fmt/%s", name.c_str()); 
+	xml.LoadFile(filename.c_str()); 
+	if (xml.Error()) {
+		PrintError("Couldn't open XML file \"%s\".", filename.c_str()); 
+		PrintAbort(); 
+		return false; 
+	}
+	
+	tinyxml2::XMLElement* xmlstruct = xml.FirstChildElement("struct"); 
+	if (xmlstruct == nullptr) {
+		PrintError("Couldn't find \"%s\" element in XML file \"%s\".", "struct", filename.c_str()); 
+		PrintAbort(); 
+		return false; 
+	}
+	
+	formatInfo.m_name = name; 
+	formatInfo.m_filenames.push_back(filename); 
+	
+	const char* formatSize = xmlstruct->Attribute("size"); 
+	if (formatSize == nullptr) {
+		PrintError("Missing \"%s\" attribute.", "size"); 
+	} else {
+		if (ParseUnsigned(formatSize, formatInfo.m_size) != std::errc()) {
+			PrintError("Unexpected \"%s\" attribute value (\"%s\").", "size", formatSize); 
+		}
+	}
+	
+	tinyxml2::XMLElement* xmldata; 
+	for (xmldata = xmlstruct->FirstChildElement("data") ; xmldata != nullptr ; xmldata = xmldata->NextSiblingElement("data")) {
+		Attribute attribute; 
+		
+		const char* dataType = xmldata->Attribute("type"); 
+		if (dataType == nullptr) {
+			PrintError("Missing data \"%s\" attribute.", "type"); 
+			continue; 
+		} else if (strcmp(dataType, "Boolean") == 0) {
+			attribute.type = AttributeType::Boolean; 
+		} else if (strcmp(dataType, "Unsigned") == 0) {
+			attribute.type = AttributeType::Unsigned; 
+		} else if (strcmp(dataType, "Signed") == 0) {
+			attribute.type = AttributeType::Signed; 
+		} else if (strcmp(dataType, "Float") == 0) {
+			attribute.type = AttributeType::Float; 
+		} else if (strcmp(dataType, "String") == 0) {
+			attribute.type = AttributeType::String; 
+		} else {
+			PrintError("Unexpected \"%s\" attribute value (\"%s\").", "type", dataType); 
+		}
+		
+		const char* dataOffset = xmldata->Attribute("offset"); 
+		if (dataOffset == nullptr) {
+			PrintError("Missing data \"%s\" attribute.", "offset"); 
+			continue; 
+		} else if (ParseHexadecimal(dataOffset, attribute.offset) != std::errc()) {
+			PrintError("Unexpected \"%s\" attribute value (\"%s\").", "offset", dataOffset); 
+			continue; 
+		}
+		
+		if ((attribute.type == AttributeType::Boolean) || (attribute.type == AttributeType::Unsigned) || (attribute.type == AttributeType::Signed)) {
+			const char* dataBit	= xmldata->Attribute("bit"); 
+			if (dataBit != nullptr) {
+				if (ParseUnsigned(dataBit, attribute.bit) != std::errc()) {
+					PrintError("Unexpected \"%s\" attribute value (\"%s\").", "bit", dataBit); 
 					continue; 
 				}
-				if (attribute.bit > 31) {
-					attribute.offset += attribute.bit / 32; 
-					attribute.bit = attribute.bit % 32; 
-				}
-			}
-			
-			if ((attribute.type == AttributeType::Unsigned) || (attribute.type == AttributeType::Signed)) {
-				const char* dataSize = xmldata->Attribute("size"); 
-				if (dataSize != nullptr) {
-					try {
-						attribute.size = lexical_cast<unsigned>(dataSize); 
-					} catch (const std::logic_error& e) {
-						Print("Unexpected \"%s\" attribute value (\"%s\").", "size", dataSize); 
-						continue; 
-					}
-				}
-				if (attribute.bit+attribute.size > 32) {
-					Print("Unexpected \"%s\" attribute value (%u).", "size", attribute.size); 
-					attribute.size = 32 - attribute.bit; 
-				}
 			} else if (attribute.type == AttributeType::Boolean) {
-				attribute.size = 1; 
-			}
-			
-			if ((attribute.type == AttributeType::Unsigned) || (attribute.type == AttributeType::Signed) || (attribute.type == AttributeType::Float)) {
-				const char* dataFormat = xmldata->Attribute("format"); 
-				if (dataFormat != nullptr) {
-					if (strcmp(dataFormat, "hexa") == 0) {
-						attribute.format = AttributeFormat::Hexadecimal; 
-					} else if (strcmp(dataFormat, "percent") == 0) {
-						attribute.format = AttributeFormat::Percentage; 
-					} else if (strcmp(dataFormat, "decimal") != 0) {
-						Print("Unexpected \"%s\" attribute value (\"%s\").", "format", dataFormat); 
-					}
-				}
+				PrintError("Missing data \"%s\" attribute.", "bit"); 
+				continue; 
 			}
-			
-			const char* dataName = xmldata->Attribute("name"); 
-			if (dataName != nullptr) {
-				attribute.name = dataName; 
-			} else {
-				attribute.name = strfmt("[0x%04X|%02d|%02d]", attribute.offset, attribute.bit, attribute.size); 
-				attribute.hidden = true; 
+			if (attribute.bit > 31) {
+				attribute.offset += attribute.bit / 32; 
+				attribute.bit = attribute.bit % 32; 
 			}
-			
-			try {
-				Print("Duplicate attribute name (\"%s\").", formatInfo.getAttribute(dataName).name.c_str()); 
+		}
+		
+		if ((attribute.type == AttributeType::Unsigned) || (attribute.type == AttributeType::Signed)) {
+			const char* dataSize = xmldata->Attribute("size"); 
+			if ((dataSize != nullptr) && (ParseUnsigned(dataSize, attribute.size) != std::errc())) {
+				PrintError("Unexpected \"%s\" attribute value (\"%s\").", "size", dataSize); 
 				continue; 
-			} catch (const std::logic_error& e) {}
-			
-			const char* dataHidden = xmldata->Attribute("hide"); 
-			if ((dataHidden != nullptr) && (strcmp(dataHidden, "true") == 0)) {
-				attribute.hidden = true; 
 			}
-			
-			if (attribute.type != AttributeType::Boolean) {
-				const char* dataEnumName = xmldata->Attribute("enum"); 
-				if (dataEnumName != nullptr) {
-					Enum* dataEnum = Enum::GetEnum(dataEnumName); 
-					if (dataEnum != nullptr) {
-						if (dataEnum->getType() == attribute.type) {
-							attribute.enumName = dataEnumName; 
-						} else {
-							Print("Data type does not match with enumeration %s.", dataEnumName); 
+			if (attribute.bit+attribute.size > 32) {
+				PrintError("Unexpected \"%s\" attribute value (%u).", "size", attribute.size); 
+				attribute.size = 32 - attribute.bit; 
+			}
+		} else if (attribute.type == AttributeType::Boolean) {
+			attribute.size = 1; 
+		}
+		
+		if ((attribute.type == AttributeType::Unsigned) || (attribute.type == AttributeType::Signed) || (attribute.type == AttributeType::Float)) {
+			const char* dataFormat = xmldata->Attribute("format"); 
+			if (dataFormat != nullptr) {
+				if (strcmp(dataFormat, "hexa") == 0) {
+					attribute.format = AttributeFormat::Hexadecimal; 
+				} else if (strcmp(dataFormat, "percent") == 0) {
+					attribute.format = AttributeFormat::Percentage; 
+				} else if (strcmp(dataFormat, "decimal") != 0) {
+					PrintError("Unexpected \"%s\" attribute value (\"%s\").", "format", dataFormat); 
+				}
+			}
+		}
+		
+		const char* dataName = xmldata->Attribute("name"); 
+		if (dataName != nullptr) {
+			attribute.name = dataName; 
+		} else {
+			attribute.name = strfmt("[0x%04X|%02d|%02d]", attribute.offset, attribute.bit, attribute.size); 
+			attribute.hidden = true; 
+		}
+		
+		try {
+			PrintError("Duplicate attribute name (\"%s\").", formatInfo.getAttribute(dataName).name.c_str()); 
+			continue; 
+		} catch (const std::logic_error& e) {} 
+		
+		const char* dataHidden = xmldata->Attribute("hide"); 
+		if ((dataHidden != nullptr) && (strcmp(dataHidden, "true") == 0)) {
+			attribute.hidden = true; 
+		}
+		
+		if (attribute.type != AttributeType::Boolean) {
+			const char* dataEnumName = xmldata->Attribute("enum"); 
+			if (dataEnumName != nullptr) {
+				Enum* dataEnum = Enum::GetEnum(dataEnumName); 
+				if (dataEnum != nullptr) {
+					if (dataEnum->getType() == attribute.type) {
+						attribute.enumName = dataEnumName; 
+						for (auto it = dataEnum->getFilenames().begin() ; it != dataEnum->getFilenames().end() ; it++) {
+							if (std::find(formatInfo.m_filenames.begin(), formatInfo.m_filenames.end(), *it) == formatInfo.m_filenames.end()) {
+								formatInfo.m_filenames.push_back(*it); 
+							}
 						}
+					} else {
+						PrintError("Data type does not match with enumeration %s.", dataEnumName); 
 					}
 				}
 			}
-			
-			formatInfo.m_attributes.push_back(attribute); 
 		}
 		
-		PrintDone(); 
-		return &formatInfo; 
-	} else {
-		return &it->second; 
+		formatInfo.m_attributes.push_back(attribute); 
 	}
+	
+	SchemaCache::WriteFormat(formatInfo); 
+	PrintDone(); 
+	return true; 
 }
@@ -0,0 +1,266 @@
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+#include "include/Log.hpp"
+
+using namespace dbtool; 
+
+// Each thread keeps its own indentation, buffer and context
+static thread_local int PrintIndent = 0; 
+static thread_local std::string* PrintBuffer = nullptr; 
+static thread_local std::string* ErrorBuffer = nullptr; 
+static thread_local std::string PrintContext; 
+static std::atomic<LogLevel> PrintLevel(LogLevel::Info); 
+
+// Multiple producers, single consumer queue of whole lines.
+// Producers swap themselves in as the head and link the previous head to them, the writer follows the links from the tail.
+struct LogNode {
+	std::atomic<LogNode*>	next; 
+	std::string				text; 
+}; 
+
+class LogWriter {
+	private: 
+		std::atomic<LogNode*> m_head; 
+		LogNode* m_tail; 
+		std::atomic<unsigned long long> m_queued; 
+		std::atomic<unsigned long long> m_written; 
+		std::atomic<bool> m_idle; 
+		bool m_stop; 
+		std::mutex m_mutex; 
+		std::condition_variable m_wakeUp; 
+		std::condition_variable m_flushed; 
+		std::thread m_thread; 
+		
+		LogNode* pop () {
+			LogNode* next = this->m_tail->next.load(std::memory_order_acquire); 
+			if (next == nullptr) {
+				return nullptr; 
+			}
+			delete this->m_tail; 
+			this->m_tail = next; 
+			return next; 
+		}
+		
+		void run () {
+			std::string chunk; 
+			while (true) {
+				unsigned long long count = 0; 
+				for (LogNode* node = this->pop() ; node != nullptr ; node = this->pop()) {
+					chunk += node->text; 
+					node->text.clear(); 
+					count++; 
+				}
+				if (count > 0) {
+					fwrite(chunk.data(), 1, chunk.size(), stdout); 
+					fflush(stdout); 
+					chunk.clear(); 
+					this->m_written += count; 
+					std::lock_guard<std::mutex> lock(this->m_mutex); 
+					this->m_flushed.notify_all(); 
+					continue; 
+				}
+				
+				// Producers only take the lock to wake the writer up once it said it is going to sleep
+				std::unique_lock<std::mutex> lock(this->m_mutex); 
+				this->m_idle = true; 
+				if (this->m_written == this->m_queued) {
+					if (this->m_stop == true) {
+						return; 
+					}
+					this->m_wakeUp.wait(lock, [this]() {
+						return (this->m_written != this->m_queued) || (this->m_stop == true); 
+					}); 
+				}
+				this->m_idle = false; 
+			}
+		}
+		
+	public: 
+		LogWriter ()
+			:m_head(new LogNode()), m_tail(nullptr), m_queued(0), m_written(0), m_idle(false), m_stop(false), m_mutex(), m_wakeUp(), m_flushed(), m_thread() {
+				this->m_tail = this->m_head.load(); 
+				this->m_tail->next = nullptr; 
+				this->m_thread = std::thread(&LogWriter::run, this); 
+			}
+		~LogWriter () {
+			{
+				std::lock_guard<std::mutex> lock(this->m_mutex); 
+				this->m_stop = true; 
+			}
+			this->m_wakeUp.notify_all(); 
+			this->m_thread.join(); 
+			delete this->m_tail; 
+		}
+		
+		void push (std::string&& text) {
+			LogNode* node = new LogNode(); 
+			node->next.store(nullptr, std::memory_order_relaxed); 
+			node->text = std::move(text); 
+			this->m_queued++; 
+			LogNode* previous = this->m_head.exchange(node, std::memory_order_acq_rel); 
+			previous->next.store(node, std::memory_order_release); 
+			if (this->m_idle == true) {
+				std::lock_guard<std::mutex> lock(this->m_mutex); 
+				this->m_wakeUp.notify_one(); 
+			}
+		}
+		
+		void flush () {
+			unsigned long long queued = this->m_queued; 
+			std::unique_lock<std::mutex> lock(this->m_mutex); 
+			this->m_flushed.wait(lock, [this, queued]() {
+				return this->m_written >= queued; 
+			}); 
+		}
+}; 
+
+static LogWriter& GetWriter() {
+	static LogWriter writer; 
+	return writer; 
+}
+
+static void PrintLine(const char* format, va_list args, const std::string& context = "") {
+	std::string line; 
+	if (PrintIndent > 0) {
+		line.assign(PrintIndent, '>'); 
+		line += ' '; 
+	}
+	if (!context.empty()) {
+		line += context; 
+		line += ": "; 
+	}
+	va_list size; 
+	va_copy(size, args); 
+	int length = vsnprintf(nullptr, 0, format, size); 
+	va_end(size); 
+	if (length > 0) {
+		std::string::size_type start = line.size(); 
+		line.resize(start + length + 1); 
+		vsnprintf(&line[start], length + 1, format, args); 
+		line.resize(start + length); 
+	}
+	line += '\n'; 
+	if (PrintBuffer != nullptr) {
+		*PrintBuffer += line; 
+		return; 
+	}
+	GetWriter().push(std::move(line)); 
+}
+
+void dbtool::SetLogLevel(LogLevel level) {
+	PrintLevel = level; 
+}
+
+LogLevel dbtool::GetLogLevel() {
+	return PrintLevel.load(std::memory_order_relaxed); 
+}
+
+void dbtool::LogFlush() {
+	GetWriter().flush(); 
+}
+
+int dbtool::GetPrintIndent() {
+	return PrintIndent; 
+}
+
+void dbtool::SetPrintIndent(int indent) {
+	PrintIndent = indent; 
+}
+
+void dbtool::SetPrintBuffer(std::string* buffer) {
+	PrintBuffer = buffer; 
+}
+
+void dbtool::SetErrorBuffer(std::string* buffer) {
+	ErrorBuffer = buffer; 
+}
+
+void dbtool::PrintBuffered(const std::string& buffer) {
+	if (!buffer.empty()) {
+		GetWriter().push(std::string(buffer)); 
+	}
+}
+
+void dbtool::SetPrintContext(const std::string& context) {
+	PrintContext = context; 
+}
+
+void dbtool::Print() {
+	if (GetLogLevel() < LogLevel::Info) {
+		return; 
+	} else if (PrintBuffer != nullptr) {
+		*PrintBuffer += '\n'; 
+		return; 
+	}
+	GetWriter().push("\n"); 
+}
+
+void dbtool::Print(const std::string& format, ...) {
+	if (GetLogLevel() >= LogLevel::Info) {
+		va_list args; 
+		va_start(args, format); 
+		PrintLine(format.c_str(), args); 
+		va_end(args); 
+	}
+}
+
+void dbtool::PrintVerbose(const std::string& format, ...) {
+	if (GetLogLevel() >= LogLevel::Verbose) {
+		va_list args; 
+		va_start(args, format); 
+		PrintLine(format.c_str(), args); 
+		va_end(args); 
+	}
+}
+
+void dbtool::PrintError(const std::string& format, ...) {
+	// Without the lines leading up to it, the error says which file it is about.
+	// The context is a file name, it is written as is and never read as part of the format.
+	bool quiet = (GetLogLevel() < LogLevel::Info); 
+	va_list args; 
+	va_start(args, format); 
+	if (ErrorBuffer != nullptr) {
+		va_list copy; 
+		va_copy(copy, args); 
+		int length = vsnprintf(nullptr, 0, format.c_str(), copy); 
+		va_end(copy); 
+		if (length > 0) {
+			std::string::size_type start = ErrorBuffer->size(); 
+			ErrorBuffer->resize(start + length + 1); 
+			va_copy(copy, args); 
+			vsnprintf(&(*ErrorBuffer)[start], length + 1, format.c_str(), copy); 
+			va_end(copy); 
+			(*ErrorBuffer)[start + length] = '\n'; 
+		}
+	}
+	PrintLine(format.c_str(), args, quiet? PrintContext : std::string()); 
+	va_end(args); 
+}
+
+void dbtool::PrintStart() {
+	PrintIndent++; 
+}
+
+void dbtool::PrintDone() {
+	if (PrintIndent > 0) {
+		PrintIndent--; 
+	}
+	if (PrintIndent == 0) {
+		Print(); 
+	}
+}
+
+void dbtool::PrintAbort() {
+	// Only tells where the console output of a step stops, the error buffer already has the reason
+	std::string* errors = ErrorBuffer; 
+	ErrorBuffer = nullptr; 
+	PrintError("ABORTED"); 
+	ErrorBuffer = errors; 
+	PrintDone(); 
+}
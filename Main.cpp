@@ -1,27 +1,573 @@
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
 #include <cstdlib>
-#include <fstream>
+#include <functional>
 #include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <string>
-#include <windows.h>
+#include <string_view>
+#include <vector>
 
+#include "include/Archive.hpp"
+#include "include/Enum.hpp"
+#include "include/Format.hpp"
+#include "include/Manifest.hpp"
+#include "include/MappedFile.hpp"
+#include "include/MemoryStats.hpp"
+#include "include/Profile.hpp"
+#include "include/Query.hpp"
+#include "include/SchemaCache.hpp"
+#include "include/ThreadPool.hpp"
 #include "include/Tools.hpp"
+#include "include/Watcher.hpp"
 #include "include/WPDFile.hpp"
 #include "tinyxml2/tinyxml2.h"
 
 using namespace dbtool; 
 
+static const std::string ManifestGenerate = ".dbtool/generate.manifest"; 
+static const std::string ManifestPatch = ".dbtool/patch.manifest"; 
+static const std::string SchemaCacheFile = ".dbtool/schema.cache"; 
+static const std::string ArchiveList = "sys/filelistc.win32.bin"; 
+static const std::string ArchiveImage = "sys/white_imgc.win32.bin"; 
+static const std::string BaseFolder = ".dbtool/base"; 
+
+// What the filelists ask of a file, its patches in filelist order
+struct FileStep {
+	std::string		patch; 
+	std::string		format; 
+	std::string		filter; 
+}; 
+
+struct FileTarget {
+	std::string				name; 
+	std::vector<FileStep>	steps; 
+}; 
+
+// Loads every format the targets use, and the enumerations they reference, before any file is processed
+static void PreloadFormats (const std::vector<FileTarget>& targets, unsigned threads) {
+	std::list<std::string> formats; 
+	for (auto target = targets.begin() ; target != targets.end() ; target++) {
+		for (auto step = target->steps.begin() ; step != target->steps.end() ; step++) {
+			if ((step->format != "") && (std::find(formats.begin(), formats.end(), step->format) == formats.end())) {
+				formats.push_back(step->format); 
+			}
+		}
+	}
+	Format::Preload(formats, threads); 
+}
+
+// Returns the filelist element of the filelist, or nullptr once the error is printed
+static tinyxml2::XMLElement* OpenFilelist (const std::string& filelist, tinyxml2::XMLDocument& xml) {
+	if (filelist == "") {
+		PrintError("Missing filelist argument."); 
+		return nullptr; 
+	}
+	
+	Profile::Scope scope("filelist", filelist); 
+	Print("Reading filelist \"%s\"...", filelist.c_str()); 
+	PrintStart(); 
+	
+	xml.LoadFile(filelist.c_str()); 
+	if (xml.Error()) {
+		PrintError("Couldn't open XML filelist \"%s\".", filelist.c_str()); 
+		PrintAbort(); 
+		return nullptr; 
+	}
+	
+	tinyxml2::XMLElement* xmlfilelist = xml.FirstChildElement("filelist"); 
+	if (xmlfilelist == nullptr) {
+		PrintError("Missing filelist element."); 
+		PrintAbort(); 
+		return nullptr; 
+	}
+	
+	PrintDone(); 
+	return xmlfilelist; 
+}
+
+// How much memory working on a WPD file of that size takes: its entries, plus the patch file built from them
+static unsigned long long EstimateFootprint (unsigned long long size) {
+	return size * 3; 
+}
+
+// Reads a size in bytes, with an optional K, M or G suffix
+static bool ParseSize (const std::string& text, unsigned long long& size) {
+	std::size_t end = text.find_first_not_of("0123456789"); 
+	if ((end == 0) || (text.empty())) {
+		return false; 
+	}
+	size = std::strtoull(text.substr(0, end).c_str(), nullptr, 10); 
+	if (end == std::string::npos) {
+		return true; 
+	}
+	
+	std::string suffix = text.substr(end); 
+	if ((suffix == "K") || (suffix == "k")) {
+		size <<= 10; 
+	} else if ((suffix == "M") || (suffix == "m")) {
+		size <<= 20; 
+	} else if ((suffix == "G") || (suffix == "g")) {
+		size <<= 30; 
+	} else {
+		return false; 
+	}
+	return true; 
+}
+
+// Runs job(i) for every job and returns which ones succeeded, files[i] being the file job i works on. 
+// With a pool the jobs are spread over its threads, biggest WPD first, and jobs on the same file run one after another. 
+// With a memory budget a file's jobs only start once its estimated footprint fits next to the files being worked on, 
+// a file too big for the budget waiting for the others to be done. Files read from the archive are sized from its file list. 
+// Each job's output is held back and printed in order, so the console reads as if the run had been sequential. 
+static std::vector<bool> RunJobs (const std::vector<std::string>& files, ThreadPool* pool, unsigned long long maxMemory, const Archive* archive, const std::function<bool(std::size_t)>& job) {
+	std::vector<bool> results(files.size(), false); 
+	if ((pool == nullptr) || (files.size() <= 1)) {
+		for (std::size_t i = 0 ; i < files.size() ; i++) {
+			Profile::Scope scope("job", files[i]); 
+			MemoryStats::FileScope memory(files[i]); 
+			SetPrintContext(files[i]); 
+			results[i] = job(i); 
+		}
+		SetPrintContext(""); 
+		return results; 
+	}
+	
+	struct Group {
+		std::vector<std::size_t>	jobs; 
+		unsigned long long			size; 
+	}; 
+	std::vector<Group> groups; 
+	std::map<std::string, std::size_t> groupIndex; 
+	for (std::size_t i = 0 ; i < files.size() ; i++) {
+		if (files[i] != "") {
+			auto it = groupIndex.find(files[i]); 
+			if (it != groupIndex.end()) {
+				groups[it->second].jobs.push_back(i); 
+				continue; 
+			}
+			groupIndex[files[i]] = groups.size(); 
+		}
+		
+		Group group; 
+		group.jobs.push_back(i); 
+		FileStatus status; 
+		if (files[i] == "") {
+			group.size = 0; 
+		} else if (archive != nullptr) {
+			group.size = archive->getFileSize(files[i]); 
+		} else {
+			group.size = GetFileStatus(strfmt("sys/%s", files[i].c_str()), status)? status.size : 0; 
+		}
+		groups.push_back(group); 
+	}
+	std::stable_sort(groups.begin(), groups.end(), [](const Group& a, const Group& b) {
+		return a.size > b.size; 
+	}); 
+	
+	std::vector<std::string> outputs(files.size()); 
+	std::unique_ptr<bool[]> done(new bool[files.size()]()); 
+	std::unique_ptr<bool[]> succeeded(new bool[files.size()]()); 
+	std::mutex mutex; 
+	std::condition_variable finished; 
+	std::condition_variable released; 
+	unsigned long long used = 0; 
+	for (auto it = groups.begin() ; it != groups.end() ; it++) {
+		std::vector<std::size_t> jobs = it->jobs; 
+		unsigned long long footprint = (maxMemory != 0)? std::min(EstimateFootprint(it->size), maxMemory) : 0; 
+		pool->submit([&, jobs, footprint]() {
+			if (footprint != 0) {
+				std::unique_lock<std::mutex> lock(mutex); 
+				released.wait(lock, [&]() {
+					return used + footprint <= maxMemory; 
+				}); 
+				used += footprint; 
+			}
+			
+			for (auto index = jobs.begin() ; index != jobs.end() ; index++) {
+				SetPrintBuffer(&outputs[*index]); 
+				SetPrintContext(files[*index]); 
+				bool result; 
+				{
+					Profile::Scope scope("job", files[*index]); 
+					MemoryStats::FileScope memory(files[*index]); 
+					result = job(*index); 
+				}
+				SetPrintContext(""); 
+				SetPrintBuffer(nullptr); 
+				
+				std::lock_guard<std::mutex> lock(mutex); 
+				succeeded[*index] = result; 
+				done[*index] = true; 
+				finished.notify_all(); 
+			}
+			
+			if (footprint != 0) {
+				std::lock_guard<std::mutex> lock(mutex); 
+				used -= footprint; 
+				released.notify_all(); 
+			}
+		}); 
+	}
+	
+	for (std::size_t i = 0 ; i < files.size() ; i++) {
+		{
+			std::unique_lock<std::mutex> lock(mutex); 
+			finished.wait(lock, [&]() {
+				return done[i]; 
+			}); 
+		}
+		PrintBuffered(outputs[i]); 
+		outputs[i].clear(); 
+		results[i] = succeeded[i]; 
+	}
+	pool->wait(); 
+	return results; 
+}
+
+// Runs job for every target and returns which ones succeeded, in target order
+static std::vector<bool> RunTargets (const std::vector<FileTarget>& targets, ThreadPool* pool, unsigned long long maxMemory, const Archive* archive, const std::function<bool(const FileTarget&)>& job) {
+	std::vector<std::string> files; 
+	for (auto target = targets.begin() ; target != targets.end() ; target++) {
+		files.push_back(target->name); 
+	}
+	return RunJobs(files, pool, maxMemory, archive, [&targets, &job](std::size_t i) {
+		return job(targets[i]); 
+	}); 
+}
+
+// Reads every filelist into a single list of targets, one per file, so that each file is loaded and saved once however many elements name it. 
+// Patches keep their filelist order. Without requireFormat, a missing format (or "default") leaves the step's format empty. 
+static std::vector<FileTarget> ReadTargets (const std::list<std::string>& filelists, bool requireFormat) {
+	std::vector<FileTarget> targets; 
+	std::map<std::string, std::size_t> targetIndex; 
+	for (auto it = filelists.begin() ; it != filelists.end() ; it++) {
+		tinyxml2::XMLDocument xml; 
+		tinyxml2::XMLElement* xmlfilelist = OpenFilelist(*it, xml); 
+		if (xmlfilelist == nullptr) {
+			continue; 
+		}
+		
+		tinyxml2::XMLElement* xmlfile; 
+		for (xmlfile = xmlfilelist->FirstChildElement("file") ; xmlfile != nullptr ; xmlfile = xmlfile->NextSiblingElement("file")) {
+			const char* fileName = xmlfile->Attribute("name"); 
+			const char* fileFormat = xmlfile->Attribute("format"); 
+			if ((fileName == nullptr) || ((fileFormat == nullptr) && (requireFormat == true))) {
+				PrintError("Missing file \"%s\" attribute.", (fileName == nullptr)? "name" : "format"); 
+				continue; 
+			}
+			std::string format = (fileFormat != nullptr)? fileFormat : ""; 
+			if ((requireFormat == false) && (format == "default")) {
+				format.clear(); 
+			}
+			
+			auto index = targetIndex.find(fileName); 
+			if (index == targetIndex.end()) {
+				index = targetIndex.emplace(fileName, targets.size()).first; 
+				targets.emplace_back(); 
+				targets.back().name = fileName; 
+			}
+			FileTarget& target = targets[index->second]; 
+			tinyxml2::XMLElement* xmlpatch; 
+			for (xmlpatch = xmlfile->FirstChildElement("patch") ; xmlpatch != nullptr ; xmlpatch = xmlpatch->NextSiblingElement("patch")) {
+				const char* patchName = xmlpatch->Attribute("name"); 
+				const char* patchFilter = xmlpatch->Attribute("filter"); 
+				if (patchName == nullptr) {
+					PrintError("Missing patch \"%s\" attribute.", "name"); 
+					continue; 
+				}
+				FileStep step; 
+				step.patch = strfmt("patch/%s", patchName); 
+				step.format = format; 
+				step.filter = (patchFilter != nullptr)? patchFilter : "*"; 
+				target.steps.push_back(step); 
+			}
+		}
+	}
+	return targets; 
+}
+
+// Writes the patch files of the file again, skipping those already generated from the same inputs. The file is only loaded if one of them is stale, 
+// and not even then when working on it would take more than the memory budget: its patch files are streamed from it an entry at a time instead. 
+static bool GenerateTarget (const FileTarget& target, Manifest& manifest, const Archive* archive, bool showAll, unsigned long long maxMemory) {
+	std::string filePath = strfmt("sys/%s", target.name.c_str()); 
+	
+	// Archive entries are read first, the manifest can't hash them from the disk
+	std::string_view data; 
+	std::string buffer; 
+	if (archive != nullptr) {
+		filePath = strfmt("%s/%s", ArchiveImage.c_str(), target.name.c_str()); 
+		if (!archive->read(target.name, data, buffer)) {
+			PrintError("Couldn't read file \"%s\" from the archive.", target.name.c_str()); 
+			return false; 
+		}
+		manifest.setMemoryHash(filePath, HashData(data.data(), data.size())); 
+	}
+	
+	std::vector<std::string> options; 
+	std::vector<bool> stale; 
+	bool upToDate = true; 
+	for (auto step = target.steps.begin() ; step != target.steps.end() ; step++) {
+		options.push_back(strfmt("%s|%s|%d", (step->format != "")? step->format.c_str() : "default", step->filter.c_str(), showAll)); 
+		stale.push_back(!manifest.isUpToDate(step->patch, options.back())); 
+		upToDate = upToDate && (!stale.back()); 
+	}
+	
+	if (upToDate == true) {
+		PrintVerbose("Patch files for \"%s\" are up to date.", filePath.c_str()); 
+		return true; 
+	}
+	
+	// Mapping the file to stream it only if it won't fit the budget loaded
+	MappedFile mapping; 
+	FileStatus status; 
+	bool stream = false; 
+	if (maxMemory != 0) {
+		unsigned long long size = (archive != nullptr)? data.size() : (GetFileStatus(filePath, status)? status.size : 0); 
+		stream = EstimateFootprint(size) > maxMemory; 
+	}
+	if ((stream == true) && (archive == nullptr)) {
+		if (!mapping.open(filePath)) {
+			PrintError("Couldn't open file \"%s\".", filePath.c_str()); 
+			return false; 
+		}
+		Profile::Count(ProfileCounter::BytesRead, mapping.size()); 
+		data = std::string_view(mapping.data(), mapping.size()); 
+	}
+	
+	WPDFile file; 
+	if ((stream == false) && (!((archive != nullptr)? file.load(filePath, data) : file.load(filePath)))) {
+		return false; 
+	}
+	
+	for (std::size_t i = 0 ; i < target.steps.size() ; i++) {
+		const FileStep& step = target.steps[i]; 
+		if (stale[i] == false) {
+			continue; 
+		}
+		
+		std::list<std::string> inputs; 
+		inputs.push_back(filePath); 
+		if (stream == true) {
+			if (!WPDFile::ConvertStream(data, step.patch, step.format, step.filter, showAll)) {
+				continue; 
+			}
+		} else if (step.format == "") {
+			if (!file.convert(step.patch, step.filter, showAll)) {
+				continue; 
+			}
+		} else {
+			if (!file.convert(step.patch, step.format, step.filter, showAll)) {
+				continue; 
+			}
+		}
+		if (step.format != "") {
+			const std::list<std::string>& formatFiles = Format::GetFormat(step.format)->getFilenames(); 
+			inputs.insert(inputs.end(), formatFiles.begin(), formatFiles.end()); 
+		}
+		manifest.setOutput(step.patch, inputs, options[i]); 
+	}
+	
+	return true; 
+}
+
+// Makes sure the pristine copy of the file is current. 
+// The file in sys is taken as the pristine copy the first time, and again whenever it was replaced outside of dbtool. 
+static bool UpdateBase (const std::string& name, Manifest& manifest) {
+	std::string filePath = strfmt("sys/%s", name.c_str()); 
+	std::string basePath = strfmt("%s/%s", BaseFolder.c_str(), name.c_str()); 
+	
+	FileStatus status; 
+	unsigned long long built, current; 
+	bool replaced = manifest.getOutputHash(filePath, built) && manifest.getFileHash(filePath, current) && (built != current); 
+	if ((replaced == false) && GetFileStatus(basePath, status)) {
+		return true; 
+	}
+	
+	std::string content; 
+	bool written; 
+	if (!ReadWholeFile(filePath, content)) {
+		PrintError("File \"%s\" does not exist.", filePath.c_str()); 
+		return false; 
+	}
+	Print("Keeping \"%s\" as the pristine copy of \"%s\"...", basePath.c_str(), filePath.c_str()); 
+	if (!UpdateFile(basePath, content, written)) {
+		PrintError("Couldn't write file \"%s\".", basePath.c_str()); 
+		return false; 
+	}
+	return true; 
+}
+
+// Lists everything the patched file is built from: its pristine copy, patches, formats and enumerations, and returns the option string for the manifest
+static bool GetTargetInputs (const FileTarget& target, std::list<std::string>& inputs, std::string& options) {
+	inputs.clear(); 
+	options.clear(); 
+	inputs.push_back(strfmt("%s/%s", BaseFolder.c_str(), target.name.c_str())); 
+	for (auto step = target.steps.begin() ; step != target.steps.end() ; step++) {
+		Format* format = Format::GetFormat(step->format); 
+		if (format == nullptr) {
+			PrintError("Couldn't load format \"%s\".", step->format.c_str()); 
+			return false; 
+		}
+		inputs.push_back(step->patch); 
+		inputs.insert(inputs.end(), format->getFilenames().begin(), format->getFilenames().end()); 
+		options += step->format + "|"; 
+	}
+	return true; 
+}
+
+// Patches the file again from its pristine copy, unless it was already built from the same inputs
+static bool BuildTarget (const FileTarget& target, Manifest& manifest) {
+	std::string filePath = strfmt("sys/%s", target.name.c_str()); 
+	std::list<std::string> inputs; 
+	std::string options; 
+	if ((!UpdateBase(target.name, manifest)) || (!GetTargetInputs(target, inputs, options))) {
+		return false; 
+	} else if (manifest.isUpToDate(filePath, options)) {
+		PrintVerbose("File \"%s\" is up to date.", filePath.c_str()); 
+		return false; 
+	}
+	
+	std::string content; 
+	WPDFile file; 
+	if ((!ReadWholeFile(inputs.front(), content)) || (!file.load(inputs.front(), content))) {
+		return false; 
+	}
+	for (auto step = target.steps.begin() ; step != target.steps.end() ; step++) {
+		file.patch(step->patch, step->format); 
+	}
+	if (!file.save(filePath)) {
+		return false; 
+	}
+	manifest.setOutput(filePath, inputs, options); 
+	return true; 
+}
+
+// Keeps the target files in memory and patches them again from their pristine copy whenever one of their inputs changes
+static void WatchTargets (const std::vector<FileTarget>& targets, Manifest& manifest, bool importc) {
+	struct Resident {
+		FileTarget				target; 
+		std::set<std::string>	dependencies; 
+		WPDFile					base; 
+	}; 
+	
+	std::list<Resident> residents; 
+	for (auto it = targets.begin() ; it != targets.end() ; it++) {
+		std::string basePath = strfmt("%s/%s", BaseFolder.c_str(), it->name.c_str()); 
+		std::string content; 
+		if ((UpdateBase(it->name, manifest)) && (ReadWholeFile(basePath, content))) {
+			residents.emplace_back(); 
+			residents.back().target = *it; 
+			if (!residents.back().base.load(basePath, content)) {
+				residents.pop_back(); 
+			}
+		}
+	}
+	
+	Watcher watcher; 
+	std::list<Resident*> affected; 
+	for (auto it = residents.begin() ; it != residents.end() ; it++) {
+		affected.push_back(&(*it)); 
+	}
+	for (bool initial = true ; true ; initial = false) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now(); 
+		
+		std::list<std::string> files; 
+		for (auto it = affected.begin() ; it != affected.end() ; it++) {
+			Resident& resident = **it; 
+			std::string filePath = strfmt("sys/%s", resident.target.name.c_str()); 
+			std::list<std::string> inputs; 
+			std::string options; 
+			bool valid = GetTargetInputs(resident.target, inputs, options); 
+			
+			// Formats that failed to load are watched too, fixing them has to trigger a rebuild
+			resident.dependencies.clear(); 
+			resident.dependencies.insert(++inputs.begin(), inputs.end()); 
+			for (auto step = resident.target.steps.begin() ; step != resident.target.steps.end() ; step++) {
+				resident.dependencies.insert(step->patch); 
+				resident.dependencies.insert(strfmt("xml/fmt/%s", step->format.c_str())); 
+			}
+			for (auto dependency = resident.dependencies.begin() ; dependency != resident.dependencies.end() ; dependency++) {
+				watcher.add(*dependency); 
+			}
+			if ((valid == false) || ((initial == true) && (manifest.isUpToDate(filePath, options)))) {
+				continue; 
+			}
+			
+			WPDFile file = resident.base; 
+			for (auto step = resident.target.steps.begin() ; step != resident.target.steps.end() ; step++) {
+				file.patch(step->patch, step->format); 
+			}
+			if (file.save(filePath)) {
+				manifest.setOutput(filePath, inputs, options); 
+				files.push_back(resident.target.name); 
+			}
+		}
+		if ((importc == true) && (!files.empty())) {
+			Archive archive; 
+			if (archive.open(ArchiveList, ArchiveImage)) {
+				archive.import(files, "sys"); 
+			}
+		}
+		if (manifest.getModified()) {
+			manifest.save(ManifestPatch); 
+		}
+		SchemaCache::Save(); 
+		
+		double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(); 
+		Print("%zu files rebuilt in %.1f ms, watching %u files for changes...", files.size(), elapsed, watcher.getFileCount()); 
+		Profile::Report(); 
+		MemoryStats::Report(); 
+		LogFlush(); 
+		
+		std::list<std::string> changed; 
+		watcher.wait(changed); 
+		affected.clear(); 
+		for (auto it = changed.begin() ; it != changed.end() ; it++) {
+			PrintVerbose("File \"%s\" changed.", it->c_str()); 
+			ForgetFileStatus(*it); 
+			Format::Unload(*it); 
+			Enum::Unload(*it); 
+		}
+		for (auto it = residents.begin() ; it != residents.end() ; it++) {
+			for (auto file = changed.begin() ; file != changed.end() ; file++) {
+				if (it->dependencies.find(*file) != it->dependencies.end()) {
+					affected.push_back(&(*it)); 
+					break; 
+				}
+			}
+		}
+	}
+}
+
 int main (int argc, char** argv) {
 
 	// Commands: 
 	// -h or -?				Display help. 
 	// -P filelist			Patch all files in the filelist. 
 	// -G filelist			Generate all patch files for files in the filelist. 
+	// -D original modified patch [format]	Write the patch file turning one WPD file into the other. 
+	// -Q file format query [output.csv]	Print or export the entries matching the query. 
+	// -F file format		Write a format for the file from its !!strtypelist. 
 	
 	// Options: 
 	// -v					Verbose (show more information)
+	// -q					Quiet (only show errors)
 	// -s					Show hidden values
 	// -c					Import modified files to white_imgc
+	// -a					Read files from white_imgc instead of sys (-G)
+	// --watch				Keep patching files as their patch files change (-P)
+	// -j threads			Process files on that many threads (0 for one per core)
+	// --max-memory=size	Only work on as many files at once as fit in that much memory (K, M or G)
+	// --profile			Print where the time went
+	// --trace=file.json	Write a trace of the run (chrome://tracing)
+	// --mem-stats			Print how much memory each part took, and each file
 	
 	if (argc == 1) {
 		goto ShowHelp; 
@@ -29,24 +575,66 @@ int main (int argc, char** argv) {
 		std::string command = argv[1]; 
 		
 		bool importc = false; 
-		bool verbose = false; 
+		bool fromArchive = false; 
+		bool watch = false; 
+		LogLevel level = LogLevel::Info; 
 		bool showAll = false; 
+		unsigned threads = 1; 
+		unsigned long long maxMemory = 0; 
+		bool profile = false; 
+		bool memoryStats = false; 
+		std::string trace; 
+		std::list<std::string> filelists; 
 		for (int i = 2 ; i < argc ; i++) {
 			std::string arg = argv[i]; 
 			if (arg[0] == '-') {
 				if (arg == "-v") {
-					verbose = true; 
+					level = LogLevel::Verbose; 
+				} else if (arg == "-q") {
+					level = LogLevel::Error; 
 				} else if (arg == "-s") {
 					showAll = true; 
 				} else if (arg == "-c") {
 					importc = true; 
+				} else if (arg == "-a") {
+					fromArchive = true; 
+				} else if (arg == "--watch") {
+					watch = true; 
+				} else if (arg == "--profile") {
+					profile = true; 
+				} else if (arg == "--mem-stats") {
+					memoryStats = true; 
+				} else if (arg.compare(0, 8, "--trace=") == 0) {
+					trace = arg.substr(8); 
+				} else if (arg.compare(0, 13, "--max-memory=") == 0) {
+					if (!ParseSize(arg.substr(13), maxMemory)) {
+						PrintError("Invalid memory size (\"%s\").", arg.substr(13).c_str()); 
+						goto ShowHelp; 
+					}
+				} else if ((arg.compare(0, 2, "-j") == 0) && ((arg.size() > 2) || (i + 1 < argc))) {
+					std::string count = (arg.size() > 2)? arg.substr(2) : argv[++i]; 
+					if (ParseUnsigned(count, threads) != std::errc()) {
+						PrintError("Invalid thread count (\"%s\").", count.c_str()); 
+						goto ShowHelp; 
+					}
+					if (threads == 0) {
+						threads = ThreadPool::GetDefaultThreadCount(); 
+					}
 				} else {
-					Print("Unknown option (\"%s\").", arg.c_str()); 
+					PrintError("Unknown option (\"%s\").", arg.c_str()); 
 					goto ShowHelp; 
 				}
+			} else {
+				filelists.push_back(arg); 
 			}
 		}
-		SetVerboseMode(verbose); 
+		SetLogLevel(level); 
+		Profile::Enable(profile, trace); 
+		if (memoryStats == true) {
+			MemoryStats::Enable(); 
+		}
+		SchemaCache::Open(SchemaCacheFile); 
+		std::unique_ptr<ThreadPool> pool((threads > 1)? new ThreadPool(threads) : nullptr); 
 		
 		// -h or -? = Help
 		if ((command == "-h") || (command == "-?")) {
@@ -54,173 +642,126 @@ int main (int argc, char** argv) {
 			
 		// -G = Generate all
 		} else if (command == "-G") {
-			for (int i = 2 ; i < argc ; i++) {
-				std::string filelist = argv[i]; 
-				if (filelist[0] != '-') {
-					if (filelist == "") {
-						Print("Missing filelist argument."); 
-						continue; 
-					}
-					
-					Print("Reading filelist \"%s\"...", filelist.c_str()); 
-					PrintStart(); 
-					
-					tinyxml2::XMLDocument xml; 
-					xml.LoadFile(filelist.c_str()); 
-					if (xml.Error()) {
-						Print("Couldn't open XML filelist \"%s\".", filelist.c_str()); 
-						PrintAbort(); 
-						continue; 
-					}
-					
-					tinyxml2::XMLElement* xmlfilelist = xml.FirstChildElement("filelist"); 
-					if (xmlfilelist == nullptr) {
-						Print("Missing filelist element."); 
-						PrintAbort(); 
-						continue; 
-					}
-					
-					PrintDone(); 
-					
-					tinyxml2::XMLElement* xmlfile; 
-					for (xmlfile = xmlfilelist->FirstChildElement("file") ; xmlfile != nullptr ; xmlfile = xmlfile->NextSiblingElement("file")) {
-						WPDFile file; 
-						
-						const char* fileName = xmlfile->Attribute("name"); 
-						if (fileName == nullptr) {
-							Print("Missing file \"%s\" attribute.", "name"); 
-							continue; 
-						} else if (!file.load(strfmt("sys/%s", fileName))) {
-							continue; 
-						}
-						
-						std::string format = "default"; 
-						const char* fileFormat = xmlfile->Attribute("format"); 
-						if (fileFormat != nullptr) {
-							format = fileFormat; 
-						}
-						
-						tinyxml2::XMLElement* xmlpatch;
-						for (xmlpatch = xmlfile->FirstChildElement("patch") ; xmlpatch != nullptr ; xmlpatch = xmlpatch->NextSiblingElement("patch")) {
-							std::string filter = "*"; 
-							const char* patchFilter = xmlpatch->Attribute("filter"); 
-							if (patchFilter != nullptr) {
-								filter = patchFilter; 
-							}
-							
-							const char* patchName = xmlpatch->Attribute("name"); 
-							if (patchName == nullptr) {
-								Print("Missing patch \"%s\" attribute.", "name"); 
-								continue; 
-							} else if (format == "default") {
-								file.convert(strfmt("patch/%s", patchName), filter, showAll); 
-							} else {
-								file.convert(strfmt("patch/%s", patchName), format, filter, showAll); 
-							}
-						}
-						
-						std::ofstream out(strfmt("sys/%s", fileName), std::ofstream::in | std::ofstream::out | std::ofstream::binary); 
-						if (out.is_open()) {
-							out.seekp(0, std::ofstream::beg); 
-							out.write("WPD", 3); 
-						}
-					}
-				}
+			Manifest manifest; 
+			manifest.load(ManifestGenerate); 
+			std::vector<FileTarget> targets = ReadTargets(filelists, false); 
+			PreloadFormats(targets, threads); 
+			
+			Archive archive; 
+			if ((fromArchive == true) && ((!archive.open(ArchiveList, ArchiveImage)) || (!archive.mapImage()))) {
+				goto ExitFailure; 
+			}
+			
+			RunTargets(targets, pool.get(), maxMemory, (fromArchive == true)? &archive : nullptr, [&manifest, &archive, fromArchive, showAll, maxMemory](const FileTarget& target) {
+				return GenerateTarget(target, manifest, (fromArchive == true)? &archive : nullptr, showAll, maxMemory); 
+			}); 
+			
+			if (manifest.getModified()) {
+				manifest.save(ManifestGenerate); 
 			}
 			
 			goto ExitSuccess; 
 		} else if (command == "-P") {
 			std::list<std::string> files; 
+			Manifest manifest; 
+			manifest.load(ManifestPatch); 
+			std::vector<FileTarget> targets = ReadTargets(filelists, true); 
+			PreloadFormats(targets, threads); 
+			if (watch == true) {
+				WatchTargets(targets, manifest, importc); 
+			}
 			
-			for (int i = 2 ; i < argc ; i++) {
-				std::string filelist = argv[i]; 
-				if (filelist[0] != '-') {
-					if (filelist == "") {
-						Print("Missing filelist argument."); 
-						continue; 
-					}
-					
-					Print("Reading filelist \"%s\"...", filelist.c_str()); 
-					PrintStart(); 
-					
-					tinyxml2::XMLDocument xml; 
-					xml.LoadFile(filelist.c_str()); 
-					if (xml.Error()) {
-						Print("Couldn't open XML filelist \"%s\".", filelist.c_str()); 
-						PrintAbort(); 
-						continue; 
-					}
-					
-					tinyxml2::XMLElement* xmlfilelist = xml.FirstChildElement("filelist"); 
-					if (xmlfilelist == nullptr) {
-						Print("Missing filelist element."); 
-						PrintAbort(); 
-						continue; 
-					}
-					
-					PrintDone(); 
-					
-					tinyxml2::XMLElement* xmlfile; 
-					for (xmlfile = xmlfilelist->FirstChildElement("file") ; xmlfile != nullptr ; xmlfile = xmlfile->NextSiblingElement("file")) {
-						WPDFile file; 
-						
-						const char* fileName = xmlfile->Attribute("name"); 
-						if (fileName == nullptr) {
-							Print("Missing file \"%s\" attribute.", "name"); 
-							continue; 
-						} else if (!file.load(strfmt("sys/%s", fileName))) {
-							continue; 
-						}
-						
-						const char* fileFormat = xmlfile->Attribute("format"); 
-						if (fileFormat == nullptr) {
-							Print("Missing file \"%s\" attribute.", "format"); 
-							continue; 
-						}
-						
-						tinyxml2::XMLElement* xmlpatch;
-						for (xmlpatch = xmlfile->FirstChildElement("patch") ; xmlpatch != nullptr ; xmlpatch = xmlpatch->NextSiblingElement("patch")) {
-							const char* patchName = xmlpatch->Attribute("name"); 
-							if (patchName == nullptr) {
-								Print("Missing patch \"%s\" attribute.", "name"); 
-								continue; 
-							} else {
-								file.patch(strfmt("patch/%s", patchName), fileFormat); 
-							}
-						}
-						
-						if (file.getModified()) {
-							file.save(strfmt("sys/%s", fileName)); 
-							files.push_back(fileName); 
-						}
-					}
+			// Jobs succeed when they built their file again, which then has to be imported
+			std::vector<bool> built = RunTargets(targets, pool.get(), maxMemory, nullptr, [&manifest](const FileTarget& target) {
+				return BuildTarget(target, manifest); 
+			}); 
+			for (std::size_t i = 0 ; i < targets.size() ; i++) {
+				if (built[i]) {
+					files.push_back(targets[i].name); 
 				}
 			}
 			
-			if (importc == true) {
-				for (auto it = files.begin() ; it != files.end() ; it++) {
-					Print("Importing file \"%s\"...", it->c_str()); 
-					PrintStart(); 
-					std::string processName = "sys\\ff13tool.exe"; 
-					std::string processLine = strfmt("%s -i -ff13 filelistc.win32.bin white_imgc.win32.bin %s", processName.c_str(), it->c_str()); 
-					STARTUPINFO startupInfo = { sizeof(STARTUPINFO), NULL, NULL, NULL, 0, 0, 0, 0, 0, 0, 0, 0, 0,0, NULL, NULL, NULL, NULL }; 
-					PROCESS_INFORMATION processInfo; 
-					if (CreateProcess(NULL, const_cast<char*>(processLine.c_str()), nullptr, nullptr, 0, 0, NULL, ".\\sys", &startupInfo, &processInfo)) {
-						WaitForSingleObject(processInfo.hProcess, INFINITE); 
-						CloseHandle(processInfo.hProcess); 
-						CloseHandle(processInfo.hThread); 
-						PrintDone(); 
-					} else {
-						Print("Couldn't create process \"%s\" (error %d).", processName.c_str(), GetLastError()); 
-						PrintAbort(); 
-					}
+			if (manifest.getModified()) {
+				manifest.save(ManifestPatch); 
+			}
+			
+			if ((importc == true) && (!files.empty())) {
+				Archive archive; 
+				if (archive.open(ArchiveList, ArchiveImage)) {
+					archive.import(files, "sys"); 
 				}
 			}
 			
+			goto ExitSuccess; 
+		// -D = Diff two files into a patch file
+		} else if (command == "-D") {
+			std::vector<std::string> args(filelists.begin(), filelists.end()); 
+			if ((args.size() < 3) || (args.size() > 4)) {
+				PrintError("-D takes the original file, the modified file, the patch file and optionally a format."); 
+				goto ShowHelp; 
+			}
+			
+			WPDFile original, modified; 
+			if ((!original.load(args[0])) || (!modified.load(args[1]))) {
+				goto ExitFailure; 
+			}
+			bool done = (args.size() == 4)? modified.diff(original, args[2], args[3]) : modified.diff(original, args[2]); 
+			if (done == false) {
+				goto ExitFailure; 
+			}
+			
+			goto ExitSuccess; 
+		// -Q = Query a file
+		} else if (command == "-Q") {
+			std::vector<std::string> args(filelists.begin(), filelists.end()); 
+			if ((args.size() < 3) || (args.size() > 4)) {
+				PrintError("-Q takes the file, its format, the query and optionally a CSV file to export to."); 
+				goto ShowHelp; 
+			}
+			
+			Format* fmt = Format::GetFormat(args[1]); 
+			if (fmt == nullptr) {
+				PrintError("Couldn't load format %s.", args[1].c_str()); 
+				goto ExitFailure; 
+			}
+			Query query; 
+			WPDFile file; 
+			if ((!query.parse(args[2], fmt)) || (!file.load(args[0])) || (!query.run(file))) {
+				goto ExitFailure; 
+			}
+			if (args.size() == 4) {
+				if (!query.save(args[3])) {
+					goto ExitFailure; 
+				}
+			} else {
+				query.print(); 
+			}
+			
+			goto ExitSuccess; 
+		// -F = Write a format for a file without one
+		} else if (command == "-F") {
+			std::vector<std::string> args(filelists.begin(), filelists.end()); 
+			if (args.size() != 2) {
+				PrintError("-F takes the file and the name of the format to write."); 
+				goto ShowHelp; 
+			}
+			
+			// Formats are written once and then edited by hand, an existing one is left alone
+			std::string formatPath = strfmt("xml/fmt/%s", args[1].c_str()); 
+			FileStatus status; 
+			if (GetFileStatus(formatPath, status)) {
+				PrintError("Format file \"%s\" already exists.", formatPath.c_str()); 
+				goto ExitFailure; 
+			}
+			WPDFile file; 
+			if ((!file.load(args[0])) || (!file.saveFormat(formatPath))) {
+				goto ExitFailure; 
+			}
+			
 			goto ExitSuccess; 
 		// Unknown command
 		} else {
-			Print("Unknown command (\"%s\").", command.c_str()); 
+			PrintError("Unknown command (\"%s\").", command.c_str()); 
 			goto ShowHelp; 
 		}
 	}
@@ -234,15 +775,47 @@ ShowHelp:
 	Print("\tGenerate all files indicated in the filelist."); 
 	Print("-P filelist"); 
 	Print("\tPatch all files indicated in the filelist."); 
+	Print("\tPatch files ending in .csv are tables: attribute names in the header row with an @id column, then a row per entry."); 
+	Print("-D original modified patch [format]"); 
+	Print("\tWrite a patch file with only what changed between two WPD files (raw words without a format)."); 
+	Print("-Q file format query [output.csv]"); 
+	Print("\tPrint or export the entries matching a query, for example:"); 
+	Print("\tselect @id, name, price where price > 500 and kind = Weapon order by price desc limit 10"); 
+	Print("-F file format"); 
+	Print("\tWrite xml/fmt/format with an attribute for every word of the file's entries, typed from its !!strtypelist."); 
 	Print(); 
 	Print("Options:");
 	Print("-v"); 
 	Print("\tVerbose mode (show more information)."); 
+	Print("-q"); 
+	Print("\tQuiet mode (only show errors)."); 
 	Print("-s"); 
 	Print("\tShow hidden values."); 
+	Print("-c"); 
+	Print("\tImport modified files to the game archive."); 
+	Print("-a"); 
+	Print("\tRead files from the game archive instead of the sys folder (-G)."); 
+	Print("--watch"); 
+	Print("\tKeep the files in memory and patch them again whenever their patch files change (-P)."); 
+	Print("-j threads"); 
+	Print("\tProcess files on that many threads (0 for one per core)."); 
+	Print("--max-memory=size"); 
+	Print("\tOnly start on a file once it fits in that much memory next to the files being worked on (K, M or G suffix)."); 
+	Print("\tFiles too big for it are converted an entry at a time (-G)."); 
+	Print("--profile"); 
+	Print("\tPrint how long each step took, and how much was read and written."); 
+	Print("--trace=file.json"); 
+	Print("\tWrite a trace of every step for chrome://tracing or Perfetto."); 
+	Print("--mem-stats"); 
+	Print("\tPrint the memory taken by chunks, the string pool, formats, patch parsing and patch file output, in total and for each file."); 
 	Print(); 
 ExitSuccess:
+	SchemaCache::Save(); 
+	Profile::Report(); 
+	MemoryStats::Report(); 
 	return EXIT_SUCCESS; 
 ExitFailure:
+	Profile::Report(); 
+	MemoryStats::Report(); 
 	return EXIT_FAILURE; 
 }
@@ -0,0 +1,185 @@
+
+#include <cstdio>
+#include <fstream>
+
+#include "include/Manifest.hpp"
+
+using namespace dbtool; 
+
+Manifest::Manifest ()
+	:m_fileList(), m_outputList(), m_memoryList(), m_modified(false), m_mutex() {} 
+Manifest::~Manifest () {} 
+
+bool Manifest::load (const std::string& filename) {
+	std::lock_guard<std::mutex> lock(this->m_mutex); 
+	this->m_fileList.clear(); 
+	this->m_outputList.clear(); 
+	this->m_modified = false; 
+	
+	std::ifstream in(filename, std::ifstream::in); 
+	if (!in.is_open()) {
+		return false; 
+	}
+	
+	// F <hash> <size> <time> <file>
+	// O <key> <hash> <output>
+	// I <input> (inputs of the previous output)
+	Output* output = nullptr; 
+	std::string line; 
+	while (std::getline(in, line)) {
+		if (line.size() < 2) {
+			continue; 
+		}
+		
+		char path[1024]; 
+		if (line[0] == 'F') {
+			File file; 
+			if (sscanf(line.c_str(), "F %llx %llu %llu %1023[^\n]", &file.hash, &file.status.size, &file.status.time, path) == 4) {
+				this->m_fileList[path] = file; 
+			}
+			output = nullptr; 
+		} else if (line[0] == 'O') {
+			Output entry; 
+			if (sscanf(line.c_str(), "O %llx %llx %1023[^\n]", &entry.key, &entry.hash, path) == 3) {
+				output = &(this->m_outputList[path] = entry); 
+			} else {
+				output = nullptr; 
+			}
+		} else if ((line[0] == 'I') && (output != nullptr)) {
+			output->inputs.push_back(line.substr(2)); 
+		}
+	}
+	
+	return true; 
+}
+
+bool Manifest::save (const std::string& filename) const {
+	std::string content; 
+	std::unique_lock<std::mutex> lock(this->m_mutex); 
+	for (auto it = this->m_fileList.begin() ; it != this->m_fileList.end() ; it++) {
+		content += strfmt("F %016llx %llu %llu %s\n", it->second.hash, it->second.status.size, it->second.status.time, it->first.c_str()); 
+	}
+	for (auto it = this->m_outputList.begin() ; it != this->m_outputList.end() ; it++) {
+		content += strfmt("O %016llx %016llx %s\n", it->second.key, it->second.hash, it->first.c_str()); 
+		for (auto input = it->second.inputs.begin() ; input != it->second.inputs.end() ; input++) {
+			content += strfmt("I %s\n", input->c_str()); 
+		}
+	}
+	lock.unlock(); 
+	
+	bool written; 
+	if (!UpdateFile(filename, content, written)) {
+		PrintError("Couldn't write manifest \"%s\".", filename.c_str()); 
+		return false; 
+	}
+	return true; 
+}
+
+bool Manifest::getFileHash (const std::string& filename, unsigned long long& hash) {
+	{
+		std::lock_guard<std::mutex> lock(this->m_mutex); 
+		std::map<std::string, unsigned long long>::const_iterator it = this->m_memoryList.find(filename); 
+		if (it != this->m_memoryList.end()) {
+			hash = it->second; 
+			return true; 
+		}
+	}
+	
+	FileStatus status; 
+	if (!GetFileStatus(filename, status)) {
+		return false; 
+	}
+	
+	// Only hash the content again if the file was touched since last time
+	{
+		std::lock_guard<std::mutex> lock(this->m_mutex); 
+		ManifestFileList::iterator it = this->m_fileList.find(filename); 
+		if ((it != this->m_fileList.end()) && (it->second.status.size == status.size) && (it->second.status.time == status.time)) {
+			hash = it->second.hash; 
+			return true; 
+		}
+	}
+	
+	if (!HashFile(filename, hash)) {
+		return false; 
+	}
+	std::lock_guard<std::mutex> lock(this->m_mutex); 
+	File& file = this->m_fileList[filename]; 
+	file.status = status; 
+	file.hash = hash; 
+	this->m_modified = true; 
+	return true; 
+}
+
+void Manifest::setMemoryHash (const std::string& filename, unsigned long long hash) {
+	// Files that only exist in memory, like archive entries, are hashed by whoever read them
+	std::lock_guard<std::mutex> lock(this->m_mutex); 
+	this->m_memoryList[filename] = hash; 
+}
+
+unsigned long long Manifest::getKey (const std::list<std::string>& inputs, const std::string& options) {
+	unsigned long long key = HashString(options); 
+	for (auto it = inputs.begin() ; it != inputs.end() ; it++) {
+		unsigned long long hash; 
+		if (!this->getFileHash(*it, hash)) {
+			return 0; 
+		}
+		key = HashString(*it, key); 
+		key = HashData(&hash, sizeof(hash), key); 
+	}
+	return key; 
+}
+
+bool Manifest::isUpToDate (const std::string& output, const std::string& options) {
+	Output entry; 
+	{
+		std::lock_guard<std::mutex> lock(this->m_mutex); 
+		ManifestOutputList::iterator it = this->m_outputList.find(output); 
+		if (it == this->m_outputList.end()) {
+			return false; 
+		}
+		entry = it->second; 
+	}
+	
+	// The output must still be the one we wrote, and none of its inputs may have changed
+	unsigned long long hash; 
+	if ((!this->getFileHash(output, hash)) || (hash != entry.hash)) {
+		return false; 
+	}
+	unsigned long long key = this->getKey(entry.inputs, options); 
+	return (key != 0) && (key == entry.key); 
+}
+
+void Manifest::setOutput (const std::string& output, const std::list<std::string>& inputs, const std::string& options) {
+	Output entry; 
+	entry.inputs = inputs; 
+	entry.key = this->getKey(inputs, options); 
+	{
+		std::lock_guard<std::mutex> lock(this->m_mutex); 
+		this->m_fileList.erase(output); 
+	}
+	bool hashed = this->getFileHash(output, entry.hash); 
+	
+	std::lock_guard<std::mutex> lock(this->m_mutex); 
+	if (hashed) {
+		this->m_outputList[output] = entry; 
+	} else {
+		this->m_outputList.erase(output); 
+	}
+	this->m_modified = true; 
+}
+
+bool Manifest::getOutputHash (const std::string& output, unsigned long long& hash) const {
+	std::lock_guard<std::mutex> lock(this->m_mutex); 
+	ManifestOutputList::const_iterator it = this->m_outputList.find(output); 
+	if (it == this->m_outputList.end()) {
+		return false; 
+	}
+	hash = it->second.hash; 
+	return true; 
+}
+
+bool Manifest::getModified () const {
+	std::lock_guard<std::mutex> lock(this->m_mutex); 
+	return this->m_modified; 
+}
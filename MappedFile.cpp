@@ -0,0 +1,116 @@
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "include/MappedFile.hpp"
+
+using namespace dbtool; 
+
+MappedFile::MappedFile ()
+	:m_data(nullptr), m_size(0), m_file(nullptr), m_mapping(nullptr) {} 
+MappedFile::~MappedFile () {
+	this->close(); 
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open (const std::string& filename) {
+	this->close(); 
+	
+	HANDLE file = CreateFile(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr); 
+	if (file == INVALID_HANDLE_VALUE) {
+		return false; 
+	}
+	
+	LARGE_INTEGER size; 
+	if ((GetFileSizeEx(file, &size) == 0) || (size.QuadPart == 0)) {
+		CloseHandle(file); 
+		return false; 
+	}
+	
+	HANDLE mapping = CreateFileMapping(file, nullptr, PAGE_READONLY, 0, 0, nullptr); 
+	if (mapping == nullptr) {
+		CloseHandle(file); 
+		return false; 
+	}
+	
+	const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0); 
+	if (data == nullptr) {
+		CloseHandle(mapping); 
+		CloseHandle(file); 
+		return false; 
+	}
+	
+	this->m_data = static_cast<const char*>(data); 
+	this->m_size = static_cast<std::size_t>(size.QuadPart); 
+	this->m_file = file; 
+	this->m_mapping = mapping; 
+	return true; 
+}
+
+void MappedFile::close () {
+	if (this->m_data != nullptr) {
+		UnmapViewOfFile(this->m_data); 
+		CloseHandle(static_cast<HANDLE>(this->m_mapping)); 
+		CloseHandle(static_cast<HANDLE>(this->m_file)); 
+		this->m_data = nullptr; 
+		this->m_size = 0; 
+		this->m_file = nullptr; 
+		this->m_mapping = nullptr; 
+	}
+}
+
+#else
+
+bool MappedFile::open (const std::string& filename) {
+	this->close(); 
+	
+	int fd = ::open(filename.c_str(), O_RDONLY); 
+	if (fd < 0) {
+		return false; 
+	}
+	
+	struct stat st; 
+	if ((fstat(fd, &st) != 0) || (st.st_size == 0)) {
+		::close(fd); 
+		return false; 
+	}
+	
+	void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0); 
+	::close(fd); 
+	if (data == MAP_FAILED) {
+		return false; 
+	}
+	
+	this->m_data = static_cast<const char*>(data); 
+	this->m_size = static_cast<std::size_t>(st.st_size); 
+	return true; 
+}
+
+void MappedFile::close () {
+	if (this->m_data != nullptr) {
+		munmap(const_cast<char*>(this->m_data), this->m_size); 
+		this->m_data = nullptr; 
+		this->m_size = 0; 
+	}
+}
+
+#endif
+
+bool MappedFile::isOpen () const {
+	return (this->m_data != nullptr); 
+}
+
+const char* MappedFile::data () const {
+	return this->m_data; 
+}
+
+std::size_t MappedFile::size () const {
+	return this->m_size; 
+}
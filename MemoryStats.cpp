@@ -0,0 +1,163 @@
+
+#include <algorithm>
+
+#include "include/MemoryStats.hpp"
+#include "include/Tools.hpp"
+
+using namespace dbtool; 
+
+std::atomic<bool> MemoryStats::s_enabled(false); 
+
+namespace {
+	
+	const unsigned TagCount = 5; 
+	const char* const TagNames[TagCount] = { "Chunks", "Strings", "Schemas", "Patch parsing", "Convert output" }; 
+	
+	struct Counter {
+		std::atomic<long long>				current; 
+		std::atomic<long long>				peak; 
+		std::atomic<unsigned long long>		allocations; 
+	}; 
+	
+	Counter Counters[TagCount]; 
+	
+	void Add(MemoryUsage& usage, long long size, unsigned allocations) {
+		usage.current += size; 
+		usage.peak = std::max(usage.peak, usage.current); 
+		usage.allocations += allocations; 
+	}
+	
+	void Restart(MemoryUsage& usage) {
+		usage.peak = usage.current; 
+		usage.allocations = 0; 
+	}
+	
+	void PrintUsage(const char* name, const MemoryUsage& usage) {
+		Print("%-24s %14.1f %14.1f %14llu", name, usage.current / 1024.0, usage.peak / 1024.0, usage.allocations); 
+	}
+	
+}
+
+// Only the thread working on the file writes to it, the report reads it once the jobs are done.
+// Records outlive their jobs, a file's jobs may run on different threads one after another.
+struct MemoryStats::FileRecord {
+	MemoryUsage		tags[TagCount]; 
+	MemoryUsage		total; 
+}; 
+
+std::map<std::string, std::unique_ptr<MemoryStats::FileRecord>> MemoryStats::s_files; 
+std::mutex MemoryStats::s_mutex; 
+thread_local MemoryStats::FileRecord* MemoryStats::s_currentFile = nullptr; 
+
+MemoryStats::FileScope::FileScope (const std::string& filename)
+	:m_previous(MemoryStats::s_currentFile) {
+		if ((MemoryStats::IsEnabled()) && (filename != "")) {
+			std::lock_guard<std::mutex> lock(MemoryStats::s_mutex); 
+			std::unique_ptr<FileRecord>& record = MemoryStats::s_files[filename]; 
+			if (!record) {
+				record.reset(new FileRecord()); 
+			}
+			MemoryStats::s_currentFile = record.get(); 
+		}
+	}
+MemoryStats::FileScope::~FileScope () {
+	MemoryStats::s_currentFile = this->m_previous; 
+}
+
+MemoryStats::Block::Block (MemoryTag tag, std::size_t size)
+	:m_tag(tag), m_size(size) {
+		MemoryStats::Allocate(tag, size); 
+	}
+MemoryStats::Block::~Block () {
+	MemoryStats::Release(this->m_tag, this->m_size); 
+}
+
+void MemoryStats::Record(MemoryTag tag, long long size, unsigned allocations) {
+	unsigned index = static_cast<unsigned>(tag); 
+	Counter& counter = Counters[index]; 
+	long long current = counter.current.fetch_add(size, std::memory_order_relaxed) + size; 
+	long long peak = counter.peak.load(std::memory_order_relaxed); 
+	while ((current > peak) && (!counter.peak.compare_exchange_weak(peak, current, std::memory_order_relaxed))) {} 
+	if (allocations > 0) {
+		counter.allocations.fetch_add(allocations, std::memory_order_relaxed); 
+	}
+	
+	FileRecord* file = MemoryStats::s_currentFile; 
+	if (file != nullptr) {
+		Add(file->tags[index], size, allocations); 
+		Add(file->total, size, allocations); 
+	}
+}
+
+// Has to come before anything is allocated, or what is released later would be missing from the totals
+void MemoryStats::Enable() {
+	MemoryStats::s_enabled = true; 
+}
+
+void MemoryStats::Retag(MemoryTag from, MemoryTag to, std::size_t size) {
+	if ((MemoryStats::IsEnabled()) && (from != to)) {
+		MemoryStats::Record(from, -static_cast<long long>(size), 0); 
+		MemoryStats::Record(to, size, 0); 
+	}
+}
+
+std::size_t MemoryStats::GetHeapSize(const std::string& str) {
+	static const std::size_t inplace = std::string().capacity(); 
+	return (str.capacity() > inplace)? str.capacity() + 1 : 0; 
+}
+
+MemoryUsage MemoryStats::GetUsage(MemoryTag tag) {
+	const Counter& counter = Counters[static_cast<unsigned>(tag)]; 
+	MemoryUsage usage; 
+	usage.current = counter.current.load(std::memory_order_relaxed); 
+	usage.peak = counter.peak.load(std::memory_order_relaxed); 
+	usage.allocations = counter.allocations.load(std::memory_order_relaxed); 
+	return usage; 
+}
+
+// What is held stays counted, only the peaks and the allocation counts start over
+void MemoryStats::Reset() {
+	for (unsigned i = 0 ; i < TagCount ; i++) {
+		Counters[i].peak = Counters[i].current.load(); 
+		Counters[i].allocations = 0; 
+	}
+	std::lock_guard<std::mutex> lock(MemoryStats::s_mutex); 
+	for (auto it = MemoryStats::s_files.begin() ; it != MemoryStats::s_files.end() ; it++) {
+		for (unsigned i = 0 ; i < TagCount ; i++) {
+			Restart(it->second->tags[i]); 
+		}
+		Restart(it->second->total); 
+	}
+}
+
+void MemoryStats::Report() {
+	if (!MemoryStats::IsEnabled()) {
+		return; 
+	}
+	
+	Print("Memory:"); 
+	PrintStart(); 
+	Print("%-24s %14s %14s %14s", "Tag", "Current (KB)", "Peak (KB)", "Allocations"); 
+	for (unsigned i = 0 ; i < TagCount ; i++) {
+		PrintUsage(TagNames[i], MemoryStats::GetUsage(static_cast<MemoryTag>(i))); 
+	}
+	
+	std::unique_lock<std::mutex> lock(MemoryStats::s_mutex); 
+	for (auto it = MemoryStats::s_files.begin() ; it != MemoryStats::s_files.end() ; it++) {
+		const FileRecord& file = *it->second; 
+		if ((file.total.allocations == 0) && (file.total.peak == file.total.current)) {
+			continue; 
+		}
+		Print("%s: %.1f KB at most, %llu allocations", it->first.c_str(), file.total.peak / 1024.0, file.total.allocations); 
+		PrintStart(); 
+		for (unsigned i = 0 ; i < TagCount ; i++) {
+			if ((file.tags[i].allocations > 0) || (file.tags[i].peak != 0)) {
+				PrintUsage(TagNames[i], file.tags[i]); 
+			}
+		}
+		PrintDone(); 
+	}
+	lock.unlock(); 
+	PrintDone(); 
+	MemoryStats::Reset(); 
+}
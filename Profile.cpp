@@ -0,0 +1,220 @@
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "include/Profile.hpp"
+#include "include/Tools.hpp"
+
+using namespace dbtool; 
+
+std::atomic<bool> Profile::s_enabled(false); 
+bool Profile::s_summary = false; 
+std::string Profile::s_traceFilename; 
+std::chrono::steady_clock::time_point Profile::s_origin; 
+
+namespace {
+	
+	const unsigned CounterCount = 5; 
+	const char* const CounterNames[CounterCount] = { "Bytes read", "Bytes written", "Entries touched", "Attributes changed", "Strings appended" }; 
+	const char* const CounterKeys[CounterCount] = { "bytesRead", "bytesWritten", "entriesTouched", "attributesChanged", "stringsAppended" }; 
+	
+	struct Span {
+		const char*		name; 
+		std::string		detail; 
+		long long		start; 
+		long long		end; 
+		unsigned		depth; 
+	}; 
+	
+	// Only its own thread adds to it, the report takes what was added so far. Both hold the record's lock, 
+	// with --watch the report is made while log and worker threads are still recording. 
+	struct ThreadRecord {
+		unsigned					id; 
+		unsigned					depth; 
+		std::mutex					mutex; 
+		std::vector<Span>			spans; 
+		unsigned long long			counters[CounterCount]; 
+	}; 
+	
+	// Records outlive their threads, ParallelFor workers are gone by the time the report is made
+	std::mutex ThreadMutex; 
+	std::vector<std::unique_ptr<ThreadRecord>> Threads; 
+	thread_local ThreadRecord* CurrentThread = nullptr; 
+	
+	ThreadRecord& GetThreadRecord() {
+		if (CurrentThread == nullptr) {
+			std::lock_guard<std::mutex> lock(ThreadMutex); 
+			Threads.emplace_back(new ThreadRecord()); 
+			CurrentThread = Threads.back().get(); 
+			CurrentThread->id = Threads.size() - 1; 
+			CurrentThread->depth = 0; 
+			std::fill(CurrentThread->counters, CurrentThread->counters + CounterCount, 0); 
+		}
+		return *CurrentThread; 
+	}
+	
+	void WriteJsonString(std::string& out, const std::string& str) {
+		out += '"'; 
+		for (auto it = str.begin() ; it != str.end() ; it++) {
+			if ((*it == '"') || (*it == '\\')) {
+				out += '\\'; 
+				out += *it; 
+			} else if (static_cast<unsigned char>(*it) < 0x20) {
+				out += strfmt("\\u%04x", static_cast<unsigned char>(*it)); 
+			} else {
+				out += *it; 
+			}
+		}
+		out += '"'; 
+	}
+	
+}
+
+Profile::Scope::Scope (const char* name)
+	:m_name(name), m_detail(), m_start(Profile::IsEnabled()? Profile::Begin() : -1) {} 
+Profile::Scope::Scope (const char* name, const std::string& detail)
+	:m_name(name), m_detail(), m_start(-1) {
+		if (Profile::IsEnabled()) {
+			this->m_detail = detail; 
+			this->m_start = Profile::Begin(); 
+		}
+	}
+Profile::Scope::~Scope () {
+	if (this->m_start >= 0) {
+		Profile::End(this->m_name, std::move(this->m_detail), this->m_start); 
+	}
+}
+
+long long Profile::Begin() {
+	GetThreadRecord().depth++; 
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Profile::s_origin).count(); 
+}
+
+void Profile::End(const char* name, std::string&& detail, long long start) {
+	ThreadRecord& thread = GetThreadRecord(); 
+	Span span; 
+	span.name = name; 
+	span.detail = std::move(detail); 
+	span.start = start; 
+	span.end = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Profile::s_origin).count(); 
+	span.depth = --thread.depth; 
+	std::lock_guard<std::mutex> lock(thread.mutex); 
+	thread.spans.push_back(std::move(span)); 
+}
+
+void Profile::Enable(bool summary, const std::string& traceFilename) {
+	Profile::s_summary = summary; 
+	Profile::s_traceFilename = traceFilename; 
+	Profile::s_origin = std::chrono::steady_clock::now(); 
+	Profile::s_enabled = summary || (traceFilename != ""); 
+}
+
+void Profile::Count(ProfileCounter counter, unsigned long long value) {
+	if (Profile::IsEnabled()) {
+		ThreadRecord& thread = GetThreadRecord(); 
+		std::lock_guard<std::mutex> lock(thread.mutex); 
+		thread.counters[static_cast<unsigned>(counter)] += value; 
+	}
+}
+
+void Profile::Report() {
+	if (!Profile::IsEnabled()) {
+		return; 
+	}
+	
+	struct Total {
+		unsigned			calls; 
+		long long			total; 
+		long long			max; 
+	}; 
+	std::vector<std::string> names; 
+	std::map<std::string, Total> totals; 
+	unsigned long long counters[CounterCount] = {}; 
+	std::vector<std::string> busy; 
+	std::string trace = "{\"traceEvents\":[\n"; 
+	long long last = 0; 
+	
+	// Records are never freed, their list is only locked while it is copied. 
+	// Each record is only locked while its spans and counters are taken, writing the trace counts bytes too. 
+	std::vector<ThreadRecord*> records; 
+	{
+		std::lock_guard<std::mutex> lock(ThreadMutex); 
+		for (auto thread = Threads.begin() ; thread != Threads.end() ; thread++) {
+			records.push_back(thread->get()); 
+		}
+	}
+	for (auto thread = records.begin() ; thread != records.end() ; thread++) {
+		std::vector<Span> spans; 
+		unsigned long long threadCounters[CounterCount]; 
+		{
+			std::lock_guard<std::mutex> lock((*thread)->mutex); 
+			spans.swap((*thread)->spans); 
+			std::copy((*thread)->counters, (*thread)->counters + CounterCount, threadCounters); 
+			std::fill((*thread)->counters, (*thread)->counters + CounterCount, 0); 
+		}
+		
+		long long outer = 0; 
+		unsigned count = 0; 
+		trace += strfmt("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"Thread %u\"}},\n", (*thread)->id, (*thread)->id); 
+		for (auto span = spans.begin() ; span != spans.end() ; span++) {
+			auto it = totals.find(span->name); 
+			if (it == totals.end()) {
+				names.push_back(span->name); 
+				it = totals.emplace(span->name, Total{0, 0, 0}).first; 
+			}
+			long long duration = span->end - span->start; 
+			it->second.calls++; 
+			it->second.total += duration; 
+			it->second.max = std::max(it->second.max, duration); 
+			last = std::max(last, span->end); 
+			if (span->depth == 0) {
+				outer += duration; 
+				count++; 
+			}
+			
+			trace += strfmt("{\"name\":\"%s\",\"cat\":\"dbtool\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f", span->name, (*thread)->id, span->start / 1000.0, duration / 1000.0); 
+			if (span->detail != "") {
+				trace += ",\"args\":{\"file\":"; 
+				WriteJsonString(trace, span->detail); 
+				trace += "}"; 
+			}
+			trace += "},\n"; 
+		}
+		for (unsigned i = 0 ; i < CounterCount ; i++) {
+			counters[i] += threadCounters[i]; 
+		}
+		if (count > 0) {
+			busy.push_back(strfmt("Thread %u: %.2f ms in %u spans", (*thread)->id, outer / 1e6, count)); 
+		}
+	}
+	trace += strfmt("{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,\"tid\":0,\"ts\":%.3f,\"args\":{", last / 1000.0); 
+	for (unsigned i = 0 ; i < CounterCount ; i++) {
+		trace += strfmt("%s\"%s\":%llu", (i > 0)? "," : "", CounterKeys[i], counters[i]); 
+	}
+	trace += "}}\n]}\n"; 
+	
+	if (Profile::s_summary == true) {
+		Print("Profile:"); 
+		PrintStart(); 
+		Print("%-24s %8s %12s %12s", "Span", "Calls", "Total (ms)", "Max (ms)"); 
+		for (auto name = names.begin() ; name != names.end() ; name++) {
+			const Total& total = totals[*name]; 
+			Print("%-24s %8u %12.2f %12.2f", name->c_str(), total.calls, total.total / 1e6, total.max / 1e6); 
+		}
+		for (auto it = busy.begin() ; it != busy.end() ; it++) {
+			Print("%s", it->c_str()); 
+		}
+		for (unsigned i = 0 ; i < CounterCount ; i++) {
+			Print("%s: %llu", CounterNames[i], counters[i]); 
+		}
+		PrintDone(); 
+	}
+	
+	bool written; 
+	if ((Profile::s_traceFilename != "") && (!UpdateFile(Profile::s_traceFilename, trace, written))) {
+		PrintError("Couldn't write trace file \"%s\".", Profile::s_traceFilename.c_str()); 
+	}
+}
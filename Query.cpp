@@ -0,0 +1,759 @@
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <sstream>
+
+#include "include/FormatView.hpp"
+#include "include/Profile.hpp"
+#include "include/Query.hpp"
+
+using namespace dbtool; 
+
+namespace {
+	
+	enum class TokenType {
+		Word, 
+		Number, 
+		String, 
+		Symbol
+	}; 
+	
+	bool IsKeyword(const std::string& word, const char* keyword) {
+		if (word.size() != strlen(keyword)) {
+			return false; 
+		}
+		for (std::size_t i = 0 ; i < word.size() ; i++) {
+			if (tolower(static_cast<unsigned char>(word[i])) != keyword[i]) {
+				return false; 
+			}
+		}
+		return true; 
+	}
+	
+	// Strings past the end of the table read as empty
+	std::string_view GetStringAt(const Chunk& strings, unsigned offset) {
+		return (offset < strings.size())? strings.getStringView(offset) : std::string_view(); 
+	}
+	
+	void WriteCsvField(std::string& out, const std::string& field) {
+		if (field.find_first_of(",\"\n") == std::string::npos) {
+			out += field; 
+			return; 
+		}
+		out += '"'; 
+		for (auto it = field.begin() ; it != field.end() ; it++) {
+			if (*it == '"') {
+				out += '"'; 
+			}
+			out += *it; 
+		}
+		out += '"'; 
+	}
+	
+}
+
+struct Query::Token {
+	TokenType		type; 
+	std::string		text; 
+}; 
+
+// Entries in name order without the tables, and the columns extracted from them so far
+struct Query::Table {
+	const WPDFile*						file; 
+	std::vector<const std::string*>		names; 
+	std::vector<const Chunk*>			chunks; 
+	const Chunk*						strings; 
+	std::vector<std::vector<unsigned>>	values; 
+	std::vector<std::vector<float>>		floats; 
+}; 
+
+Query::Query ()
+	:m_format(nullptr), m_columns(), m_select(), m_where(), m_orderBy(-1), m_descending(false), m_limit(0), m_rows() {} 
+Query::~Query () {} 
+
+bool Query::getColumn (const std::string& name, unsigned& column) {
+	for (column = 0 ; column < this->m_columns.size() ; column++) {
+		if (this->m_columns[column].name == name) {
+			return true; 
+		}
+	}
+	
+	Column info; 
+	info.name = name; 
+	info.attribute = nullptr; 
+	info.enumInfo = nullptr; 
+	if (name != "@id") {
+		try {
+			info.attribute = &this->m_format->getAttribute(name); 
+		} catch (const std::logic_error& e) {
+			PrintError(e.what()); 
+			return false; 
+		}
+		if (info.attribute->enumName != "") {
+			info.enumInfo = Enum::GetEnum(info.attribute->enumName); 
+		}
+	}
+	this->m_columns.push_back(info); 
+	return true; 
+}
+
+std::unique_ptr<Query::Condition> Query::parseOr (const std::vector<Token>& tokens, std::size_t& position) {
+	std::unique_ptr<Condition> left = this->parseAnd(tokens, position); 
+	while ((left) && (position < tokens.size()) && (tokens[position].type == TokenType::Word) && (IsKeyword(tokens[position].text, "or"))) {
+		position++; 
+		std::unique_ptr<Condition> right = this->parseAnd(tokens, position); 
+		if (!right) {
+			return nullptr; 
+		}
+		std::unique_ptr<Condition> both(new Condition()); 
+		both->op = Operator::Or; 
+		both->left = std::move(left); 
+		both->right = std::move(right); 
+		left = std::move(both); 
+	}
+	return left; 
+}
+
+std::unique_ptr<Query::Condition> Query::parseAnd (const std::vector<Token>& tokens, std::size_t& position) {
+	std::unique_ptr<Condition> left = this->parseCondition(tokens, position); 
+	while ((left) && (position < tokens.size()) && (tokens[position].type == TokenType::Word) && (IsKeyword(tokens[position].text, "and"))) {
+		position++; 
+		std::unique_ptr<Condition> right = this->parseCondition(tokens, position); 
+		if (!right) {
+			return nullptr; 
+		}
+		std::unique_ptr<Condition> both(new Condition()); 
+		both->op = Operator::And; 
+		both->left = std::move(left); 
+		both->right = std::move(right); 
+		left = std::move(both); 
+	}
+	return left; 
+}
+
+std::unique_ptr<Query::Condition> Query::parseCondition (const std::vector<Token>& tokens, std::size_t& position) {
+	if (position >= tokens.size()) {
+		PrintError("Unexpected end of query, expected a condition."); 
+		return nullptr; 
+	}
+	
+	// not condition, (conditions)
+	const Token& first = tokens[position]; 
+	if ((first.type == TokenType::Word) && (IsKeyword(first.text, "not"))) {
+		position++; 
+		std::unique_ptr<Condition> inner = this->parseCondition(tokens, position); 
+		if (!inner) {
+			return nullptr; 
+		}
+		std::unique_ptr<Condition> negated(new Condition()); 
+		negated->op = Operator::Not; 
+		negated->left = std::move(inner); 
+		return negated; 
+	} else if ((first.type == TokenType::Symbol) && (first.text == "(")) {
+		position++; 
+		std::unique_ptr<Condition> inner = this->parseOr(tokens, position); 
+		if (!inner) {
+			return nullptr; 
+		} else if ((position >= tokens.size()) || (tokens[position].text != ")")) {
+			PrintError("Missing closing parenthesis."); 
+			return nullptr; 
+		}
+		position++; 
+		return inner; 
+	}
+	
+	// attribute operator value
+	if ((first.type != TokenType::Word) || (position + 2 >= tokens.size())) {
+		PrintError("Expected a condition instead of \"%s\".", first.text.c_str()); 
+		return nullptr; 
+	}
+	std::unique_ptr<Condition> condition(new Condition()); 
+	if (!this->getColumn(first.text, condition->column)) {
+		return nullptr; 
+	}
+	
+	static const struct {
+		const char*		symbol; 
+		Operator		op; 
+	} operators[] = {
+		{"=", Operator::Equal}, {"==", Operator::Equal}, {"!=", Operator::NotEqual},
+		{"<", Operator::Less}, {"<=", Operator::LessEqual}, {">", Operator::Greater}, {">=", Operator::GreaterEqual},
+		{"~", Operator::Match}
+	}; 
+	const Token& symbol = tokens[position + 1]; 
+	bool found = false; 
+	for (auto it = std::begin(operators) ; it != std::end(operators) ; it++) {
+		if ((symbol.type == TokenType::Symbol) && (symbol.text == it->symbol)) {
+			condition->op = it->op; 
+			found = true; 
+		}
+	}
+	if (found == false) {
+		PrintError("Expected a comparison after \"%s\" instead of \"%s\".", first.text.c_str(), symbol.text.c_str()); 
+		return nullptr; 
+	}
+	
+	// Values are turned into what the column holds once, enumeration names included
+	const Token& value = tokens[position + 2]; 
+	const Column& column = this->m_columns[condition->column]; 
+	position += 3; 
+	if (value.type == TokenType::Symbol) {
+		PrintError("Expected a value after \"%s %s\".", first.text.c_str(), symbol.text.c_str()); 
+		return nullptr; 
+	} else if ((column.attribute == nullptr) || (column.attribute->type == AttributeType::String)) {
+		condition->text = value.text; 
+		if ((column.enumInfo != nullptr) && (value.type == TokenType::Word)) {
+			try {
+				condition->text = std::string(column.enumInfo->getString(value.text)); 
+			} catch (const std::logic_error& e) {} 
+		}
+		return condition; 
+	} else if (condition->op == Operator::Match) {
+		PrintError("Attribute %s isn't a string, ~ only matches strings.", column.name.c_str()); 
+		return nullptr; 
+	}
+	
+	try {
+		unsigned u; 
+		int i; 
+		float f; 
+		if ((value.type == TokenType::Word) && (column.enumInfo == nullptr) && (column.attribute->type != AttributeType::Boolean)) {
+			throw std::logic_error("No enumeration to look the name up in."); 
+		}
+		switch (column.attribute->type) {
+			case AttributeType::Boolean: 
+				if (IsKeyword(value.text, "true")) {
+					condition->value.setUnsigned(1); 
+				} else if (IsKeyword(value.text, "false")) {
+					condition->value.setUnsigned(0); 
+				} else if (ParseUnsigned(value.text, u) == std::errc()) {
+					condition->value.setUnsigned((u != 0)? 1 : 0); 
+				} else {
+					throw std::logic_error("Not a number."); 
+				}
+				break; 
+			case AttributeType::Unsigned: 
+				if (value.type == TokenType::Word) {
+					condition->value.setUnsigned(column.enumInfo->getUnsigned(value.text)); 
+				} else if (ParseUnsigned(value.text, u) == std::errc()) {
+					condition->value.setUnsigned(u); 
+				} else {
+					throw std::logic_error("Not a number."); 
+				}
+				break; 
+			case AttributeType::Signed: 
+				if (value.type == TokenType::Word) {
+					condition->value.setSigned(column.enumInfo->getSigned(value.text)); 
+				} else if (ParseSigned(value.text, i) == std::errc()) {
+					condition->value.setSigned(i); 
+				} else {
+					throw std::logic_error("Not a number."); 
+				}
+				break; 
+			default: 
+				if (value.type == TokenType::Word) {
+					condition->value.setFloat(column.enumInfo->getFloat(value.text)); 
+				} else if (ParseFloat(value.text, f) == std::errc()) {
+					condition->value.setFloat(f); 
+				} else {
+					throw std::logic_error("Not a number."); 
+				}
+		}
+	} catch (const std::logic_error& e) {
+		PrintError("Unexpected value for attribute %s (%s).", column.name.c_str(), value.text.c_str()); 
+		return nullptr; 
+	}
+	return condition; 
+}
+
+bool Query::parse (const std::string& text, const Format* format) {
+	this->m_format = format; 
+	this->m_columns.clear(); 
+	this->m_select.clear(); 
+	this->m_where.reset(); 
+	this->m_orderBy = -1; 
+	this->m_descending = false; 
+	this->m_limit = 0; 
+	
+	// Splitting into words, numbers, strings and symbols
+	std::vector<Token> tokens; 
+	for (std::size_t i = 0 ; i < text.size() ; ) {
+		char c = text[i]; 
+		std::size_t start = i; 
+		if (isspace(static_cast<unsigned char>(c))) {
+			i++; 
+			continue; 
+		} else if (c == '"') {
+			std::size_t end = text.find('"', i + 1); 
+			if (end == std::string::npos) {
+				PrintError("Missing closing quote in query."); 
+				return false; 
+			}
+			tokens.push_back(Token{TokenType::String, text.substr(i + 1, end - i - 1)}); 
+			i = end + 1; 
+		} else if (c == '[') {
+			std::size_t end = text.find(']', i + 1); 
+			if (end == std::string::npos) {
+				PrintError("Missing closing bracket in query."); 
+				return false; 
+			}
+			tokens.push_back(Token{TokenType::Word, text.substr(i, end - i + 1)}); 
+			i = end + 1; 
+		} else if ((isdigit(static_cast<unsigned char>(c))) || ((c == '-') && (i + 1 < text.size()) && (isdigit(static_cast<unsigned char>(text[i + 1]))))) {
+			do {
+				i++; 
+			} while ((i < text.size()) && ((isalnum(static_cast<unsigned char>(text[i]))) || (text[i] == '.'))); 
+			tokens.push_back(Token{TokenType::Number, text.substr(start, i - start)}); 
+		} else if ((isalpha(static_cast<unsigned char>(c))) || (c == '_') || (c == '@')) {
+			do {
+				i++; 
+			} while ((i < text.size()) && ((isalnum(static_cast<unsigned char>(text[i]))) || (text[i] == '_') || (text[i] == '.'))); 
+			tokens.push_back(Token{TokenType::Word, text.substr(start, i - start)}); 
+		} else if ((strchr("<>!=", c) != nullptr) && (i + 1 < text.size()) && (text[i + 1] == '=')) {
+			tokens.push_back(Token{TokenType::Symbol, text.substr(i, 2)}); 
+			i += 2; 
+		} else if (strchr("<>=~(),*", c) != nullptr) {
+			tokens.push_back(Token{TokenType::Symbol, std::string(1, c)}); 
+			i++; 
+		} else {
+			PrintError("Unexpected character in query (\"%c\").", c); 
+			return false; 
+		}
+	}
+	
+	// [select columns] [where conditions] [order by column [asc|desc]] [limit count]
+	std::size_t position = 0; 
+	auto keyword = [&tokens, &position](const char* name) {
+		if ((position < tokens.size()) && (tokens[position].type == TokenType::Word) && (IsKeyword(tokens[position].text, name))) {
+			position++; 
+			return true; 
+		}
+		return false; 
+	}; 
+	if (keyword("select")) {
+		if ((position < tokens.size()) && (tokens[position].text == "*")) {
+			position++; 
+		} else {
+			do {
+				unsigned column; 
+				if ((position >= tokens.size()) || (tokens[position].type != TokenType::Word)) {
+					PrintError("Expected an attribute name after select."); 
+					return false; 
+				} else if (!this->getColumn(tokens[position].text, column)) {
+					return false; 
+				}
+				this->m_select.push_back(column); 
+				position++; 
+			} while ((position < tokens.size()) && (tokens[position].text == ",") && (++position)); 
+		}
+	}
+	if (keyword("where")) {
+		this->m_where = this->parseOr(tokens, position); 
+		if (!this->m_where) {
+			return false; 
+		}
+	}
+	if (keyword("order")) {
+		unsigned column; 
+		if ((!keyword("by")) || (position >= tokens.size()) || (tokens[position].type != TokenType::Word)) {
+			PrintError("Expected an attribute name after order by."); 
+			return false; 
+		} else if (!this->getColumn(tokens[position].text, column)) {
+			return false; 
+		}
+		position++; 
+		this->m_orderBy = column; 
+		if (keyword("desc")) {
+			this->m_descending = true; 
+		} else {
+			keyword("asc"); 
+		}
+	}
+	if (keyword("limit")) {
+		if ((position >= tokens.size()) || (tokens[position].type != TokenType::Number) || (ParseUnsigned(tokens[position].text, this->m_limit) != std::errc())) {
+			PrintError("Expected a count after limit."); 
+			return false; 
+		}
+		position++; 
+	}
+	if (position < tokens.size()) {
+		PrintError("Unexpected \"%s\" in query.", tokens[position].text.c_str()); 
+		return false; 
+	}
+	
+	// Without select, the entry name and every visible attribute
+	if (this->m_select.empty()) {
+		unsigned column; 
+		this->getColumn("@id", column); 
+		this->m_select.push_back(column); 
+		for (auto attribute = format->getAttributes().begin() ; attribute != format->getAttributes().end() ; attribute++) {
+			if ((attribute->hidden == false) && (this->getColumn(attribute->name, column))) {
+				this->m_select.push_back(column); 
+			}
+		}
+	}
+	return true; 
+}
+
+const std::vector<unsigned>& Query::extract (Table& table, unsigned column) const {
+	std::vector<unsigned>& values = table.values[column]; 
+	const Format::Attribute* attribute = this->m_columns[column].attribute; 
+	if ((attribute == nullptr) || (values.size() == table.chunks.size())) {
+		return values; 
+	}
+	
+	// Every type comes down to a shift and a mask, signed values get their sign extended afterwards
+	bool word = (attribute->type == AttributeType::Float) || (attribute->type == AttributeType::String); 
+	unsigned bit = (word == true)? 0 : attribute->bit; 
+	unsigned size = (attribute->type == AttributeType::Boolean)? 1 : (word == true)? 32 : attribute->size; 
+	unsigned mask = (size < 32)? (1U << size) - 1 : 0xFFFFFFFFU; 
+	unsigned sign = ((attribute->type == AttributeType::Signed) && (size < 32))? 1U << (size - 1) : 0; 
+	values.resize(table.chunks.size()); 
+	for (std::size_t i = 0 ; i < table.chunks.size() ; i++) {
+		const Chunk& chunk = *table.chunks[i]; 
+		unsigned u = (attribute->offset + 4 <= chunk.size())? (FormatView::Load(chunk.data(), attribute->offset) >> bit) & mask : 0; 
+		values[i] = (u ^ sign) - sign; 
+	}
+	if (attribute->type == AttributeType::Float) {
+		std::vector<float>& floats = table.floats[column]; 
+		floats.resize(values.size()); 
+		memcpy(floats.data(), values.data(), values.size() * sizeof(float)); 
+	}
+	return values; 
+}
+
+template<typename T>
+void Query::Compare (Operator op, const T* column, T value, std::vector<unsigned char>& selected) {
+	std::size_t count = selected.size(); 
+	unsigned char* result = selected.data(); 
+	switch (op) {
+		case Operator::Equal: 
+			for (std::size_t i = 0 ; i < count ; i++) {
+				result[i] &= (column[i] == value); 
+			}
+			break; 
+		case Operator::NotEqual: 
+			for (std::size_t i = 0 ; i < count ; i++) {
+				result[i] &= (column[i] != value); 
+			}
+			break; 
+		case Operator::Less: 
+			for (std::size_t i = 0 ; i < count ; i++) {
+				result[i] &= (column[i] < value); 
+			}
+			break; 
+		case Operator::LessEqual: 
+			for (std::size_t i = 0 ; i < count ; i++) {
+				result[i] &= (column[i] <= value); 
+			}
+			break; 
+		case Operator::Greater: 
+			for (std::size_t i = 0 ; i < count ; i++) {
+				result[i] &= (column[i] > value); 
+			}
+			break; 
+		case Operator::GreaterEqual: 
+			for (std::size_t i = 0 ; i < count ; i++) {
+				result[i] &= (column[i] >= value); 
+			}
+			break; 
+		default: 
+			break; 
+	}
+}
+
+bool Query::Compare (Operator op, std::string_view text, const std::string& value) {
+	switch (op) {
+		case Operator::Equal: 
+			return (text == value); 
+		case Operator::NotEqual: 
+			return (text != value); 
+		case Operator::Less: 
+			return (text < value); 
+		case Operator::LessEqual: 
+			return (text <= value); 
+		case Operator::Greater: 
+			return (text > value); 
+		case Operator::GreaterEqual: 
+			return (text >= value); 
+		case Operator::Match: 
+			return strmatch(value, std::string(text)); 
+		default: 
+			return false; 
+	}
+}
+
+// Equality on an integer field goes through the index of the file rather than the column, false when it can't
+bool Query::lookup (const Condition& condition, const Table& table, std::vector<unsigned char>& selected) const {
+	const Format::Attribute* attribute = this->m_columns[condition.column].attribute; 
+	if ((condition.op != Operator::Equal) || (attribute == nullptr) || (table.file == nullptr)) {
+		return false; 
+	}
+	if ((attribute->type != AttributeType::Unsigned) && (attribute->type != AttributeType::Signed) && (attribute->type != AttributeType::Boolean)) {
+		return false; 
+	}
+	
+	// The index only keeps the bits of the field, a value that doesn't fit in them matches nothing
+	unsigned size = (attribute->type == AttributeType::Boolean)? 1 : attribute->size; 
+	unsigned mask = (size < 32)? (1U << size) - 1 : 0xFFFFFFFFU; 
+	unsigned sign = ((attribute->type == AttributeType::Signed) && (size < 32))? 1U << (size - 1) : 0; 
+	unsigned value = (attribute->type == AttributeType::Signed)? static_cast<unsigned>(condition.value.getSigned()) : condition.value.getUnsigned(); 
+	std::vector<unsigned char> found(selected.size(), 0); 
+	if ((((value & mask) ^ sign) - sign) == value) {
+		const std::set<std::string>& entries = table.file->getIndexedEntries(*attribute, value); 
+		for (auto it = entries.begin() ; it != entries.end() ; it++) {
+			auto row = std::lower_bound(table.names.begin(), table.names.end(), &*it, [](const std::string* a, const std::string* b) {
+				return *a < *b; 
+			}); 
+			if ((row != table.names.end()) && (**row == *it)) {
+				found[row - table.names.begin()] = 1; 
+			}
+		}
+	}
+	for (std::size_t i = 0 ; i < selected.size() ; i++) {
+		selected[i] &= found[i]; 
+	}
+	return true; 
+}
+
+void Query::evaluate (const Condition& condition, Table& table, std::vector<unsigned char>& selected) const {
+	// Entries come in selected and only stay selected if the condition holds
+	if (condition.op == Operator::And) {
+		this->evaluate(*condition.left, table, selected); 
+		this->evaluate(*condition.right, table, selected); 
+		return; 
+	} else if (condition.op == Operator::Or) {
+		std::vector<unsigned char> left(selected); 
+		this->evaluate(*condition.left, table, left); 
+		for (std::size_t i = 0 ; i < selected.size() ; i++) {
+			selected[i] &= !left[i]; 
+		}
+		this->evaluate(*condition.right, table, selected); 
+		for (std::size_t i = 0 ; i < selected.size() ; i++) {
+			selected[i] |= left[i]; 
+		}
+		return; 
+	} else if (condition.op == Operator::Not) {
+		std::vector<unsigned char> inner(selected); 
+		this->evaluate(*condition.left, table, inner); 
+		for (std::size_t i = 0 ; i < selected.size() ; i++) {
+			selected[i] &= !inner[i]; 
+		}
+		return; 
+	}
+	
+	if (this->lookup(condition, table, selected)) {
+		return; 
+	}
+	const Column& column = this->m_columns[condition.column]; 
+	const std::vector<unsigned>& values = this->extract(table, condition.column); 
+	if ((column.attribute == nullptr) || (column.attribute->type == AttributeType::String)) {
+		for (std::size_t i = 0 ; i < selected.size() ; i++) {
+			if (selected[i] != 0) {
+				std::string_view text = (column.attribute == nullptr)? std::string_view(*table.names[i]) : GetStringAt(*table.strings, values[i]); 
+				selected[i] = Query::Compare(condition.op, text, condition.text); 
+			}
+		}
+		return; 
+	}
+	switch (column.attribute->type) {
+		case AttributeType::Signed: 
+			Query::Compare<int>(condition.op, reinterpret_cast<const int*>(values.data()), condition.value.getSigned(), selected); 
+			break; 
+		case AttributeType::Float: 
+			Query::Compare<float>(condition.op, table.floats[condition.column].data(), condition.value.getFloat(), selected); 
+			break; 
+		default: 
+			Query::Compare<unsigned>(condition.op, values.data(), condition.value.getUnsigned(), selected); 
+	}
+}
+
+std::string Query::getText (const Table& table, unsigned column, std::size_t row) const {
+	const Column& info = this->m_columns[column]; 
+	if (info.attribute == nullptr) {
+		return *table.names[row]; 
+	}
+	
+	const Format::Attribute& attribute = *info.attribute; 
+	const Chunk& chunk = *table.chunks[row]; 
+	if (attribute.offset + 4 > chunk.size()) {
+		return ""; 
+	}
+	AttributeValue value; 
+	switch (attribute.type) {
+		case AttributeType::Boolean: 
+			return (chunk.getBoolean(attribute.offset, attribute.bit) == true)? "true" : "false"; 
+		case AttributeType::Unsigned: 
+			value.setUnsigned(chunk.getUnsignedMask(attribute.offset, attribute.bit, attribute.size)); 
+			break; 
+		case AttributeType::Signed: 
+			value.setSigned(chunk.getSignedMask(attribute.offset, attribute.bit, attribute.size)); 
+			break; 
+		case AttributeType::Float: 
+			value.setFloat(chunk.getFloat(attribute.offset)); 
+			break; 
+		case AttributeType::String: 
+			value.setString(GetStringAt(*table.strings, chunk.getUnsigned(attribute.offset))); 
+	}
+	
+	// Enumeration names first, like convert
+	if (info.enumInfo != nullptr) {
+		try {
+			switch (attribute.type) {
+				case AttributeType::Unsigned: 
+					return info.enumInfo->getName(value.getUnsigned()); 
+				case AttributeType::Signed: 
+					return info.enumInfo->getName(value.getSigned()); 
+				case AttributeType::Float: 
+					return info.enumInfo->getName(value.getFloat()); 
+				default: 
+					return info.enumInfo->getName(value.getString()); 
+			}
+		} catch (const std::logic_error& e) {} 
+	}
+	bool percentage = (attribute.format == AttributeFormat::Percentage); 
+	switch (attribute.type) {
+		case AttributeType::Unsigned: 
+			if (attribute.format == AttributeFormat::Hexadecimal) {
+				return strfmt("0x%0*X", (attribute.size+3)/4, value.getUnsigned()); 
+			}
+			return strfmt((percentage == true)? "%u%%" : "%u", value.getUnsigned()); 
+		case AttributeType::Signed: 
+			return strfmt((percentage == true)? "%d%%" : "%d", value.getSigned()); 
+		case AttributeType::Float: 
+			return strfmt((percentage == true)? "%.2f%%" : "%.2f", value.getFloat()); 
+		default: 
+			return std::string(value.getString()); 
+	}
+}
+
+bool Query::run (const WPDFile& file) {
+	Profile::Scope scope("query"); 
+	this->m_rows.clear(); 
+	
+	Table table; 
+	table.file = &file; 
+	static const Chunk empty; 
+	auto strings = file.m_entryList.find("!!string"); 
+	table.strings = (strings != file.m_entryList.end())? &strings->second : &empty; 
+	for (auto it = file.m_entryList.begin() ; it != file.m_entryList.end() ; it++) {
+		if (it->first[0] != '!') {
+			table.names.push_back(&it->first); 
+			table.chunks.push_back(&it->second); 
+		}
+	}
+	table.values.resize(this->m_columns.size()); 
+	table.floats.resize(this->m_columns.size()); 
+	
+	// Filtering
+	std::vector<unsigned char> selected(table.chunks.size(), 1); 
+	if (this->m_where) {
+		this->evaluate(*this->m_where, table, selected); 
+	}
+	std::vector<std::size_t> rows; 
+	for (std::size_t i = 0 ; i < selected.size() ; i++) {
+		if (selected[i] != 0) {
+			rows.push_back(i); 
+		}
+	}
+	Profile::Count(ProfileCounter::EntriesTouched, table.chunks.size()); 
+	
+	// Sorting, entries that compare equal keep their name order
+	if (this->m_orderBy >= 0) {
+		const Column& column = this->m_columns[this->m_orderBy]; 
+		const std::vector<unsigned>& values = this->extract(table, this->m_orderBy); 
+		const std::vector<float>& floats = table.floats[this->m_orderBy]; 
+		bool descending = this->m_descending; 
+		auto less = [&](std::size_t a, std::size_t b) {
+			if (descending == true) {
+				std::swap(a, b); 
+			}
+			if (column.attribute == nullptr) {
+				return *table.names[a] < *table.names[b]; 
+			}
+			switch (column.attribute->type) {
+				case AttributeType::Signed: 
+					return static_cast<int>(values[a]) < static_cast<int>(values[b]); 
+				case AttributeType::Float: 
+					return floats[a] < floats[b]; 
+				case AttributeType::String: 
+					return GetStringAt(*table.strings, values[a]) < GetStringAt(*table.strings, values[b]); 
+				default: 
+					return values[a] < values[b]; 
+			}
+		}; 
+		std::stable_sort(rows.begin(), rows.end(), less); 
+	}
+	if ((this->m_limit > 0) && (rows.size() > this->m_limit)) {
+		rows.resize(this->m_limit); 
+	}
+	
+	// Projecting, only now are values turned into text
+	this->m_rows.reserve(rows.size() + 1); 
+	this->m_rows.emplace_back(); 
+	for (auto column = this->m_select.begin() ; column != this->m_select.end() ; column++) {
+		this->m_rows.back().push_back(this->m_columns[*column].name); 
+	}
+	for (auto row = rows.begin() ; row != rows.end() ; row++) {
+		this->m_rows.emplace_back(); 
+		for (auto column = this->m_select.begin() ; column != this->m_select.end() ; column++) {
+			this->m_rows.back().push_back(this->getText(table, *column, *row)); 
+		}
+	}
+	return true; 
+}
+
+const std::vector<std::vector<std::string>>& Query::getRows () const {
+	return this->m_rows; 
+}
+
+void Query::print () const {
+	if (this->m_rows.empty()) {
+		return; 
+	}
+	
+	std::vector<std::size_t> widths(this->m_rows[0].size(), 0); 
+	for (auto row = this->m_rows.begin() ; row != this->m_rows.end() ; row++) {
+		for (std::size_t i = 0 ; i < row->size() ; i++) {
+			widths[i] = std::max(widths[i], (*row)[i].size()); 
+		}
+	}
+	for (auto row = this->m_rows.begin() ; row != this->m_rows.end() ; row++) {
+		std::string line; 
+		for (std::size_t i = 0 ; i < row->size() ; i++) {
+			line += (*row)[i]; 
+			if (i + 1 < row->size()) {
+				line.append(widths[i] - (*row)[i].size() + 2, ' '); 
+			}
+		}
+		Print("%s", line.c_str()); 
+	}
+	Print("%zu entries found.", this->m_rows.size() - 1); 
+}
+
+bool Query::save (const std::string& filename) const {
+	Print("Building CSV file \"%s\"...", filename.c_str()); 
+	PrintStart(); 
+	
+	std::string out; 
+	for (auto row = this->m_rows.begin() ; row != this->m_rows.end() ; row++) {
+		for (std::size_t i = 0 ; i < row->size() ; i++) {
+			if (i > 0) {
+				out += ','; 
+			}
+			WriteCsvField(out, (*row)[i]); 
+		}
+		out += '\n'; 
+	}
+	
+	bool written; 
+	if (!UpdateFile(filename, out, written, true)) {
+		PrintError("Couldn't open file \"%s\".", filename.c_str()); 
+		PrintAbort(); 
+		return false; 
+	}
+	Print("%zu entries exported.", (this->m_rows.empty())? 0 : this->m_rows.size() - 1); 
+	PrintDone(); 
+	return true; 
+}
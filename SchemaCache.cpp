@@ -0,0 +1,388 @@
+
+#include <cstring>
+#include <string_view>
+
+#include "include/SchemaCache.hpp"
+
+using namespace dbtool; 
+
+// Cache layout (native byte order, the file never leaves the machine): 
+// header	"DBSC", version, record count
+// record	key, length of payload, file count, (filename, size, time) per file, payload
+// Strings are stored as a 32-bit length followed by the characters. 
+static const char		SchemaMagic[4] = { 'D', 'B', 'S', 'C' }; 
+static const unsigned	SchemaVersion = 1; 
+
+MappedFile SchemaCache::s_file; 
+SchemaCache::SchemaRecordIndex SchemaCache::s_index; 
+SchemaCache::SchemaRecordList SchemaCache::s_records; 
+std::string SchemaCache::s_filename; 
+bool SchemaCache::s_modified = false; 
+std::mutex SchemaCache::s_mutex; 
+
+namespace {
+	
+	void WriteUnsigned(std::string& out, unsigned u) {
+		out.append(reinterpret_cast<const char*>(&u), sizeof(u)); 
+	}
+	
+	void WriteLong(std::string& out, unsigned long long u) {
+		out.append(reinterpret_cast<const char*>(&u), sizeof(u)); 
+	}
+	
+	void WriteString(std::string& out, std::string_view s) {
+		WriteUnsigned(out, s.size()); 
+		out.append(s.data(), s.size()); 
+	}
+	
+	// Readers advance the cursor and return false instead of running past the end of the record
+	class Reader {
+		private: 
+			const char* m_data; 
+			const char* m_end; 
+		
+		public: 
+			Reader (const char* data, const char* end)
+				:m_data(data), m_end(end) {} 
+			
+			const char* position () const {
+				return this->m_data; 
+			}
+			
+			bool read (void* value, std::size_t size) {
+				if (static_cast<std::size_t>(this->m_end - this->m_data) < size) {
+					return false; 
+				}
+				std::memcpy(value, this->m_data, size); 
+				this->m_data += size; 
+				return true; 
+			}
+			
+			bool readUnsigned (unsigned& u) {
+				return this->read(&u, sizeof(u)); 
+			}
+			
+			bool readLong (unsigned long long& u) {
+				return this->read(&u, sizeof(u)); 
+			}
+			
+			bool skip (std::size_t size) {
+				if (static_cast<std::size_t>(this->m_end - this->m_data) < size) {
+					return false; 
+				}
+				this->m_data += size; 
+				return true; 
+			}
+			
+			bool skipString () {
+				unsigned size; 
+				return this->readUnsigned(size) && this->skip(size); 
+			}
+			
+			bool readString (std::string& s) {
+				unsigned size; 
+				if ((!this->readUnsigned(size)) || (static_cast<std::size_t>(this->m_end - this->m_data) < size)) {
+					return false; 
+				}
+				s.assign(this->m_data, size); 
+				this->m_data += size; 
+				return true; 
+			}
+	}; 
+	
+}
+
+bool SchemaCache::Open(const std::string& filename) {
+	std::lock_guard<std::mutex> lock(s_mutex); 
+	s_file.close(); 
+	s_index.clear(); 
+	s_records.clear(); 
+	s_filename = filename; 
+	s_modified = false; 
+	
+	if (!s_file.open(filename)) {
+		return false; 
+	}
+	
+	Reader in(s_file.data(), s_file.data() + s_file.size()); 
+	char magic[4]; 
+	unsigned version, count; 
+	if ((!in.read(magic, 4)) || (std::memcmp(magic, SchemaMagic, 4) != 0) || (!in.readUnsigned(version)) || (version != SchemaVersion) || (!in.readUnsigned(count))) {
+		PrintVerbose("Schema cache \"%s\" is not valid.", filename.c_str()); 
+		s_file.close(); 
+		s_modified = true; 
+		return false; 
+	}
+	
+	// Indexing records, their source files are only checked when used
+	for (unsigned i = 0 ; i < count ; i++) {
+		const char* record = in.position(); 
+		std::string key; 
+		unsigned length, files; 
+		if ((!in.readString(key)) || (!in.readUnsigned(length)) || (!in.readUnsigned(files))) {
+			break; 
+		}
+		bool valid = true; 
+		for (unsigned j = 0 ; (j < files) && (valid == true) ; j++) {
+			valid = in.skipString() && in.skip(2 * sizeof(unsigned long long)); 
+		}
+		if ((valid == false) || (!in.skip(length))) {
+			s_modified = true; 
+			break; 
+		}
+		s_index[key] = SchemaRecord(record, in.position() - record); 
+	}
+	
+	return true; 
+}
+
+const char* SchemaCache::GetRecord(const std::string& key) {
+	SchemaRecordIndex::const_iterator it = s_index.find(key); 
+	if (it == s_index.end()) {
+		return nullptr; 
+	}
+	
+	// A record is only usable if none of its source files changed since it was written
+	Reader in(it->second.first, it->second.first + it->second.second); 
+	std::string name; 
+	unsigned length, files; 
+	if ((!in.readString(name)) || (!in.readUnsigned(length)) || (!in.readUnsigned(files))) {
+		PrintVerbose("Schema cache entry %s is not valid.", key.c_str()); 
+		s_index.erase(it); 
+		s_modified = true; 
+		return nullptr; 
+	}
+	for (unsigned i = 0 ; i < files ; i++) {
+		std::string file; 
+		FileStatus cached, status; 
+		if ((!in.readString(file)) || (!in.readLong(cached.size)) || (!in.readLong(cached.time))) {
+			PrintVerbose("Schema cache entry %s is not valid.", key.c_str()); 
+			s_index.erase(it); 
+			s_modified = true; 
+			return nullptr; 
+		}
+		if ((!GetFileStatus(file, status)) || (status.size != cached.size) || (status.time != cached.time)) {
+			PrintVerbose("Schema cache entry %s is out of date (\"%s\" changed).", key.c_str(), file.c_str()); 
+			s_index.erase(it); 
+			s_modified = true; 
+			return nullptr; 
+		}
+	}
+	return in.position(); 
+}
+
+void SchemaCache::SetRecord(const std::string& key, const std::list<std::string>& filenames, const std::string& data) {
+	std::string& record = s_records[key]; 
+	record.clear(); 
+	WriteString(record, key); 
+	WriteUnsigned(record, data.size()); 
+	WriteUnsigned(record, filenames.size()); 
+	for (auto it = filenames.begin() ; it != filenames.end() ; it++) {
+		FileStatus status = { 0, 0 }; 
+		GetFileStatus(*it, status); 
+		WriteString(record, *it); 
+		WriteLong(record, status.size); 
+		WriteLong(record, status.time); 
+	}
+	record.append(data); 
+	s_index.erase(key); 
+	s_modified = true; 
+}
+
+bool SchemaCache::Save() {
+	std::lock_guard<std::mutex> lock(s_mutex); 
+	if ((s_modified == false) || (s_filename == "")) {
+		return true; 
+	}
+	
+	// Keeping the records of the previous cache that were neither replaced nor found to be stale
+	for (auto it = s_index.begin() ; it != s_index.end() ; it++) {
+		if (s_records.find(it->first) == s_records.end()) {
+			s_records[it->first].assign(it->second.first, it->second.second); 
+		}
+	}
+	s_index.clear(); 
+	s_file.close(); 
+	
+	std::string content(SchemaMagic, 4); 
+	WriteUnsigned(content, SchemaVersion); 
+	WriteUnsigned(content, s_records.size()); 
+	for (auto it = s_records.begin() ; it != s_records.end() ; it++) {
+		content.append(it->second); 
+	}
+	
+	bool written; 
+	if (!UpdateFile(s_filename, content, written)) {
+		PrintError("Couldn't write schema cache \"%s\".", s_filename.c_str()); 
+		return false; 
+	}
+	s_modified = false; 
+	return true; 
+}
+
+bool SchemaCache::ReadFormat(const std::string& name, Format& format) {
+	std::lock_guard<std::mutex> lock(s_mutex); 
+	const char* record = GetRecord("fmt:" + name); 
+	if (record == nullptr) {
+		return false; 
+	}
+	
+	Reader in(record, s_file.data() + s_file.size()); 
+	unsigned size, filenames, attributes; 
+	if ((!in.readUnsigned(size)) || (!in.readUnsigned(filenames))) {
+		return false; 
+	}
+	format.m_name = name; 
+	format.m_size = size; 
+	format.m_filenames.clear(); 
+	format.m_attributes.clear(); 
+	for (unsigned i = 0 ; i < filenames ; i++) {
+		std::string filename; 
+		if (!in.readString(filename)) {
+			return false; 
+		}
+		format.m_filenames.push_back(filename); 
+	}
+	if (!in.readUnsigned(attributes)) {
+		return false; 
+	}
+	for (unsigned i = 0 ; i < attributes ; i++) {
+		Format::Attribute attribute; 
+		unsigned type, fmt, hidden; 
+		if ((!in.readString(attribute.name)) || (!in.readString(attribute.enumName)) || (!in.readUnsigned(type)) || (!in.readUnsigned(fmt)) || (!in.readUnsigned(hidden)) || (!in.readUnsigned(attribute.offset)) || (!in.readUnsigned(attribute.bit)) || (!in.readUnsigned(attribute.size))) {
+			return false; 
+		}
+		attribute.type = static_cast<AttributeType>(type); 
+		attribute.format = static_cast<AttributeFormat>(fmt); 
+		attribute.hidden = (hidden != 0); 
+		format.m_attributes.push_back(attribute); 
+	}
+	return true; 
+}
+
+void SchemaCache::WriteFormat(const Format& format) {
+	std::lock_guard<std::mutex> lock(s_mutex); 
+	std::string data; 
+	WriteUnsigned(data, format.m_size); 
+	WriteUnsigned(data, format.m_filenames.size()); 
+	for (auto it = format.m_filenames.begin() ; it != format.m_filenames.end() ; it++) {
+		WriteString(data, *it); 
+	}
+	WriteUnsigned(data, format.m_attributes.size()); 
+	for (auto it = format.m_attributes.begin() ; it != format.m_attributes.end() ; it++) {
+		WriteString(data, it->name); 
+		WriteString(data, it->enumName); 
+		WriteUnsigned(data, static_cast<unsigned>(it->type)); 
+		WriteUnsigned(data, static_cast<unsigned>(it->format)); 
+		WriteUnsigned(data, it->hidden? 1 : 0); 
+		WriteUnsigned(data, it->offset); 
+		WriteUnsigned(data, it->bit); 
+		WriteUnsigned(data, it->size); 
+	}
+	SetRecord("fmt:" + format.m_name, format.m_filenames, data); 
+}
+
+bool SchemaCache::ReadEnum(const std::string& name, Enum& enumInfo) {
+	std::lock_guard<std::mutex> lock(s_mutex); 
+	const char* record = GetRecord("enum:" + name); 
+	if (record == nullptr) {
+		return false; 
+	}
+	
+	Reader in(record, s_file.data() + s_file.size()); 
+	unsigned type, strict, filenames, values; 
+	if ((!in.readUnsigned(type)) || (!in.readUnsigned(strict)) || (!in.readUnsigned(filenames))) {
+		return false; 
+	}
+	enumInfo.clear(); 
+	enumInfo.m_name = name; 
+	enumInfo.m_type = static_cast<AttributeType>(type); 
+	enumInfo.m_strict = (strict != 0); 
+	for (unsigned i = 0 ; i < filenames ; i++) {
+		std::string filename; 
+		if (!in.readString(filename)) {
+			return false; 
+		}
+		enumInfo.m_filenames.push_back(filename); 
+	}
+	if (!in.readUnsigned(values)) {
+		return false; 
+	}
+	for (unsigned i = 0 ; i < values ; i++) {
+		std::string key; 
+		unsigned valueType; 
+		if ((!in.readString(key)) || (!in.readUnsigned(valueType))) {
+			return false; 
+		}
+		AttributeValue value; 
+		switch (static_cast<AttributeType>(valueType)) {
+			case AttributeType::Boolean: 
+			case AttributeType::Unsigned: 
+			case AttributeType::Signed: 
+			case AttributeType::Float: {
+				unsigned u; 
+				if (!in.readUnsigned(u)) {
+					return false; 
+				}
+				if (static_cast<AttributeType>(valueType) == AttributeType::Boolean) {
+					value.setBoolean(u != 0); 
+				} else if (static_cast<AttributeType>(valueType) == AttributeType::Unsigned) {
+					value.setUnsigned(u); 
+				} else if (static_cast<AttributeType>(valueType) == AttributeType::Signed) {
+					value.setSigned(static_cast<int>(u)); 
+				} else {
+					float f; 
+					std::memcpy(&f, &u, sizeof(f)); 
+					value.setFloat(f); 
+				}
+				break; 
+			}
+			case AttributeType::String: {
+				std::string s; 
+				if (!in.readString(s)) {
+					return false; 
+				}
+				value.setString(enumInfo.addString(s)); 
+			}
+		}
+		enumInfo.m_values[key] = value; 
+	}
+	return true; 
+}
+
+void SchemaCache::WriteEnum(const Enum& enumInfo) {
+	std::lock_guard<std::mutex> lock(s_mutex); 
+	std::string data; 
+	WriteUnsigned(data, static_cast<unsigned>(enumInfo.m_type)); 
+	WriteUnsigned(data, enumInfo.m_strict? 1 : 0); 
+	WriteUnsigned(data, enumInfo.m_filenames.size()); 
+	for (auto it = enumInfo.m_filenames.begin() ; it != enumInfo.m_filenames.end() ; it++) {
+		WriteString(data, *it); 
+	}
+	WriteUnsigned(data, enumInfo.m_values.size()); 
+	for (auto it = enumInfo.m_values.begin() ; it != enumInfo.m_values.end() ; it++) {
+		WriteString(data, it->first); 
+		WriteUnsigned(data, static_cast<unsigned>(it->second.getType())); 
+		switch (it->second.getType()) {
+			case AttributeType::Boolean: 
+				WriteUnsigned(data, it->second.getBoolean()? 1 : 0); 
+				break; 
+			case AttributeType::Unsigned: 
+				WriteUnsigned(data, it->second.getUnsigned()); 
+				break; 
+			case AttributeType::Signed: 
+				WriteUnsigned(data, static_cast<unsigned>(it->second.getSigned())); 
+				break; 
+			case AttributeType::Float: {
+				float f = it->second.getFloat(); 
+				unsigned u; 
+				std::memcpy(&u, &f, sizeof(u)); 
+				WriteUnsigned(data, u); 
+				break; 
+			}
+			case AttributeType::String: 
+				WriteString(data, it->second.getString()); 
+		}
+	}
+	SetRecord("enum:" + enumInfo.m_name, enumInfo.m_filenames, data); 
+}
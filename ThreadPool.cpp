@@ -0,0 +1,126 @@
+
+#include "include/ThreadPool.hpp"
+
+using namespace dbtool; 
+
+// Index of the pool worker running on this thread, tasks submitted from a task stay on that worker
+static thread_local ThreadPool* CurrentPool = nullptr; 
+static thread_local unsigned CurrentWorker = 0; 
+
+ThreadPool::ThreadPool (unsigned threads)
+	:m_workers(), m_mutex(), m_wakeUp(), m_idle(), m_pending(0), m_next(0), m_stop(false) {
+		if (threads == 0) {
+			threads = 1; 
+		}
+		for (unsigned i = 0 ; i < threads ; i++) {
+			this->m_workers.emplace_back(new Worker()); 
+		}
+		for (unsigned i = 0 ; i < threads ; i++) {
+			this->m_workers[i]->thread = std::thread(&ThreadPool::run, this, i); 
+		}
+	}
+ThreadPool::~ThreadPool () {
+	this->wait(); 
+	{
+		std::lock_guard<std::mutex> lock(this->m_mutex); 
+		this->m_stop = true; 
+	}
+	this->m_wakeUp.notify_all(); 
+	for (auto it = this->m_workers.begin() ; it != this->m_workers.end() ; it++) {
+		(*it)->thread.join(); 
+	}
+}
+
+void ThreadPool::submit (const Task& task) {
+	{
+		std::lock_guard<std::mutex> lock(this->m_mutex); 
+		unsigned index; 
+		if (CurrentPool == this) {
+			index = CurrentWorker; 
+		} else {
+			index = this->m_next; 
+			this->m_next = (this->m_next + 1) % this->m_workers.size(); 
+		}
+		this->m_pending++; 
+		
+		std::lock_guard<std::mutex> queueLock(this->m_workers[index]->mutex); 
+		this->m_workers[index]->tasks.push_back(task); 
+	}
+	this->m_wakeUp.notify_all(); 
+}
+
+void ThreadPool::wait () {
+	std::unique_lock<std::mutex> lock(this->m_mutex); 
+	this->m_idle.wait(lock, [this]() {
+		return this->m_pending == 0; 
+	}); 
+}
+
+unsigned ThreadPool::getThreadCount () const {
+	return this->m_workers.size(); 
+}
+
+unsigned ThreadPool::GetDefaultThreadCount () {
+	unsigned threads = std::thread::hardware_concurrency(); 
+	return (threads > 0)? threads : 1; 
+}
+
+bool ThreadPool::IsWorkerThread () {
+	return CurrentPool != nullptr; 
+}
+
+bool ThreadPool::pop (unsigned index, Task& task) {
+	// Own queue first, in submission order
+	{
+		Worker& worker = *this->m_workers[index]; 
+		std::lock_guard<std::mutex> lock(worker.mutex); 
+		if (!worker.tasks.empty()) {
+			task = std::move(worker.tasks.front()); 
+			worker.tasks.pop_front(); 
+			return true; 
+		}
+	}
+	
+	// Then stealing from the others
+	for (unsigned i = 1 ; i < this->m_workers.size() ; i++) {
+		Worker& victim = *this->m_workers[(index + i) % this->m_workers.size()]; 
+		std::lock_guard<std::mutex> lock(victim.mutex); 
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.back()); 
+			victim.tasks.pop_back(); 
+			return true; 
+		}
+	}
+	return false; 
+}
+
+void ThreadPool::run (unsigned index) {
+	CurrentPool = this; 
+	CurrentWorker = index; 
+	
+	while (true) {
+		Task task; 
+		if (this->pop(index, task)) {
+			task(); 
+			std::lock_guard<std::mutex> lock(this->m_mutex); 
+			if (--this->m_pending == 0) {
+				this->m_idle.notify_all(); 
+			}
+			continue; 
+		}
+		
+		std::unique_lock<std::mutex> lock(this->m_mutex); 
+		if (this->m_stop == true) {
+			return; 
+		}
+		// Tasks that are queued but not yet taken by anyone mean there is something to steal
+		size_t queued = 0; 
+		for (auto it = this->m_workers.begin() ; it != this->m_workers.end() ; it++) {
+			std::lock_guard<std::mutex> queueLock((*it)->mutex); 
+			queued += (*it)->tasks.size(); 
+		}
+		if (queued == 0) {
+			this->m_wakeUp.wait(lock); 
+		}
+	}
+}
@@ -1,22 +1,233 @@
 
+#include <charconv>
+#include <chrono>
 #include <cstdarg>
-#include <windows.h>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 
+#include "include/Profile.hpp"
 #include "include/Tools.hpp"
 
 using namespace dbtool; 
 
-int PrintIndent = 0; 
-bool PrintVerboseMode = false; 
+// Folders known to exist, and the status of the files of every folder queried so far
+static std::mutex FileSystemMutex; 
+static std::unordered_set<std::string> FolderList; 
+static std::unordered_map<std::string, std::unordered_map<std::string, FileStatus>> FolderStatusList; 
+
+static void SplitPath(const std::string& filename, std::string& folder, std::string& name) {
+	std::string::size_type end = filename.rfind('/'); 
+	folder = (end != std::string::npos)? filename.substr(0, end) : "."; 
+	name = (end != std::string::npos)? filename.substr(end + 1) : filename; 
+}
+
+static unsigned long long GetFileTime(std::filesystem::file_time_type time) {
+	// Only compared with each other, so the clock's own epoch will do
+	return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count()); 
+}
 
 void dbtool::CreateFolderForFile(const std::string& filename) {
 	std::string::size_type end; 
 	for (end = filename.find('/') ; end != std::string::npos ; end = filename.find('/', end+1)) {
 		std::string folder = filename.substr(0, end); 
-		if (CreateDirectory(folder.c_str(), nullptr)) {
+		
+		// Created under the lock, another job needing the folder waits for it instead of finding it listed but missing
+		std::lock_guard<std::mutex> lock(FileSystemMutex); 
+		if (FolderList.count(folder) > 0) {
+			continue; 
+		}
+		std::error_code error; 
+		if (std::filesystem::create_directory(folder, error)) {
 			Print("Creating directory %s...", folder.c_str()); 
 		}
+		if (std::filesystem::is_directory(folder, error)) {
+			FolderList.insert(folder); 
+		}
+	}
+}
+
+bool dbtool::GetFileStatus(const std::string& filename, FileStatus& status) {
+	std::string folder, name; 
+	SplitPath(filename, folder, name); 
+	
+	// The whole folder is listed the first time one of its files is asked for
+	std::lock_guard<std::mutex> lock(FileSystemMutex); 
+	auto it = FolderStatusList.find(folder); 
+	if (it == FolderStatusList.end()) {
+		it = FolderStatusList.emplace(folder, std::unordered_map<std::string, FileStatus>()).first; 
+		std::error_code error; 
+		for (std::filesystem::directory_iterator entry(folder, error), end ; (!error) && (entry != end) ; entry.increment(error)) {
+			std::error_code entryError; 
+			if (!entry->is_regular_file(entryError)) {
+				continue; 
+			}
+			FileStatus entryStatus; 
+			entryStatus.size = entry->file_size(entryError); 
+			entryStatus.time = GetFileTime(entry->last_write_time(entryError)); 
+			if (!entryError) {
+				it->second[entry->path().filename().string()] = entryStatus; 
+			}
+		}
+	}
+	
+	auto file = it->second.find(name); 
+	if (file == it->second.end()) {
+		return false; 
+	}
+	status = file->second; 
+	return true; 
+}
+
+bool dbtool::ReadFileStatus(const std::string& filename, FileStatus& status) {
+	std::error_code error; 
+	std::filesystem::path path(filename); 
+	if (!std::filesystem::is_regular_file(path, error)) {
+		return false; 
 	}
+	status.size = std::filesystem::file_size(path, error); 
+	status.time = GetFileTime(std::filesystem::last_write_time(path, error)); 
+	return !error; 
+}
+
+void dbtool::ForgetFileStatus(const std::string& filename) {
+	std::string folder, name; 
+	SplitPath(filename, folder, name); 
+	
+	std::lock_guard<std::mutex> lock(FileSystemMutex); 
+	auto it = FolderStatusList.find(folder); 
+	if (it != FolderStatusList.end()) {
+		FileStatus status; 
+		if (ReadFileStatus(filename, status)) {
+			it->second[name] = status; 
+		} else {
+			it->second.erase(name); 
+		}
+	}
+}
+
+bool dbtool::ReadWholeFile(const std::string& filename, std::string& content) {
+	std::ifstream in(filename, std::ifstream::in | std::ifstream::binary); 
+	if (!in.is_open()) {
+		return false; 
+	}
+	content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()); 
+	Profile::Count(ProfileCounter::BytesRead, content.size()); 
+	return !in.bad(); 
+}
+
+bool dbtool::UpdateFile(const std::string& filename, const std::string& content, bool& written, bool text) {
+	written = false; 
+	std::ios_base::openmode mode = text? std::ios_base::openmode() : std::ios_base::binary; 
+	
+	// Leave the file (and its modification time) alone when the content is the same
+	FileStatus status; 
+	if ((GetFileStatus(filename, status) == true) && ((text == true) || (status.size == content.size()))) {
+		std::ifstream in(filename, std::ifstream::in | mode); 
+		if (in.is_open()) {
+			std::string current((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>()); 
+			Profile::Count(ProfileCounter::BytesRead, current.size()); 
+			if (current == content) {
+				return true; 
+			}
+		}
+	}
+	
+	CreateFolderForFile(filename); 
+	std::ofstream out(filename, std::ofstream::out | std::ofstream::trunc | mode); 
+	if (!out.is_open()) {
+		return false; 
+	}
+	out.write(content.data(), content.size()); 
+	out.close(); 
+	ForgetFileStatus(filename); 
+	Profile::Count(ProfileCounter::BytesWritten, content.size()); 
+	written = true; 
+	return !out.fail(); 
+}
+
+bool dbtool::ReplaceFile(const std::string& filename, const std::string& temporary, bool& written) {
+	written = false; 
+	FileStatus status, replacement; 
+	if (!ReadFileStatus(temporary, replacement)) {
+		return false; 
+	}
+	
+	// Leave the file (and its modification time) alone when the content is the same, comparing a block at a time
+	if ((GetFileStatus(filename, status) == true) && (status.size == replacement.size)) {
+		std::ifstream current(filename, std::ifstream::in | std::ifstream::binary); 
+		std::ifstream content(temporary, std::ifstream::in | std::ifstream::binary); 
+		bool same = (current.is_open()) && (content.is_open()); 
+		char a[65536], b[65536]; 
+		while ((same == true) && (current.good()) && (content.good())) {
+			current.read(a, sizeof(a)); 
+			content.read(b, sizeof(b)); 
+			same = (current.gcount() == content.gcount()) && (std::memcmp(a, b, current.gcount()) == 0); 
+			Profile::Count(ProfileCounter::BytesRead, current.gcount()); 
+		}
+		current.close(); 
+		content.close(); 
+		if (same == true) {
+			std::error_code error; 
+			std::filesystem::remove(temporary, error); 
+			return true; 
+		}
+	}
+	
+	std::error_code error; 
+	std::filesystem::rename(temporary, filename, error); 
+	if (error) {
+		std::filesystem::remove(temporary, error); 
+		return false; 
+	}
+	ForgetFileStatus(filename); 
+	Profile::Count(ProfileCounter::BytesWritten, replacement.size); 
+	written = true; 
+	return true; 
+}
+
+unsigned long long dbtool::HashData(const void* data, std::size_t size, unsigned long long hash) {
+	// FNV-1a, folding 8 bytes per round
+	const unsigned long long prime = 0x100000001B3ULL; 
+	const char* bytes = static_cast<const char*>(data); 
+	while (size >= 8) {
+		unsigned long long word; 
+		std::memcpy(&word, bytes, 8); 
+		hash = (hash ^ word) * prime; 
+		hash ^= hash >> 29; 
+		bytes += 8; 
+		size -= 8; 
+	}
+	while (size > 0) {
+		hash = (hash ^ static_cast<unsigned char>(*bytes)) * prime; 
+		bytes++; 
+		size--; 
+	}
+	return hash; 
+}
+
+unsigned long long dbtool::HashString(const std::string& str, unsigned long long hash) {
+	// Includes the terminator so that consecutive strings can't run into each other
+	return HashData(str.c_str(), str.size()+1, hash); 
+}
+
+bool dbtool::HashFile(const std::string& filename, unsigned long long& hash) {
+	std::ifstream in(filename, std::ifstream::in | std::ifstream::binary); 
+	if (!in.is_open()) {
+		return false; 
+	}
+	char buffer[65536]; 
+	hash = HashData(nullptr, 0); 
+	while (in) {
+		in.read(buffer, sizeof(buffer)); 
+		hash = HashData(buffer, in.gcount(), hash); 
+		Profile::Count(ProfileCounter::BytesRead, in.gcount()); 
+	}
+	return true; 
 }
 
 bool dbtool::strmatch(const char* format, const char* string, const char* end) {
@@ -53,7 +264,10 @@ bool dbtool::strmatch(const std::string& format, const std::string& string) {
 std::string dbtool::strfmt(const std::string& format, ...) {
 	va_list args; 
 	va_start(args, format); 
-	unsigned size = vsnprintf(NULL, 0, format.c_str(), args) + 1; 
+	va_list sizeArgs; 
+	va_copy(sizeArgs, args); 
+	unsigned size = vsnprintf(NULL, 0, format.c_str(), sizeArgs) + 1; 
+	va_end(sizeArgs); 
 	char* buf = (char*)malloc(size*sizeof(char)); 
 	vsnprintf(buf, size, format.c_str(), args); 
 	std::string str(buf); 
@@ -62,58 +276,84 @@ std::string dbtool::strfmt(const std::string& format, ...) {
 	return str; 
 }
 
-void dbtool::SetVerboseMode(bool verbose) {
-	PrintVerboseMode = verbose; 
-}
-
-void dbtool::Print() {
-	printf("\n"); 
+// Spaces around a number are allowed (XML attributes may have them), what's between is parsed as is
+static std::string_view TrimNumber(std::string_view text) {
+	std::size_t begin = text.find_first_not_of(" \t\r\n"); 
+	if (begin == std::string_view::npos) {
+		return std::string_view(); 
+	}
+	return text.substr(begin, text.find_last_not_of(" \t\r\n") - begin + 1); 
 }
 
-void dbtool::Print(const std::string& format, ...) {
-	if (PrintIndent > 0) {
-		for (int i = 0 ; i < PrintIndent ; i++) {
-			printf(">"); 
-		}
-		printf(" "); 
+static std::errc ParseDigits(std::string_view text, unsigned& value, unsigned bits, int base) {
+	unsigned result = 0; 
+	std::from_chars_result parsed = std::from_chars(text.data(), text.data() + text.size(), result, base); 
+	if ((text.empty()) || (parsed.ptr != text.data() + text.size())) {
+		return std::errc::invalid_argument; 
+	} else if ((parsed.ec == std::errc::result_out_of_range) || ((bits < 32) && ((result >> bits) != 0))) {
+		return std::errc::result_out_of_range; 
 	}
-	va_list args; 
-	va_start(args, format); 
-	vprintf(format.c_str(), args); 
-	va_end(args); 
-	printf("\n"); 
+	value = result; 
+	return std::errc(); 
 }
 
-void dbtool::PrintVerbose(const std::string& format, ...) {
-	if (PrintVerboseMode == true) {
-		if (PrintIndent > 0) {
-			for (int i = 0 ; i < PrintIndent ; i++) {
-				printf(">"); 
-			}
-			printf(" "); 
-		}
-		va_list args; 
-		va_start(args, format); 
-		vprintf(format.c_str(), args); 
-		va_end(args); 
-		printf("\n"); 
+std::errc dbtool::ParseUnsigned(std::string_view text, unsigned& value, unsigned bits) {
+	text = TrimNumber(text); 
+	if ((text.size() > 2) && (text[0] == '0') && ((text[1] == 'x') || (text[1] == 'X'))) {
+		return ParseDigits(text.substr(2), value, bits, 16); 
 	}
+	if ((!text.empty()) && (text.back() == '%')) {
+		text.remove_suffix(1); 
+	}
+	return ParseDigits(text, value, bits, 10); 
 }
 
-void dbtool::PrintStart() {
-	PrintIndent++; 
+std::errc dbtool::ParseHexadecimal(std::string_view text, unsigned& value, unsigned bits) {
+	text = TrimNumber(text); 
+	if ((text.size() > 2) && (text[0] == '0') && ((text[1] == 'x') || (text[1] == 'X'))) {
+		text.remove_prefix(2); 
+	}
+	return ParseDigits(text, value, bits, 16); 
 }
 
-void dbtool::PrintDone() {
-	if (PrintIndent > 0) {
-		PrintIndent--; 
+std::errc dbtool::ParseSigned(std::string_view text, int& value, unsigned bits) {
+	text = TrimNumber(text); 
+	if ((!text.empty()) && (text.back() == '%')) {
+		text.remove_suffix(1); 
 	}
-	if (PrintIndent == 0) {
-		Print(); 
+	
+	long long result = 0; 
+	std::from_chars_result parsed = std::from_chars(text.data(), text.data() + text.size(), result, 10); 
+	if ((text.empty()) || (parsed.ptr != text.data() + text.size())) {
+		return std::errc::invalid_argument; 
 	}
+	long long limit = 1LL << (((bits == 0) || (bits > 32))? 31 : bits - 1); 
+	if ((parsed.ec == std::errc::result_out_of_range) || (result < -limit) || (result >= limit)) {
+		return std::errc::result_out_of_range; 
+	}
+	value = static_cast<int>(result); 
+	return std::errc(); 
 }
 
-void dbtool::PrintAbort() {
-	Print("ABORTED"); 
-	PrintDone(); 
+std::errc dbtool::ParseFloat(std::string_view text, float& value) {
+	text = TrimNumber(text); 
+	if ((!text.empty()) && (text.back() == '%')) {
+		text.remove_suffix(1); 
+	}
+	
+	// A digit first (after the sign), from_chars would take inf and nan too
+	std::size_t digit = ((!text.empty()) && (text[0] == '-'))? 1 : 0; 
+	if ((text.size() <= digit) || (text[digit] < '0') || (text[digit] > '9')) {
+		return std::errc::invalid_argument; 
+	}
+	
+	float result = 0; 
+	std::from_chars_result parsed = std::from_chars(text.data(), text.data() + text.size(), result, std::chars_format::fixed); 
+	if (parsed.ptr != text.data() + text.size()) {
+		return std::errc::invalid_argument; 
+	} else if (parsed.ec == std::errc::result_out_of_range) {
+		return std::errc::result_out_of_range; 
+	}
+	value = result; 
+	return std::errc(); 
 }
@@ -1,53 +1,252 @@
 
+#include <algorithm>
+#include <charconv>
+#include <cstdarg>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
 #include <fstream>
 #include <regex>
+#include <sstream>
+#include <vector>
 
 #include "include/Enum.hpp"
 #include "include/Format.hpp"
+#include "include/MappedFile.hpp"
+#include "include/Profile.hpp"
 #include "include/WPDFile.hpp"
 
 using namespace dbtool; 
+
+// Formats into a stack buffer, converting entries shouldn't allocate for every value
+static void WriteFormatted (std::ostream& out, const char* format, ...) {
+	char buffer[256]; 
+	va_list args; 
+	va_start(args, format); 
+	int size = vsnprintf(buffer, sizeof(buffer), format, args); 
+	va_end(args); 
+	if (size < 0) {
+		return; 
+	} else if (static_cast<unsigned>(size) < sizeof(buffer)) {
+		out.write(buffer, size); 
+	} else {
+		std::string large(size + 1, '\0'); 
+		va_start(args, format); 
+		vsnprintf(&large[0], large.size(), format, args); 
+		va_end(args); 
+		out.write(large.data(), size); 
+	}
+}
+
+// Writes an integer with to_chars, streaming it would go through the locale for every value
+template<typename T>
+static void WriteNumber (std::ostream& out, T value) {
+	char buffer[16]; 
+	std::to_chars_result written = std::to_chars(buffer, buffer + sizeof(buffer), value); 
+	out.write(buffer, written.ptr - buffer); 
+}
+	
+// Shortest decimal form that reads back as the same float, patch files don't take exponents
+static void WriteExactFloat (std::ostream& out, float f) {
+	char buffer[128]; 
+	for (int precision = 2 ; precision < 48 ; precision++) {
+		snprintf(buffer, sizeof(buffer), "%.*f", precision, f); 
+		if (strtof(buffer, nullptr) == f) {
+			break; 
+		}
+	}
+	out << buffer; 
+}
+
+// Strings past the end of the table read as empty, a diff shouldn't stop at a broken reference
+static std::string_view GetStringAt (const Chunk& strings, unsigned offset) {
+	return (offset < strings.size())? strings.getStringView(offset) : std::string_view(); 
+}
+
+// Writes a value the way patch reads it back, enumerations by name when they have one
+static void WriteValue (std::ostream& out, const Chunk& data, const Format::Attribute& attribute, Enum* enumInfo, const Chunk& strings) {
+	AttributeValue value; 
+	switch (attribute.type) {
+		case AttributeType::Boolean: 
+			out << ((data.getBoolean(attribute.offset, attribute.bit) == true)? "true" : "false"); 
+			break; 
+		case AttributeType::Unsigned: 
+			value.setUnsigned(data.getUnsignedMask(attribute.offset, attribute.bit, attribute.size)); 
+			if (enumInfo != nullptr) {
+				try {
+					out << enumInfo->getName(value.getUnsigned()); 
+					break; 
+				} catch (const std::logic_error& e) {} 
+			}
+			switch (attribute.format) {
+				case AttributeFormat::Hexadecimal: 
+					WriteFormatted(out, "0x%0*X", (attribute.size+3)/4, value.getUnsigned()); 
+					break; 
+				case AttributeFormat::Percentage: 
+					WriteFormatted(out, "%u%%", value.getUnsigned()); 
+					break; 
+				default: 
+					WriteNumber(out, value.getUnsigned()); 
+			}
+			break; 
+		case AttributeType::Signed: 
+			value.setSigned(data.getSignedMask(attribute.offset, attribute.bit, attribute.size)); 
+			if (enumInfo != nullptr) {
+				try {
+					out << enumInfo->getName(value.getSigned()); 
+					break; 
+				} catch (const std::logic_error& e) {} 
+			}
+			WriteNumber(out, value.getSigned()); 
+			if (attribute.format == AttributeFormat::Percentage) {
+				out << '%'; 
+			}
+			break; 
+		case AttributeType::Float: 
+			value.setFloat(data.getFloat(attribute.offset)); 
+			if (enumInfo != nullptr) {
+				try {
+					out << enumInfo->getName(value.getFloat()); 
+					break; 
+				} catch (const std::logic_error& e) {} 
+			}
+			WriteExactFloat(out, value.getFloat()); 
+			if (attribute.format == AttributeFormat::Percentage) {
+				out << '%'; 
+			}
+			break; 
+		case AttributeType::String: 
+			value.setString(GetStringAt(strings, data.getUnsigned(attribute.offset))); 
+			if (enumInfo != nullptr) {
+				try {
+					out << enumInfo->getName(value.getString()); 
+					break; 
+				} catch (const std::logic_error& e) {} 
+			}
+			out << '"' << value.getString() << '"'; 
+	}
+}
+	
+// Where an entry of the file is, as its entry list says
+struct EntryRecord {
+	std::string		name; 
+	unsigned		offset; 
+	unsigned		size; 
+}; 
+
+// Reads the entry list of the file, in file order, checking that every entry is inside the file
+static bool ReadEntryList (std::string_view data, std::vector<EntryRecord>& entries) {
+	if ((data.size() < 16) || (data.compare(0, 4, std::string_view("WPD", 4)) != 0)) {
+		PrintError("Magic word does not match \"%s\".", "WPD"); 
+		PrintAbort(); 
+		return false; 
+	}
 	
+	Chunk header(16); 
+	std::memcpy(header.data(), data.data(), 16); 
+	unsigned count = header.getUnsigned(4); 
+	Print("%u entries found.", count); 
+	if (16 + count * 32ULL > data.size()) {
+		PrintError("Entry list is out of the file."); 
+		PrintAbort(); 
+		return false; 
+	}
+	
+	// One chunk for every record, the list is read without allocating an entry at a time
+	entries.reserve(count); 
+	Chunk entry(32); 
+	for (unsigned i = 0 ; i < count ; i++) {
+		std::memcpy(entry.data(), data.data() + 16 + i * 32, 32); 
+		EntryRecord record; 
+		record.name = entry.getString(0); 
+		record.offset = entry.getUnsigned(16); 
+		record.size = entry.getUnsigned(20); 
+		if (static_cast<unsigned long long>(record.offset) + record.size > data.size()) {
+			PrintError("Entry %s is out of the file.", record.name.c_str()); 
+			PrintAbort(); 
+			return false; 
+		}
+		entries.push_back(record); 
+	}
+	return true; 
+}
+
+static void ReadEntry (std::string_view data, const EntryRecord& record, Chunk& chunk) {
+	chunk.resize(record.size); 
+	if (record.size > 0) {
+		// Entries are padded to 4 bytes, the padding is read from the file like the data
+		std::memcpy(chunk.data(), data.data() + record.offset, std::min<unsigned long long>(chunk.size(), data.size() - record.offset)); 
+	}
+}
+
 WPDFile::WPDFile ()
-	:m_entryList(), m_modified(false), m_fileAttributes() {}
+	:m_entryList(), m_modified(false), m_indexes() {} 
 WPDFile::~WPDFile () {}
 
 bool WPDFile::load (const std::string& filename) {
+	Profile::Scope scope("load", filename); 
 	Print("Loading WPD file \"%s\"...", filename.c_str()); 
 	PrintStart(); 
 	this->m_entryList.clear(); 
+	this->m_indexes.clear(); 
 	this->m_modified = false; 
 	
-	if (GetFileAttributesEx(filename.c_str(), GetFileExInfoStandard, &this->m_fileAttributes) == 0) {
-		Print("File \"%s\" does not exist.", filename.c_str()); 
+	FileStatus status; 
+	if (!GetFileStatus(filename, status)) {
+		PrintError("File \"%s\" does not exist.", filename.c_str()); 
 		PrintAbort(); 
 		return false; 
 	}
 	
-	std::ifstream in(filename, std::ofstream::in | std::ofstream::binary); 
-	if (!in.is_open()) {
-		Print("Couldn't open file \"%s\".", filename.c_str()); 
+	MappedFile file; 
+	if (!file.open(filename)) {
+		PrintError("Couldn't open file \"%s\".", filename.c_str()); 
 		PrintAbort(); 
 		return false; 
 	}
+	Profile::Count(ProfileCounter::BytesRead, file.size()); 
 	
-	Chunk header(in, 16); 
-	if (header.getString(0) != "WPD") {
-		Print("Magic word does not match \"%s\".", "WPD"); 
+	return this->read(std::string_view(file.data(), file.size())); 
+}
+
+bool WPDFile::load (const std::string& name, std::string_view data) {
+	Profile::Scope scope("load", name); 
+	Print("Loading WPD file \"%s\"...", name.c_str()); 
+	PrintStart(); 
+	this->m_entryList.clear(); 
+	this->m_indexes.clear(); 
+	this->m_modified = false; 
+	
+	return this->read(data); 
+}
+
+bool WPDFile::load (const Archive& archive, const std::string& path) {
+	std::string_view data; 
+	std::string buffer; 
+	if (!archive.read(path, data, buffer)) {
+		Print("Loading WPD file \"%s/%s\"...", archive.getImageFilename().c_str(), path.c_str()); 
+		PrintStart(); 
+		PrintError("Couldn't read file \"%s\" from the archive.", path.c_str()); 
 		PrintAbort(); 
 		return false; 
 	}
+	return this->load(strfmt("%s/%s", archive.getImageFilename().c_str(), path.c_str()), data); 
+}
+
+bool WPDFile::read (std::string_view data) {
+	std::vector<EntryRecord> entries; 
+	if (!ReadEntryList(data, entries)) {
+		return false; 
+	}
 	
-	unsigned count = header.getUnsigned(4); 
-	Print("%u entries found.", count); 
-	for (int i = 0 ; i < count ; i++) {
-		Chunk entry(in, 32); 
-		Chunk& data = this->getEntryData(entry.getString(0)); 
-		data.resize(entry.getUnsigned(20)); 
-		data.read(in, entry.getUnsigned(16)); 
+	for (auto it = entries.begin() ; it != entries.end() ; it++) {
+		Chunk& chunk = this->getEntryData(it->name); 
+		if (it->name == "!!string") {
+			chunk.setTag(MemoryTag::Strings); 
+		}
+		ReadEntry(data, *it, chunk); 
 	}
 	
 	PrintDone(); 
@@ -55,17 +254,27 @@ bool WPDFile::load (const std::string& filename) {
 }
 
 bool WPDFile::save (const std::string& filename) const {
+	Profile::Scope scope("save", filename); 
 	Print("Building WPD file \"%s\"...", filename.c_str()); 
 	PrintStart(); 
 	
 	CreateFolderForFile(filename); 
 	std::ofstream out(filename, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc); 
 	if (!out.is_open()) {
-		Print("Couldn't open file \"%s\".", filename.c_str()); 
+		PrintError("Couldn't open file \"%s\".", filename.c_str()); 
 		PrintAbort(); 
 		return false; 
 	}
 	
+	this->save(out); 
+	out.close(); 
+	ForgetFileStatus(filename); 
+	
+	PrintDone(); 
+	return true; 
+}
+
+void WPDFile::save (std::ostream& out) const {
 	Chunk header(16); 
 	header.setString(0, "WPD"); 
 	header.setUnsigned(4, this->getEntryCount()); 
@@ -74,8 +283,9 @@ bool WPDFile::save (const std::string& filename) const {
 	unsigned count = this->getEntryCount(); 
 	Print("%u entries saved.", count); 
 	unsigned dataOffset = 16 + count * 32; 
+	Chunk entry(32); 
 	for (auto it = this->m_entryList.begin() ; it != this->m_entryList.end() ; it++) {
-		Chunk entry(32); 
+		entry.clear(); 
 		entry.setString(0, it->first); 
 		entry.setUnsigned(16, dataOffset); 
 		entry.setUnsigned(20, it->second.size()); 
@@ -86,91 +296,158 @@ bool WPDFile::save (const std::string& filename) const {
 	for (auto it = this->m_entryList.begin() ; it != this->m_entryList.end() ; it++) {
 		it->second.write(out); 
 	}
-	
-	PrintDone(); 
-	return true; 
+	Profile::Count(ProfileCounter::BytesWritten, dataOffset); 
+}
+
+// Patch files named .csv are tables, a header row of attribute names with an @id column, then a row per entry
+static bool IsTable (const std::string& filename) {
+	if (filename.size() < 4) {
+		return false; 
+	}
+	std::string extension = filename.substr(filename.size() - 4); 
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) {
+		return static_cast<char>(tolower(c)); 
+	}); 
+	return extension == ".csv"; 
 }
 
 bool WPDFile::patch (const std::string& filename, const std::string& format) {
-	WIN32_FILE_ATTRIBUTE_DATA fileAttributes; 
-	if (GetFileAttributesEx(filename.c_str(), GetFileExInfoStandard, &fileAttributes) == 0) {
-		Print("File \"%s\" does not exist.", filename.c_str()); 
+	FileStatus fileStatus; 
+	if (!GetFileStatus(filename, fileStatus)) {
+		PrintError("File \"%s\" does not exist.", filename.c_str()); 
 		return false; 
-	} else if (CompareFileTime(&this->m_fileAttributes.ftLastWriteTime, &fileAttributes.ftLastWriteTime) >= 0) {
-		return true; 
 	}
-		
+	
 	Print("Applying patch file \"%s\"...", filename.c_str()); 
 	PrintStart(); 
 	
 	std::ifstream in(filename, std::ofstream::in); 
 	if (!in.is_open()) {
-		Print("Couldn't open file \"%s\".", filename.c_str()); 
+		PrintError("Couldn't open file \"%s\".", filename.c_str()); 
 		PrintAbort(); 
 		return false; 
 	}
+	return (IsTable(filename))? this->applyTable(in, filename, format) : this->apply(in, filename, format); 
+}
+
+bool WPDFile::patch (const std::string& name, std::string_view content, const std::string& format) {
+	Print("Applying patch \"%s\"...", name.c_str()); 
+	PrintStart(); 
 	
+	std::istringstream in{std::string(content)}; 
+	return (IsTable(name))? this->applyTable(in, name, format) : this->apply(in, name, format); 
+}
+
+bool WPDFile::apply (std::istream& in, const std::string& filename, const std::string& format) {
 	Format* fmt = Format::GetFormat(format); 
 	if (fmt == nullptr) {
-		Print("Couldn't load format \"%s\".", format.c_str()); 
+		PrintError("Couldn't load format \"%s\".", format.c_str()); 
 		PrintAbort(); 
 		return false; 
 	}
 	
 	this->m_modified = true; 
-	const Chunk& strings = this->getEntryData("!!string"); 
+	const Chunk& strings = this->m_entryList["!!string"]; 
 	std::regex regexEmpty("\\s*"); 
 	std::regex regexComment("//\\s*(.*)"); 
 	std::regex regexEntryName("@([^:]{1,15}):\\s*"); 
 	std::regex regexEntryData(">\\s*((?:.(?!\\s*=))*.)\\s*=\\s*((?:.(?=\\s*\\S))*.)"); 
 	std::regex regexDataTrue("(true)", std::regex::ECMAScript | std::regex::icase); 
 	std::regex regexDataFalse("(false)", std::regex::ECMAScript | std::regex::icase); 
-	std::regex regexDataHex("(0x[[:xdigit:]]+)"); 
-	std::regex regexDataUnsigned("([[:digit:]]+)%?"); 
-	std::regex regexDataSigned("(-?[[:digit:]]+)%?"); 
-	std::regex regexDataFloat("(-?[[:digit:]]+(?:\\.[[:digit:]]+)?)%?"); 
 	std::regex regexDataString("\"([^\"]*)\""); 
 	std::smatch match; 
 	
+	// Parsing the whole file before applying it, errors wait for their turn so they still come out in line order
+	enum LineType { Comment, EntryName, EntryData, Unexpected }; 
+	struct PatchLine {
+		LineType		type; 
+		std::string		name; 
+		std::string		value; 
+	}; 
+	std::vector<PatchLine> lines; 
+	{
+		Profile::Scope scope("patch.parse", filename); 
+		while (!in.eof()) {
+			std::string line; 
+			std::getline(in, line); 
+			Profile::Count(ProfileCounter::BytesRead, line.size() + 1); 
+			
+			PatchLine parsed; 
+			if (regex_match(line, match, regexComment)) {
+				parsed.type = Comment; 
+				parsed.value = match[1]; 
+			} else if (regex_match(line, match, regexEntryName)) {
+				parsed.type = EntryName; 
+				parsed.name = match[1]; 
+			} else if (regex_match(line, match, regexEntryData)) {
+				parsed.type = EntryData; 
+				parsed.name = match[1]; 
+				parsed.value = match[2]; 
+			} else if (!regex_match(line, regexEmpty)) {
+				parsed.type = Unexpected; 
+				parsed.value = line; 
+			} else {
+				continue; 
+			}
+			lines.push_back(std::move(parsed)); 
+		}
+	}
+	std::size_t parsedSize = 0; 
+	if (MemoryStats::IsEnabled()) {
+		parsedSize = lines.capacity() * sizeof(PatchLine); 
+		for (auto line = lines.begin() ; line != lines.end() ; line++) {
+			parsedSize += MemoryStats::GetHeapSize(line->name) + MemoryStats::GetHeapSize(line->value); 
+		}
+	}
+	MemoryStats::Block parsing(MemoryTag::PatchParsing, parsedSize); 
+	
+	Profile::Scope scope("patch.apply", filename); 
 	std::string dataName; 
-	std::string comment; 
 	Chunk* data = nullptr; 
-	while (!in.eof()) {
-		std::string line; 
-		std::getline(in, line); 
-		
-		if (regex_match(line, match, regexComment)) {
-			comment = match[1]; 
-			PrintVerbose("Comment: %s", comment.c_str()); 
+	for (auto line = lines.begin() ; line != lines.end() ; line++) {
+		if (line->type == Comment) {
+			PrintVerbose("Comment: %s", line->value.c_str()); 
 			continue; 
 			
-		} else if (regex_match(line, match, regexEntryName)) {
-			dataName = match[1]; 
+		} else if (line->type == EntryName) {
+			dataName = line->name; 
 			
 			PrintVerbose("Patching entry %s...", dataName.c_str()); 
-			data = &this->getEntryData(dataName); 
+			Profile::Count(ProfileCounter::EntriesTouched, 1); 
+			data = &this->m_entryList[dataName]; 
 			if (data->size() != fmt->getSize()) {
-				data->resize(fmt->getSize()); 
+				this->resizeEntry(dataName, *data, fmt->getSize()); 
 			}
 			
-		} else if (regex_match(line, match, regexEntryData)) {
+		} else if (line->type == EntryData) {
 			if (data == nullptr) {
-				Print("Missing entry name."); 
+				PrintError("Missing entry name."); 
 				continue; 
 			}
 			
-			std::string name = match[1]; 
-			std::string value = match[2]; 
+			const std::string& name = line->name; 
+			const std::string& value = line->value; 
 			
 			const Format::Attribute* attribute; 
+			Format::Attribute raw; 
 			try {
 				attribute = &fmt->getAttribute(name); 
 			} catch (const std::logic_error& e) {
-				Print("In entry %s:", dataName.c_str()); 
-				PrintStart(); 
-				Print(e.what()); 
-				PrintDone(); 
-				continue; 
+				if (!Format::GetRawAttribute(name, value, raw)) {
+					PrintError("In entry %s:", dataName.c_str()); 
+					PrintStart(); 
+					PrintError(e.what()); 
+					PrintDone(); 
+					continue; 
+				}
+				if (raw.offset + 4 > fmt->getSize()) {
+					PrintError("In entry %s, attribute %s:", dataName.c_str(), name.c_str()); 
+					PrintStart(); 
+					PrintError("Attribute is past the end of the entry."); 
+					PrintDone(); 
+					continue; 
+				}
+				attribute = &raw; 
 			}
 			
 			Enum* enumInfo = nullptr; 
@@ -178,6 +455,11 @@ bool WPDFile::patch (const std::string& filename, const std::string& format) {
 				enumInfo = Enum::GetEnum(attribute->enumName); 
 			}
 			
+			unsigned previous = (attribute->offset + 4 <= data->size())? data->getUnsigned(attribute->offset) : 0; 
+			unsigned u; 
+			int i; 
+			float f; 
+			std::errc error; 
 			switch (attribute->type) {
 				case AttributeType::Boolean:
 					if (regex_match(value, match, regexDataTrue)) {
@@ -187,6 +469,7 @@ bool WPDFile::patch (const std::string& filename, const std::string& format) {
 							Print("false -> true"); 
 							PrintDone(); 
 							data->setBoolean(attribute->offset, attribute->bit, true); 
+							Profile::Count(ProfileCounter::AttributesChanged, 1); 
 						}
 					} else if (regex_match(value, match, regexDataFalse)) {
 						if (data->getBoolean(attribute->offset, attribute->bit) != false) {
@@ -195,122 +478,147 @@ bool WPDFile::patch (const std::string& filename, const std::string& format) {
 							Print("true -> false"); 
 							PrintDone(); 
 							data->setBoolean(attribute->offset, attribute->bit, false); 
+							Profile::Count(ProfileCounter::AttributesChanged, 1); 
 						} 
 					} else {
-						Print("In entry %s, attribute %s:", dataName.c_str(), attribute->name.c_str()); 
+						PrintError("In entry %s, attribute %s:", dataName.c_str(), attribute->name.c_str()); 
 						PrintStart(); 
-						Print("Unexpected value for boolean attribute (%s).", value.c_str()); 
+						PrintError("Unexpected value for boolean attribute (%s).", value.c_str()); 
 						PrintDone(); 
 						continue; 
 					}
 					break; 
 				case AttributeType::Unsigned:
-					if (regex_match(value, match, regexDataUnsigned)) {
-						unsigned u = lexical_cast<unsigned>(match[1]); 
+					error = ParseUnsigned(value, u, attribute->size); 
+					if ((error == std::errc()) && (value.compare(0, 2, "0x") != 0)) {
 						if (data->getUnsignedMask(attribute->offset, attribute->bit, attribute->size) != u) {
 							Print("In entry %s, attribute %s:", dataName.c_str(), attribute->name.c_str()); 
 							PrintStart(); 
 							Print("%u -> %u", data->getUnsignedMask(attribute->offset, attribute->bit, attribute->size), u); 
 							PrintDone(); 
 							data->setUnsignedMask(attribute->offset, attribute->bit, attribute->size, u); 
+							Profile::Count(ProfileCounter::AttributesChanged, 1); 
 						}
-					} else if (regex_match(value, match, regexDataHex)) {
-						unsigned u = lexical_cast<unsigned>(match[1], std::hex); 
+					} else if (error == std::errc()) {
 						if (data->getUnsignedMask(attribute->offset, attribute->bit, attribute->size) != u) {
 							Print("In entry %s, attribute %s:", dataName.c_str(), attribute->name.c_str()); 
 							PrintStart(); 
 							Print("0x%0*X -> 0x%0*X", (attribute->size+3) / 4, data->getUnsignedMask(attribute->offset, attribute->bit, attribute->size), (attribute->size+3) / 4, u); 
 							PrintDone(); 
 							data->setUnsignedMask(attribute->offset, attribute->bit, attribute->size, u); 
+							Profile::Count(ProfileCounter::AttributesChanged, 1); 
 						}
-					} else if (enumInfo != nullptr) {
+					} else if ((error == std::errc::invalid_argument) && (enumInfo != nullptr)) {
 						try {
-							unsigned u = enumInfo->getUnsigned(value); 
+							u = enumInfo->getUnsigned(value); 
 							if (data->getUnsignedMask(attribute->offset, attribute->bit, attribute->size) != u) {
 								Print("In entry %s, attribute %s:", dataName.c_str(), attribute->name.c_str()); 
 								PrintStart(); 
 								Print("%u -> %u", data->getUnsignedMask(attribute->offset, attribute->bit, attribute->size), u); 
 								PrintDone(); 
 								data->setUnsignedMask(attribute->offset, attribute->bit, attribute->size, u); 
+								Profile::Count(ProfileCounter::AttributesChanged, 1); 
 							}
 						} catch (const std::logic_error& e) {
-							Print("In entry %s, attribute %s:", dataName.c_str(), attribute->name.c_str()); 
+							PrintError("In entry %s, attribute %s:", dataName.c_str(), attribute->name.c_str()); 
 							PrintStart(); 
-							Print(e.what()); 
+							PrintError(e.what()); 
 							PrintDone(); 
 						}
+					} else if (error == std::errc::result_out_of_range) {
+						PrintError("In entry %s, attribute %s:", dataName.c_str(), attribute->name.c_str()); 
+						PrintStart(); 
+						PrintError("Value out of range for %u-bit unsigned attribute (%s).", attribute->size, value.c_str()); 
+						PrintDone(); 
+						continue; 
 					} else {
-						Print("In entry %s, attribute %s:", dataName.c_str(), attribute->name.c_str()); 
+						PrintError("In entry %s, attribute %s:", dataName.c_str(), attribute->name.c_str()); 
 						PrintStart(); 
-						Print("Unexpected value for unsigned attribute (%s).", value.c_str()); 
+						PrintError("Unexpected value for unsigned attribute (%s).", value.c_str()); 
 						PrintDone(); 
 						continue; 
 					}
 					break; 
 				case AttributeType::Signed:
-					if (regex_match(value, match, regexDataSigned)) {
-						int i = lexical_cast<int>(match[1]); 
+					error = ParseSigned(value, i, attribute->size); 
+					if (error == std::errc()) {
 						if (data->getSignedMask(attribute->offset, attribute->bit, attribute->size) != i) {
 							Print("In entry %s, attribute %s:", dataName.c_str(), attribute->name.c_str()); 
 							PrintStart(); 
 							Print("%d -> %d", data->getSignedMask(attribute->offset, attribute->bit, attribute->size), i); 
 							PrintDone(); 
 							data->setSignedMask(attribute->offset, attribute->bit, attribute->size, i); 
+							Profile::Count(ProfileCounter::AttributesChanged, 1); 
 						}
-					} else if (enumInfo != nullptr) {
+					} else if ((error == std::errc::invalid_argument) && (enumInfo != nullptr)) {
 						try {
-							int i = enumInfo->getSigned(value); 
+							i = enumInfo->getSigned(value); 
 							if (data->getSignedMask(attribute->offset, attribute->bit, attribute->size) != i) {
 								Print("In entry %s, attribute %s:", dataName.c_str(), attribute->name.c_str()); 
 								PrintStart(); 
 								Print("%d -> %d", data->getSignedMask(attribute->offset, attribute->bit, attribute->size), i); 
 								PrintDone(); 
 								data->setSignedMask(attribute->offset, attribute->bit, attribute->size, i); 
+								Profile::Count(ProfileCounter::AttributesChanged, 1); 
 							}
 						} catch (const std::logic_error& e) {
-							Print("In entry %s, attribute %s:", dataName.c_str(), attribute->name.c_str()); 
+							PrintError("In entry %s, attribute %s:", dataName.c_str(), attribute->name.c_str()); 
 							PrintStart(); 
-							Print(e.what()); 
+							PrintError(e.what()); 
 							PrintDone(); 
 						}
+					} else if (error == std::errc::result_out_of_range) {
+						PrintError("In entry %s, attribute %s:", dataName.c_str(), attribute->name.c_str()); 
+						PrintStart(); 
+						PrintError("Value out of range for %u-bit signed attribute (%s).", attribute->size, value.c_str()); 
+						PrintDone(); 
+						continue; 
 					} else {
-						Print("In entry %s, attribute %s:", dataName.c_str(), attribute->name.c_str()); 
+						PrintError("In entry %s, attribute %s:", dataName.c_str(), attribute->name.c_str()); 
 						PrintStart(); 
-						Print("Unexpected value for signed attribute (%s).", value.c_str()); 
+						PrintError("Unexpected value for signed attribute (%s).", value.c_str()); 
 						PrintDone(); 
 						continue; 
 					}
 					break; 
 				case AttributeType::Float:
-					if (regex_match(value, match, regexDataFloat)) {
-						float f = lexical_cast<float>(match[1]); 
+					error = ParseFloat(value, f); 
+					if (error == std::errc()) {
 						if (data->getFloat(attribute->offset) != f) {
 							Print("In entry %s, attribute %s:", dataName.c_str(), attribute->name.c_str()); 
 							PrintStart(); 
 							Print("%.2f -> %.2f", data->getFloat(attribute->offset), f); 
 							PrintDone(); 
 							data->setFloat(attribute->offset, f); 
+							Profile::Count(ProfileCounter::AttributesChanged, 1); 
 						}
-					} else if (enumInfo != nullptr) {
+					} else if ((error == std::errc::invalid_argument) && (enumInfo != nullptr)) {
 						try {
-							float f = enumInfo->getFloat(value); 
+							f = enumInfo->getFloat(value); 
 							if (data->getFloat(attribute->offset) != f) {
 								Print("In entry %s, attribute %s:", dataName.c_str(), attribute->name.c_str()); 
 								PrintStart(); 
 								Print("%.2f -> %.2f", data->getFloat(attribute->offset), f); 
 								PrintDone(); 
 								data->setFloat(attribute->offset, f); 
+								Profile::Count(ProfileCounter::AttributesChanged, 1); 
 							}
 						} catch (const std::logic_error& e) {
-							Print("In entry %s, attribute %s:", dataName.c_str(), attribute->name.c_str()); 
+							PrintError("In entry %s, attribute %s:", dataName.c_str(), attribute->name.c_str()); 
 							PrintStart(); 
-							Print(e.what()); 
+							PrintError(e.what()); 
 							PrintDone(); 
 						}
+					} else if (error == std::errc::result_out_of_range) {
+						PrintError("In entry %s, attribute %s:", dataName.c_str(), attribute->name.c_str()); 
+						PrintStart(); 
+						PrintError("Value out of range for float attribute (%s).", value.c_str()); 
+						PrintDone(); 
+						continue; 
 					} else {
-						Print("In entry %s, attribute %s:", dataName.c_str(), attribute->name.c_str()); 
+						PrintError("In entry %s, attribute %s:", dataName.c_str(), attribute->name.c_str()); 
 						PrintStart(); 
-						Print("Unexpected value for float attribute (%s).", value.c_str()); 
+						PrintError("Unexpected value for float attribute (%s).", value.c_str()); 
 						PrintDone(); 
 						continue; 
 					}
@@ -324,33 +632,38 @@ bool WPDFile::patch (const std::string& filename, const std::string& format) {
 							Print("\"%s\" -> \"%s\"", strings.getString(data->getUnsigned(attribute->offset)).c_str(), s.c_str()); 
 							PrintDone(); 
 							data->setUnsigned(attribute->offset, this->getStringReference(s)); 
+							Profile::Count(ProfileCounter::AttributesChanged, 1); 
 						}
 					} else if (enumInfo != nullptr) {
 						try {
-							std::string s = enumInfo->getString(value); 
+							std::string s(enumInfo->getString(value)); 
 							if (strings.getString(data->getUnsigned(attribute->offset)) != s) {
 								Print("In entry %s, attribute %s:", dataName.c_str(), attribute->name.c_str()); 
 								PrintStart(); 
 								Print("\"%s\" -> \"%s\"", strings.getString(data->getUnsigned(attribute->offset)).c_str(), s.c_str()); 
 								PrintDone(); 
 								data->setUnsigned(attribute->offset, this->getStringReference(s)); 
+								Profile::Count(ProfileCounter::AttributesChanged, 1); 
 							}
 						} catch (const std::logic_error& e) {
-							Print("In entry %s, attribute %s:", dataName.c_str(), attribute->name.c_str()); 
+							PrintError("In entry %s, attribute %s:", dataName.c_str(), attribute->name.c_str()); 
 							PrintStart(); 
-							Print(e.what()); 
+							PrintError(e.what()); 
 							PrintDone(); 
 						}
 					} else {
-						Print("In entry %s, attribute %s:", dataName.c_str(), attribute->name.c_str()); 
+						PrintError("In entry %s, attribute %s:", dataName.c_str(), attribute->name.c_str()); 
 						PrintStart(); 
-						Print("Unexpected value for string attribute (%s).", value.c_str()); 
+						PrintError("Unexpected value for string attribute (%s).", value.c_str()); 
 						PrintDone(); 
 						continue; 
 					}
 			}
-		} else if (!regex_match(line, regexEmpty)) {
-			Print("Unexpected character in line \"%s\".", line.c_str()); 
+			if ((!this->m_indexes.empty()) && (data->getUnsigned(attribute->offset) != previous)) {
+				this->updateIndexes(dataName, attribute->offset, previous, data->getUnsigned(attribute->offset)); 
+			}
+		} else {
+			PrintError("Unexpected character in line \"%s\".", line->value.c_str()); 
 		}
 	}
 	
@@ -358,214 +671,1179 @@ bool WPDFile::patch (const std::string& filename, const std::string& format) {
 	return true; 
 }
 
-bool WPDFile::convert (const std::string& filename, const std::string& filter, bool showHidden) const {
-	Print("Building patch file \"%s\"...", filename.c_str()); 
-	PrintStart(); 
+// Splits the next record of a CSV text into its fields, unquoting them in place so the fields can point into the text. 
+// Quoted fields may hold separators, line breaks and doubled quotes. Lines may end with \r\n. 
+static bool ReadCsvRecord (std::string& text, std::size_t& position, std::vector<std::string_view>& fields, unsigned& line) {
+	fields.clear(); 
+	if (position >= text.size()) {
+		return false; 
+	}
+	while (true) {
+		std::size_t start = position, end = position; 
+		if (text[position] == '"') {
+			start = end = ++position; 
+			while (position < text.size()) {
+				if (text[position] == '"') {
+					if ((position + 1 < text.size()) && (text[position + 1] == '"')) {
+						text[end++] = '"'; 
+						position += 2; 
+						continue; 
+					}
+					position++; 
+					break; 
+				}
+				if (text[position] == '\n') {
+					line++; 
+				}
+				text[end++] = text[position++]; 
+			}
+			while ((position < text.size()) && (text[position] != ',') && (text[position] != '\n')) {
+				text[end++] = text[position++]; 
+			}
+		} else {
+			while ((position < text.size()) && (text[position] != ',') && (text[position] != '\n')) {
+				position++; 
+			}
+			end = position; 
+		}
+		if ((end > start) && (text[end - 1] == '\r') && ((position >= text.size()) || (text[position] == '\n'))) {
+			end--; 
+		}
+		fields.emplace_back(text.data() + start, end - start); 
+		
+		if (position >= text.size()) {
+			return true; 
+		} else if (text[position++] == '\n') {
+			line++; 
+			return true; 
+		}
+	}
+}
+
+static std::string_view TrimField (std::string_view field) {
+	std::size_t first = field.find_first_not_of(" \t"); 
+	if (first == std::string_view::npos) {
+		return std::string_view(); 
+	}
+	return field.substr(first, field.find_last_not_of(" \t") - first + 1); 
+}
+
+static bool EqualsIgnoringCase (std::string_view text, std::string_view word) {
+	if (text.size() != word.size()) {
+		return false; 
+	}
+	for (std::size_t i = 0 ; i < text.size() ; i++) {
+		if (tolower(static_cast<unsigned char>(text[i])) != word[i]) {
+			return false; 
+		}
+	}
+	return true; 
+}
+
+// A column of a table patch, resolved against the format once per file
+struct TableColumn {
+	Format::Attribute	attribute; 
+	Enum*				enumInfo; 
+	bool				skipped; 
+}; 
+
+// A cell of a table patch parsed to the bits it writes, or why it can't be written. 
+// Empty cells leave the attribute as it is. 
+enum class CellStatus : unsigned char {
+	Empty, 
+	Value, 
+	Hexadecimal, 
+	String, 
+	Unexpected, 
+	OutOfRange, 
+	NotInEnum
+}; 
+
+struct TableCell {
+	CellStatus			status; 
+	unsigned			value; 
+	std::string_view	text; 
+}; 
+
+static CellStatus ParseEnumCell (const Enum* enumInfo, AttributeType type, std::string_view text, unsigned& value) {
+	try {
+		std::string name(text); 
+		float f; 
+		switch (type) {
+			case AttributeType::Signed: 
+				value = static_cast<unsigned>(enumInfo->getSigned(name)); 
+				break; 
+			case AttributeType::Float: 
+				f = enumInfo->getFloat(name); 
+				std::memcpy(&value, &f, sizeof(value)); 
+				break; 
+			default: 
+				value = enumInfo->getUnsigned(name); 
+		}
+		return CellStatus::Value; 
+	} catch (const std::logic_error& e) {
+		return CellStatus::NotInEnum; 
+	}
+}
+
+// Only reads the column and the text, cells of different rows are parsed on different threads
+static void ParseCell (const TableColumn& column, std::string_view text, TableCell& cell) {
+	cell.value = 0; 
+	cell.text = text; 
+	const Format::Attribute& attribute = column.attribute; 
+	if (attribute.type != AttributeType::String) {
+		text = TrimField(text); 
+	}
+	if (text.empty()) {
+		cell.status = CellStatus::Empty; 
+		return; 
+	}
 	
-	// Opening patch file
-	CreateFolderForFile(filename); 
-	std::ofstream out(filename, std::ofstream::out | std::ofstream::trunc); 
-	if (!out.is_open()) {
-		Print("Couldn't open file \"%s\".", filename.c_str()); 
+	unsigned u; 
+	int i; 
+	float f; 
+	std::errc error; 
+	switch (attribute.type) {
+		case AttributeType::Boolean: 
+			if (EqualsIgnoringCase(text, "true")) {
+				cell.status = CellStatus::Value; 
+				cell.value = 1; 
+			} else if (EqualsIgnoringCase(text, "false")) {
+				cell.status = CellStatus::Value; 
+			} else {
+				cell.status = CellStatus::Unexpected; 
+			}
+			break; 
+		case AttributeType::Unsigned: 
+			error = ParseUnsigned(text, u, attribute.size); 
+			cell.value = u; 
+			if (error == std::errc()) {
+				cell.status = (text.compare(0, 2, "0x") == 0)? CellStatus::Hexadecimal : CellStatus::Value; 
+			} else if ((error == std::errc::invalid_argument) && (column.enumInfo != nullptr)) {
+				cell.status = ParseEnumCell(column.enumInfo, attribute.type, text, cell.value); 
+			} else {
+				cell.status = (error == std::errc::result_out_of_range)? CellStatus::OutOfRange : CellStatus::Unexpected; 
+			}
+			break; 
+		case AttributeType::Signed: 
+			error = ParseSigned(text, i, attribute.size); 
+			cell.value = static_cast<unsigned>(i); 
+			if (error == std::errc()) {
+				cell.status = CellStatus::Value; 
+			} else if ((error == std::errc::invalid_argument) && (column.enumInfo != nullptr)) {
+				cell.status = ParseEnumCell(column.enumInfo, attribute.type, text, cell.value); 
+			} else {
+				cell.status = (error == std::errc::result_out_of_range)? CellStatus::OutOfRange : CellStatus::Unexpected; 
+			}
+			break; 
+		case AttributeType::Float: 
+			error = ParseFloat(text, f); 
+			std::memcpy(&cell.value, &f, sizeof(cell.value)); 
+			if (error == std::errc()) {
+				cell.status = CellStatus::Value; 
+			} else if ((error == std::errc::invalid_argument) && (column.enumInfo != nullptr)) {
+				cell.status = ParseEnumCell(column.enumInfo, attribute.type, text, cell.value); 
+			} else {
+				cell.status = (error == std::errc::result_out_of_range)? CellStatus::OutOfRange : CellStatus::Unexpected; 
+			}
+			break; 
+		case AttributeType::String: 
+			// Strings are written as they are, enumeration names first like -Q exports them
+			cell.status = CellStatus::String; 
+			if (column.enumInfo != nullptr) {
+				try {
+					cell.text = column.enumInfo->getString(std::string(text)); 
+				} catch (const std::logic_error& e) {} 
+			}
+	}
+}
+
+static const char* const TypeNames[] = { "boolean", "unsigned", "signed", "float", "string" }; 
+
+static bool IsEntryName (std::string_view id) {
+	return (!id.empty()) && (id.size() <= 15) && (id[0] != '!'); 
+}
+
+// Writes a parsed cell to the entry the way patch writes the attribute, and prints what changed
+static bool WriteCell (const std::string& entry, Chunk& data, const Format::Attribute& attribute, const TableCell& cell, unsigned reference, const Chunk& strings) {
+	bool b; 
+	unsigned u; 
+	int i; 
+	float f, value; 
+	std::string_view s; 
+	switch (attribute.type) {
+		case AttributeType::Boolean: 
+			b = data.getBoolean(attribute.offset, attribute.bit); 
+			if (b == (cell.value != 0)) {
+				return false; 
+			}
+			Print("In entry %s, attribute %s:", entry.c_str(), attribute.name.c_str()); 
+			PrintStart(); 
+			Print((b == true)? "true -> false" : "false -> true"); 
+			data.setBoolean(attribute.offset, attribute.bit, !b); 
+			break; 
+		case AttributeType::Unsigned: 
+			u = data.getUnsignedMask(attribute.offset, attribute.bit, attribute.size); 
+			if (u == cell.value) {
+				return false; 
+			}
+			Print("In entry %s, attribute %s:", entry.c_str(), attribute.name.c_str()); 
+			PrintStart(); 
+			if (cell.status == CellStatus::Hexadecimal) {
+				Print("0x%0*X -> 0x%0*X", (attribute.size+3) / 4, u, (attribute.size+3) / 4, cell.value); 
+			} else {
+				Print("%u -> %u", u, cell.value); 
+			}
+			data.setUnsignedMask(attribute.offset, attribute.bit, attribute.size, cell.value); 
+			break; 
+		case AttributeType::Signed: 
+			i = data.getSignedMask(attribute.offset, attribute.bit, attribute.size); 
+			if (i == static_cast<int>(cell.value)) {
+				return false; 
+			}
+			Print("In entry %s, attribute %s:", entry.c_str(), attribute.name.c_str()); 
+			PrintStart(); 
+			Print("%d -> %d", i, static_cast<int>(cell.value)); 
+			data.setSignedMask(attribute.offset, attribute.bit, attribute.size, static_cast<int>(cell.value)); 
+			break; 
+		case AttributeType::Float: 
+			f = data.getFloat(attribute.offset); 
+			std::memcpy(&value, &cell.value, sizeof(value)); 
+			if (f == value) {
+				return false; 
+			}
+			Print("In entry %s, attribute %s:", entry.c_str(), attribute.name.c_str()); 
+			PrintStart(); 
+			Print("%.2f -> %.2f", f, value); 
+			data.setFloat(attribute.offset, value); 
+			break; 
+		case AttributeType::String: 
+			s = GetStringAt(strings, data.getUnsigned(attribute.offset)); 
+			if (s == cell.text) {
+				return false; 
+			}
+			Print("In entry %s, attribute %s:", entry.c_str(), attribute.name.c_str()); 
+			PrintStart(); 
+			Print("\"%.*s\" -> \"%.*s\"", static_cast<int>(s.size()), s.data(), static_cast<int>(cell.text.size()), cell.text.data()); 
+			data.setUnsigned(attribute.offset, reference); 
+	}
+	PrintDone(); 
+	Profile::Count(ProfileCounter::AttributesChanged, 1); 
+	return true; 
+}
+
+bool WPDFile::applyTable (std::istream& in, const std::string& filename, const std::string& format) {
+	Format* fmt = Format::GetFormat(format); 
+	if (fmt == nullptr) {
+		PrintError("Couldn't load format \"%s\".", format.c_str()); 
 		PrintAbort(); 
 		return false; 
 	}
 	
-	const Chunk& entryStrTypeList = this->getEntryData("!!strtypelist"); 
-	const Chunk& entryString = this->getEntryData("!!string"); 
+	// Rows point into the text, a row with the wrong number of fields keeps none and waits for its turn to be reported
+	struct TableRow {
+		unsigned		line; 
+		std::size_t		first; 
+		std::size_t		count; 
+	}; 
+	std::string text; 
+	std::vector<TableColumn> columns; 
+	std::vector<TableRow> rows; 
+	std::vector<std::string_view> fields; 
+	std::size_t idColumn = std::string::npos; 
+	{
+		Profile::Scope scope("patch.parse", filename); 
+		std::ostringstream buffer; 
+		buffer << in.rdbuf(); 
+		text = buffer.str(); 
+		Profile::Count(ProfileCounter::BytesRead, text.size()); 
+		
+		// Spreadsheets may start the file with a byte order mark
+		std::size_t position = (text.compare(0, 3, "\xEF\xBB\xBF") == 0)? 3 : 0; 
+		unsigned line = 1; 
+		std::vector<std::string_view> record; 
+		if (!ReadCsvRecord(text, position, record, line)) {
+			PrintError("Missing header row."); 
+			PrintAbort(); 
+			return false; 
+		}
+		
+		// Columns are resolved once for the whole file
+		for (std::size_t c = 0 ; c < record.size() ; c++) {
+			std::string name(TrimField(record[c])); 
+			TableColumn column; 
+			column.enumInfo = nullptr; 
+			column.skipped = true; 
+			if ((name == "@id") && (idColumn == std::string::npos)) {
+				idColumn = c; 
+			} else if (name != "") {
+				try {
+					column.attribute = fmt->getAttribute(name); 
+					column.skipped = false; 
+				} catch (const std::logic_error& e) {
+					if ((Format::GetRawAttribute(name, "", column.attribute)) && (column.attribute.offset + 4 <= fmt->getSize())) {
+						column.skipped = false; 
+					} else {
+						PrintError("In column %zu:", c + 1); 
+						PrintStart(); 
+						PrintError(e.what()); 
+						PrintDone(); 
+					}
+				}
+				if ((column.skipped == false) && (column.attribute.enumName != "")) {
+					column.enumInfo = Enum::GetEnum(column.attribute.enumName); 
+				}
+			}
+			columns.push_back(std::move(column)); 
+		}
+		if (idColumn == std::string::npos) {
+			PrintError("Missing @id column."); 
+			PrintAbort(); 
+			return false; 
+		}
+		
+		unsigned start = line; 
+		while (ReadCsvRecord(text, position, record, line)) {
+			if ((record.size() == 1) && (TrimField(record[0]).empty())) {
+				start = line; 
+				continue; 
+			}
+			TableRow row; 
+			row.line = start; 
+			row.first = std::string::npos; 
+			row.count = record.size(); 
+			if (record.size() == columns.size()) {
+				row.first = fields.size(); 
+				fields.insert(fields.end(), record.begin(), record.end()); 
+			}
+			rows.push_back(row); 
+			start = line; 
+		}
+	}
+	
+	// Values are parsed a block of rows per thread, nothing is written yet
+	std::vector<TableCell> cells(fields.size()); 
+	{
+		Profile::Scope scope("patch.values", filename); 
+		const std::size_t blockSize = 1024; 
+		ParallelFor((rows.size() + blockSize - 1) / blockSize, [&](std::size_t block) {
+			std::size_t end = std::min(rows.size(), (block + 1) * blockSize); 
+			for (std::size_t r = block * blockSize ; r < end ; r++) {
+				if (rows[r].first == std::string::npos) {
+					continue; 
+				}
+				for (std::size_t c = 0 ; c < columns.size() ; c++) {
+					TableCell& cell = cells[rows[r].first + c]; 
+					if (columns[c].skipped == true) {
+						cell.status = CellStatus::Empty; 
+					} else {
+						ParseCell(columns[c], fields[rows[r].first + c], cell); 
+					}
+				}
+			}
+		}); 
+	}
+	MemoryStats::Block parsing(MemoryTag::PatchParsing, text.capacity() + fields.capacity() * sizeof(std::string_view) + cells.capacity() * sizeof(TableCell) + rows.capacity() * sizeof(TableRow)); 
+	
+	Profile::Scope scope("patch.apply", filename); 
+	this->m_modified = true; 
 	
-	// Converting entries
-	unsigned count = 0; 
-	for (auto it = this->m_entryList.begin() ; it != this->m_entryList.end() ; it++) {
-		if ((it->first[0] == '!') || (strmatch(filter, it->first) == false)) {
+	// New strings go to the pool together, a cell's value becomes the index of its string
+	std::vector<std::string_view> texts; 
+	for (auto row = rows.begin() ; row != rows.end() ; row++) {
+		if ((row->first == std::string::npos) || (!IsEntryName(TrimField(fields[row->first + idColumn])))) {
+			continue; 
+		}
+		for (std::size_t c = 0 ; c < columns.size() ; c++) {
+			TableCell& cell = cells[row->first + c]; 
+			if (cell.status == CellStatus::String) {
+				cell.value = texts.size(); 
+				texts.push_back(cell.text); 
+			}
+		}
+	}
+	std::vector<unsigned> references; 
+	if (!texts.empty()) {
+		this->appendStrings(texts, references); 
+	}
+	const Chunk& strings = this->m_entryList["!!string"]; 
+	
+	unsigned applied = 0; 
+	for (auto row = rows.begin() ; row != rows.end() ; row++) {
+		if (row->first == std::string::npos) {
+			PrintError("Line %u has %zu fields, the header has %zu.", row->line, row->count, columns.size()); 
+			continue; 
+		}
+		std::string id(TrimField(fields[row->first + idColumn])); 
+		if (!IsEntryName(id)) {
+			PrintError("Invalid entry name (\"%s\") on line %u.", id.c_str(), row->line); 
 			continue; 
 		}
 		
-		// Writing entry header
-		count++; 
-		out << std::endl; 
-		out << strfmt("@%s:", it->first.c_str()) << std::endl; 
-		PrintVerbose("Converting entry %s...", it->first.c_str()); 
+		PrintVerbose("Patching entry %s...", id.c_str()); 
+		Profile::Count(ProfileCounter::EntriesTouched, 1); 
+		applied++; 
+		Chunk& data = this->m_entryList[id]; 
+		if (data.size() != fmt->getSize()) {
+			this->resizeEntry(id, data, fmt->getSize()); 
+		}
 		
-		// Converting attributes
-		for (unsigned offset = 0 ; offset < entryStrTypeList.size() ; offset += 4) {
-			std::string name = strfmt("[0x%04X|%02d|%02d]", offset, 0, 32); 
-			out << strfmt("> %-30s = ", name.c_str()); 
-			switch (entryStrTypeList.getUnsigned(offset)) {
-				case 1:
-					out << strfmt("%.2f", it->second.getFloat(offset)); 
-					break; 
-				case 2:
-					out << strfmt("\"%s\"", entryString.getString(it->second.getUnsigned(offset)).c_str()); 
+		for (std::size_t c = 0 ; c < columns.size() ; c++) {
+			const TableCell& cell = cells[row->first + c]; 
+			const Format::Attribute& attribute = columns[c].attribute; 
+			std::string_view value = TrimField(cell.text); 
+			switch (cell.status) {
+				case CellStatus::Empty: 
+					continue; 
+				case CellStatus::Unexpected: 
+					PrintError("In entry %s, attribute %s:", id.c_str(), attribute.name.c_str()); 
+					PrintStart(); 
+					PrintError("Unexpected value for %s attribute (%.*s).", TypeNames[static_cast<int>(attribute.type)], static_cast<int>(value.size()), value.data()); 
+					PrintDone(); 
+					continue; 
+				case CellStatus::OutOfRange: 
+					PrintError("In entry %s, attribute %s:", id.c_str(), attribute.name.c_str()); 
+					PrintStart(); 
+					if (attribute.type == AttributeType::Float) {
+						PrintError("Value out of range for float attribute (%.*s).", static_cast<int>(value.size()), value.data()); 
+					} else {
+						PrintError("Value out of range for %u-bit %s attribute (%.*s).", attribute.size, TypeNames[static_cast<int>(attribute.type)], static_cast<int>(value.size()), value.data()); 
+					}
+					PrintDone(); 
+					continue; 
+				case CellStatus::NotInEnum: 
+					PrintError("In entry %s, attribute %s:", id.c_str(), attribute.name.c_str()); 
+					PrintStart(); 
+					PrintError("Key \"%.*s\" is not defined in enumeration %s.", static_cast<int>(value.size()), value.data(), attribute.enumName.c_str()); 
+					PrintDone(); 
+					continue; 
+				default: 
 					break; 
-				default:
-					out << strfmt("0x%08X", it->second.getUnsigned(offset)); 
 			}
-			out << std::endl; 
+			
+			unsigned previous = data.getUnsigned(attribute.offset); 
+			unsigned reference = (cell.status == CellStatus::String)? references[cell.value] : 0; 
+			if ((WriteCell(id, data, attribute, cell, reference, strings)) && (!this->m_indexes.empty()) && (data.getUnsigned(attribute.offset) != previous)) {
+				this->updateIndexes(id, attribute.offset, previous, data.getUnsigned(attribute.offset)); 
+			}
 		}
 	}
 	
-	Print("%u entries converted.", count); 
+	Print("%u rows applied.", applied); 
 	PrintDone(); 
 	return true; 
 }
 
-bool WPDFile::convert (const std::string& filename, const std::string& format, const std::string& filter, bool showHidden) const {
-	Print("Building patch file \"%s\"...", filename.c_str()); 
-	PrintStart(); 
-	
-	// Opening patch file
-	CreateFolderForFile(filename); 
-	std::ofstream out(filename, std::ofstream::out | std::ofstream::trunc); 
-	if (!out.is_open()) {
-		Print("Couldn't open file \"%s\".", filename.c_str()); 
-		PrintAbort(); 
-		return false; 
+// How a format-less patch file writes a word of the entries, compiled once per file from !!strtypelist
+struct RawColumn {
+	unsigned		offset; 
+	AttributeType	type; 
+	std::string		prefix; 
+}; 
+
+// Every word is a float (1), a !!string offset (2) or else written in hexadecimal
+static std::vector<RawColumn> CompileRawColumns (const Chunk& entryStrTypeList) {
+	std::vector<RawColumn> columns(entryStrTypeList.size() / 4); 
+	for (unsigned offset = 0 ; offset < entryStrTypeList.size() ; offset += 4) {
+		RawColumn& column = columns[offset / 4]; 
+		column.offset = offset; 
+		switch (entryStrTypeList.getUnsigned(offset)) {
+			case 1: 
+				column.type = AttributeType::Float; 
+				break; 
+			case 2: 
+				column.type = AttributeType::String; 
+				break; 
+			default: 
+				column.type = AttributeType::Unsigned; 
+		}
+		
+		char field[32], prefix[64]; 
+		snprintf(field, sizeof(field), "[0x%04X|%02d|%02d]", offset, 0, 32); 
+		snprintf(prefix, sizeof(prefix), "> %-30s = ", field); 
+		column.prefix = prefix; 
+	}
+	return columns; 
+}
+
+static void WriteHexadecimal (std::ostream& out, unsigned value) {
+	static const char digits[] = "0123456789ABCDEF"; 
+	char buffer[10] = { '0', 'x' }; 
+	for (int i = 9 ; i >= 2 ; i--, value >>= 4) {
+		buffer[i] = digits[value & 0xF]; 
 	}
+	out.write(buffer, sizeof(buffer)); 
+}
+
+// Writes one entry of a patch file, every word of it
+static void ConvertRawEntry (std::ostream& out, const std::string& name, const Chunk& data, const std::vector<RawColumn>& columns, const Chunk& entryString) {
+	// Writing entry header
+	out << std::endl; 
+	out << '@' << name << ':' << std::endl; 
+	PrintVerbose("Converting entry %s...", name.c_str()); 
 	
-	const Chunk& entryString = this->getEntryData("!!string"); 
-	Format* fmt = Format::GetFormat(format); 
-	if (fmt == nullptr) {
-		Print("Couldn't load format %s.", format.c_str()); 
-		PrintAbort(); 
-		return false; 
+	// Converting attributes
+	for (auto column = columns.begin() ; column != columns.end() ; column++) {
+		out << column->prefix; 
+		switch (column->type) {
+			case AttributeType::Float: 
+				WriteFormatted(out, "%.2f", data.getFloat(column->offset)); 
+				break; 
+			case AttributeType::String: 
+				out << '"' << entryString.getStringView(data.getUnsigned(column->offset)) << '"'; 
+				break; 
+			default: 
+				WriteHexadecimal(out, data.getUnsigned(column->offset)); 
+		}
+		out << std::endl; 
 	}
+}
+
+// Writes one entry of a patch file, its attributes in format order
+static void ConvertEntry (std::ostream& out, const std::string& name, const Chunk& data, const Format::Attributes& attributes, const std::vector<Enum*>& enums, const Chunk& entryString, bool showHidden) {
+	// Writing entry header
+	out << std::endl; 
+	out << '@' << name << ':' << std::endl; 
+	PrintVerbose("Converting entry %s...", name.c_str()); 
 	
-	// Converting entries
-	unsigned count = 0; 
-	for (auto it = this->m_entryList.begin() ; it != this->m_entryList.end() ; it++) {
-		if ((it->first[0] == '!') || (strmatch(filter, it->first) == false)) {
+	// Converting attributes
+	unsigned index = 0; 
+	AttributeValue value; 
+	for (auto attribute = attributes.begin() ; attribute != attributes.end() ; attribute++, index++) {
+		if ((attribute->hidden == true) && (showHidden == false)) {
 			continue; 
 		}
 		
+		WriteFormatted(out, "> %-30s = ", attribute->name.c_str()); 
+		Enum* enumInfo = enums[index]; 
 		
-		// Writing entry header
-		count++; 
-		out << std::endl; 
-		out << strfmt("@%s:", it->first.c_str()) << std::endl; 
-		PrintVerbose("Converting entry %s...", it->first.c_str()); 
-		
-		// Converting attributes
-		const Format::Attributes& attributes = fmt->getAttributes(); 
-		for (auto attribute = attributes.begin() ; attribute != attributes.end() ; attribute++) {
-			if ((attribute->hidden == true) && (showHidden == false)) {
-				continue; 
-			}
-			
-			out << strfmt("> %-30s = ", attribute->name.c_str()); 
-	
-			Enum* enumInfo = nullptr; 
-			if (attribute->enumName != "") {
-				enumInfo = Enum::GetEnum(attribute->enumName); 
-			}
-			
-			std::string str; 
-			AttributeValue value; 
-			switch (attribute->type) {
-				case AttributeType::Boolean: 
-					value.setBoolean(it->second.getBoolean(attribute->offset, attribute->bit)); 
-					out << ((value.getBoolean() == true)? "true" : "false"); 
-					break; 
-				case AttributeType::Unsigned: 
-					value.setUnsigned(it->second.getUnsignedMask(attribute->offset, attribute->bit, attribute->size)); 
-					if (enumInfo != nullptr) {
-						try {
-							out << enumInfo->getName(value.getUnsigned()); 
-							break; 
-						} catch (const std::logic_error& e) {
-							if (enumInfo->getStrict() == true) {
-								Print("In entry %s, attribute %s:", it->first.c_str(), attribute->name.c_str()); 
-								PrintStart(); 
-								Print(e.what()); 
-								PrintDone(); 
-							}
+		switch (attribute->type) {
+			case AttributeType::Boolean: 
+				value.setBoolean(data.getBoolean(attribute->offset, attribute->bit)); 
+				out << ((value.getBoolean() == true)? "true" : "false"); 
+				break; 
+			case AttributeType::Unsigned: 
+				value.setUnsigned(data.getUnsignedMask(attribute->offset, attribute->bit, attribute->size)); 
+				if (enumInfo != nullptr) {
+					try {
+						out << enumInfo->getName(value.getUnsigned()); 
+						break; 
+					} catch (const std::logic_error& e) {
+						if (enumInfo->getStrict() == true) {
+							PrintError("In entry %s, attribute %s:", name.c_str(), attribute->name.c_str()); 
+							PrintStart(); 
+							PrintError(e.what()); 
+							PrintDone(); 
 						}
 					}
-					switch (attribute->format) {
-						case AttributeFormat::Hexadecimal: 
-							out << strfmt("0x%0*X", (attribute->size+3)/4, value.getUnsigned());
-							break; 
-						case AttributeFormat::Percentage: 
-							out << strfmt("%u%%", value.getUnsigned());
-							break; 
-						default: 
-							out << value.getUnsigned();
-					}
-					break; 
-				case AttributeType::Signed: 
-					value.setSigned(it->second.getSignedMask(attribute->offset, attribute->bit, attribute->size)); 
-					if (enumInfo != nullptr) {
-						try {
-							out << enumInfo->getName(value.getSigned()); 
-							break; 
-						} catch (const std::logic_error& e) {
-							if (enumInfo->getStrict() == true) {
-								Print("In entry %s, attribute %s:", it->first.c_str(), attribute->name.c_str()); 
-								PrintStart(); 
-								Print(e.what()); 
-								PrintDone(); 
-							}
+				}
+				switch (attribute->format) {
+					case AttributeFormat::Hexadecimal: 
+						WriteFormatted(out, "0x%0*X", (attribute->size+3)/4, value.getUnsigned()); 
+						break; 
+					case AttributeFormat::Percentage: 
+						WriteFormatted(out, "%u%%", value.getUnsigned()); 
+						break; 
+					default: 
+						WriteNumber(out, value.getUnsigned()); 
+				}
+				break; 
+			case AttributeType::Signed: 
+				value.setSigned(data.getSignedMask(attribute->offset, attribute->bit, attribute->size)); 
+				if (enumInfo != nullptr) {
+					try {
+						out << enumInfo->getName(value.getSigned()); 
+						break; 
+					} catch (const std::logic_error& e) {
+						if (enumInfo->getStrict() == true) {
+							PrintError("In entry %s, attribute %s:", name.c_str(), attribute->name.c_str()); 
+							PrintStart(); 
+							PrintError(e.what()); 
+							PrintDone(); 
 						}
 					}
-					switch (attribute->format) {
-						case AttributeFormat::Percentage: 
-							out << strfmt("%d%%", value.getSigned());
-							break; 
-						default: 
-							out << value.getSigned();
-					}
-					break; 
-				case AttributeType::Float: 
-					value.setFloat(it->second.getFloat(attribute->offset)); 
-					if (enumInfo != nullptr) {
-						try {
-							out << enumInfo->getName(value.getFloat()); 
-							break; 
-						} catch (const std::logic_error& e) {
-							if (enumInfo->getStrict() == true) {
-								Print("In entry %s, attribute %s:", it->first.c_str(), attribute->name.c_str()); 
-								PrintStart(); 
-								Print(e.what()); 
-								PrintDone(); 
-							}
+				}
+				switch (attribute->format) {
+					case AttributeFormat::Percentage: 
+						WriteFormatted(out, "%d%%", value.getSigned()); 
+						break; 
+					default: 
+						WriteNumber(out, value.getSigned()); 
+				}
+				break; 
+			case AttributeType::Float: 
+				value.setFloat(data.getFloat(attribute->offset)); 
+				if (enumInfo != nullptr) {
+					try {
+						out << enumInfo->getName(value.getFloat()); 
+						break; 
+					} catch (const std::logic_error& e) {
+						if (enumInfo->getStrict() == true) {
+							PrintError("In entry %s, attribute %s:", name.c_str(), attribute->name.c_str()); 
+							PrintStart(); 
+							PrintError(e.what()); 
+							PrintDone(); 
 						}
 					}
-					switch (attribute->format) {
-						case AttributeFormat::Percentage: 
-							out << strfmt("%.2f%%", value.getFloat());
-							break; 
-						default: 
-							out << strfmt("%.2f", value.getFloat());
-					}
-					break; 
-				case AttributeType::String: 
-					value.setString(entryString.getString(it->second.getUnsigned(attribute->offset))); 
-					if (enumInfo != nullptr) {
-						try {
-							out << enumInfo->getName(value.getString()); 
-							break; 
-						} catch (const std::logic_error& e) {
-							if (enumInfo->getStrict() == true) {
-								Print("In entry %s, attribute %s:", it->first.c_str(), attribute->name.c_str()); 
-								PrintStart(); 
-								Print(e.what()); 
-								PrintDone(); 
-							}
+				}
+				switch (attribute->format) {
+					case AttributeFormat::Percentage: 
+						WriteFormatted(out, "%.2f%%", value.getFloat()); 
+						break; 
+					default: 
+						WriteFormatted(out, "%.2f", value.getFloat()); 
+				}
+				break; 
+			case AttributeType::String: 
+				value.setString(entryString.getStringView(data.getUnsigned(attribute->offset))); 
+				if (enumInfo != nullptr) {
+					try {
+						out << enumInfo->getName(value.getString()); 
+						break; 
+					} catch (const std::logic_error& e) {
+						if (enumInfo->getStrict() == true) {
+							PrintError("In entry %s, attribute %s:", name.c_str(), attribute->name.c_str()); 
+							PrintStart(); 
+							PrintError(e.what()); 
+							PrintDone(); 
 						}
 					}
-					out << strfmt("\"%s\"", value.getString().c_str());
+				}
+				out << '"' << value.getString() << '"'; 
+		}
+		out << std::endl; 
+	}
+}
+
+bool WPDFile::convert (const std::string& filename, const std::string& filter, bool showHidden) const {
+	return this->convert(filename, "", filter, showHidden); 
+}
+
+bool WPDFile::convert (const std::string& filename, const std::string& format, const std::string& filter, bool showHidden) const {
+	Profile::Scope scope("convert", filename); 
+	Print("Building patch file \"%s\"...", filename.c_str()); 
+	PrintStart(); 
+	
+	// Building patch file in memory
+	std::ostringstream out; 
+	if (!this->convert(out, format, filter, showHidden)) {
+		PrintAbort(); 
+		return false; 
+	}
+	
+	// Writing patch file (only if its content changed), from a copy of the stream's buffer
+	MemoryStats::Block output(MemoryTag::ConvertOutput, 2 * static_cast<std::size_t>(out.tellp())); 
+	bool written; 
+	if (!UpdateFile(filename, out.str(), written, true)) {
+		PrintError("Couldn't open file \"%s\".", filename.c_str()); 
+		PrintAbort(); 
+		return false; 
+	}
+	
+	if (written == false) {
+		Print("Patch file is up to date."); 
+	}
+	PrintDone(); 
+	return true; 
+}
+
+bool WPDFile::convert (std::ostream& out, const std::string& format, const std::string& filter, bool showHidden) const {
+	auto entryString = this->m_entryList.find("!!string"); 
+	auto entryStrTypeList = this->m_entryList.find("!!strtypelist"); 
+	if ((entryString == this->m_entryList.end()) || ((format == "") && (entryStrTypeList == this->m_entryList.end()))) {
+		PrintError("Missing entry %s.", (entryString == this->m_entryList.end())? "!!string" : "!!strtypelist"); 
+		return false; 
+	}
+	
+	Format* fmt = nullptr; 
+	std::vector<Enum*> enums; 
+	std::vector<RawColumn> columns; 
+	if (format == "") {
+		columns = CompileRawColumns(entryStrTypeList->second); 
+	} else {
+		fmt = Format::GetFormat(format); 
+		if (fmt == nullptr) {
+			PrintError("Couldn't load format %s.", format.c_str()); 
+			return false; 
+		}
+		
+		// Resolving enumerations once for all entries
+		const Format::Attributes& attributes = fmt->getAttributes(); 
+		for (auto attribute = attributes.begin() ; attribute != attributes.end() ; attribute++) {
+			enums.push_back((attribute->enumName != "")? Enum::GetEnum(attribute->enumName) : nullptr); 
+		}
+	}
+	
+	// Converting entries
+	unsigned count = 0; 
+	for (auto it = this->m_entryList.begin() ; it != this->m_entryList.end() ; it++) {
+		if ((it->first[0] == '!') || (strmatch(filter, it->first) == false)) {
+			continue; 
+		}
+		
+		count++; 
+		if (fmt == nullptr) {
+			ConvertRawEntry(out, it->first, it->second, columns, entryString->second); 
+		} else {
+			ConvertEntry(out, it->first, it->second, fmt->getAttributes(), enums, entryString->second, showHidden); 
+		}
+	}
+	
+	Print("%u entries converted.", count); 
+	Profile::Count(ProfileCounter::EntriesTouched, count); 
+	return true; 
+}
+
+bool WPDFile::ConvertStream(std::string_view data, const std::string& filename, const std::string& format, const std::string& filter, bool showHidden) {
+	Profile::Scope scope("convert", filename); 
+	Print("Streaming patch file \"%s\"...", filename.c_str()); 
+	PrintStart(); 
+	
+	std::vector<EntryRecord> entries; 
+	if (!ReadEntryList(data, entries)) {
+		// Its error already aborted the step
+		return false; 
+	}
+	
+	// Same order as a loaded file's entry list, the last entry of a name replacing the others
+	std::stable_sort(entries.begin(), entries.end(), [](const EntryRecord& a, const EntryRecord& b) {
+		return a.name < b.name; 
+	}); 
+	std::vector<EntryRecord>::iterator last = entries.begin(); 
+	for (auto it = entries.begin() ; it != entries.end() ; it++) {
+		if ((last != entries.begin()) && ((last - 1)->name == it->name)) {
+			*(last - 1) = std::move(*it); 
+		} else {
+			if (last != it) {
+				*last = std::move(*it); 
 			}
-			out << std::endl; 
+			last++; 
 		}
 	}
+	entries.erase(last, entries.end()); 
+	
+	// Only the shared entries are kept for the whole conversion
+	Chunk entryString, entryStrTypeList; 
+	bool hasString = false, hasStrTypeList = false; 
+	entryString.setTag(MemoryTag::Strings); 
+	for (auto it = entries.begin() ; it != entries.end() ; it++) {
+		if (it->name == "!!string") {
+			ReadEntry(data, *it, entryString); 
+			hasString = true; 
+		} else if (it->name == "!!strtypelist") {
+			ReadEntry(data, *it, entryStrTypeList); 
+			hasStrTypeList = true; 
+		}
+	}
+	if ((hasString == false) || ((format == "") && (hasStrTypeList == false))) {
+		PrintError("Missing entry %s.", (hasString == false)? "!!string" : "!!strtypelist"); 
+		PrintAbort(); 
+		return false; 
+	}
+	
+	Format* fmt = nullptr; 
+	std::vector<Enum*> enums; 
+	std::vector<RawColumn> columns; 
+	if (format == "") {
+		columns = CompileRawColumns(entryStrTypeList); 
+	} else {
+		fmt = Format::GetFormat(format); 
+		if (fmt == nullptr) {
+			PrintError("Couldn't load format %s.", format.c_str()); 
+			PrintAbort(); 
+			return false; 
+		}
+		const Format::Attributes& attributes = fmt->getAttributes(); 
+		for (auto attribute = attributes.begin() ; attribute != attributes.end() ; attribute++) {
+			enums.push_back((attribute->enumName != "")? Enum::GetEnum(attribute->enumName) : nullptr); 
+		}
+	}
+	
+	// Writing the patch file next to its final name, one entry in memory at a time
+	std::string temporary = filename + ".tmp"; 
+	CreateFolderForFile(filename); 
+	std::ofstream out(temporary, std::ofstream::out | std::ofstream::trunc); 
+	if (!out.is_open()) {
+		PrintError("Couldn't open file \"%s\".", temporary.c_str()); 
+		PrintAbort(); 
+		return false; 
+	}
+	
+	unsigned count = 0; 
+	Chunk chunk; 
+	for (auto it = entries.begin() ; it != entries.end() ; it++) {
+		if ((it->name[0] == '!') || (strmatch(filter, it->name) == false)) {
+			continue; 
+		}
+		
+		count++; 
+		ReadEntry(data, *it, chunk); 
+		if (fmt == nullptr) {
+			ConvertRawEntry(out, it->name, chunk, columns, entryString); 
+		} else {
+			ConvertEntry(out, it->name, chunk, fmt->getAttributes(), enums, entryString, showHidden); 
+		}
+	}
+	out.close(); 
+	
+	// Replacing the patch file (only if its content changed), the temporary file never outlives a failure
+	bool written; 
+	if ((out.fail()) || (!ReplaceFile(filename, temporary, written))) {
+		std::error_code error; 
+		std::filesystem::remove(temporary, error); 
+		PrintError("Couldn't write file \"%s\".", filename.c_str()); 
+		PrintAbort(); 
+		return false; 
+	}
 	
 	Print("%u entries converted.", count); 
+	Profile::Count(ProfileCounter::EntriesTouched, count); 
+	if (written == false) {
+		Print("Patch file is up to date."); 
+	}
+	PrintDone(); 
+	return true; 
+}
+
+bool WPDFile::saveFormat (const std::string& filename) const {
+	Print("Building format file \"%s\"...", filename.c_str()); 
+	PrintStart(); 
+	
+	auto strTypeList = this->m_entryList.find("!!strtypelist"); 
+	if (strTypeList == this->m_entryList.end()) {
+		PrintError("Missing entry %s.", "!!strtypelist"); 
+		PrintAbort(); 
+		return false; 
+	}
+	
+	// One attribute per word, named after its offset
+	std::vector<RawColumn> columns = CompileRawColumns(strTypeList->second); 
+	std::string content = strfmt("<?xml version=\"1.0\"?>\n<struct size=\"%u\">\n", strTypeList->second.size()); 
+	for (auto column = columns.begin() ; column != columns.end() ; column++) {
+		switch (column->type) {
+			case AttributeType::Float: 
+				content += strfmt("\t<data name=\"field_%04X\" type=\"Float\" offset=\"%X\"/>\n", column->offset, column->offset); 
+				break; 
+			case AttributeType::String: 
+				content += strfmt("\t<data name=\"field_%04X\" type=\"String\" offset=\"%X\"/>\n", column->offset, column->offset); 
+				break; 
+			default: 
+				content += strfmt("\t<data name=\"field_%04X\" type=\"Unsigned\" offset=\"%X\" format=\"hexa\"/>\n", column->offset, column->offset); 
+		}
+	}
+	content += "</struct>\n"; 
+	
+	bool written; 
+	if (!UpdateFile(filename, content, written, true)) {
+		PrintError("Couldn't open file \"%s\".", filename.c_str()); 
+		PrintAbort(); 
+		return false; 
+	}
+	
+	Print("%u attributes written.", static_cast<unsigned>(columns.size())); 
 	PrintDone(); 
 	return true; 
 }
 
+bool WPDFile::diff (const WPDFile& original, const std::string& filename) const {
+	return this->writeDiff(original, filename, nullptr); 
+}
+
+bool WPDFile::diff (const WPDFile& original, const std::string& filename, const std::string& format) const {
+	Format* fmt = Format::GetFormat(format); 
+	if (fmt == nullptr) {
+		PrintError("Couldn't load format %s.", format.c_str()); 
+		return false; 
+	}
+	return this->writeDiff(original, filename, fmt); 
+}
+
+bool WPDFile::writeDiff (const WPDFile& original, const std::string& filename, const Format* fmt) const {
+	Profile::Scope scope("diff", filename); 
+	Print("Building patch file \"%s\"...", filename.c_str()); 
+	PrintStart(); 
+	
+	// Building patch file in memory
+	std::ostringstream out; 
+	std::ostringstream lines; 
+	
+	static const Chunk empty; 
+	auto find = [](const WPDFileEntryList& entryList, const std::string& id) -> const Chunk& {
+		auto it = entryList.find(id); 
+		return (it != entryList.end())? it->second : empty; 
+	}; 
+	const Chunk& strings = find(this->m_entryList, "!!string"); 
+	const Chunk& originalStrings = find(original.m_entryList, "!!string"); 
+	const Chunk& strTypeList = find(this->m_entryList, "!!strtypelist"); 
+	
+	// String references can only be compared as numbers when both files have the same string table
+	bool sameStrings = (strings.size() == originalStrings.size()) && (memcmp(strings.data(), originalStrings.data(), strings.size()) == 0); 
+	
+	// Resolving enumerations once for all entries, and which bits of each word the format describes
+	std::vector<const Format::Attribute*> attributes; 
+	std::vector<Enum*> enums; 
+	std::vector<unsigned> described; 
+	if (fmt != nullptr) {
+		for (auto attribute = fmt->getAttributes().begin() ; attribute != fmt->getAttributes().end() ; attribute++) {
+			attributes.push_back(&(*attribute)); 
+			enums.push_back((attribute->enumName != "")? Enum::GetEnum(attribute->enumName) : nullptr); 
+			
+			unsigned word = attribute->offset / 4; 
+			if (described.size() < word + 2) {
+				described.resize(word + 2, 0); 
+			}
+			if (attribute->offset % 4 != 0) {
+				described[word] = ~0u; 
+				described[word + 1] = ~0u; 
+			} else if (attribute->type == AttributeType::Boolean) {
+				described[word] |= 1u << attribute->bit; 
+			} else if (((attribute->type == AttributeType::Unsigned) || (attribute->type == AttributeType::Signed)) && (attribute->size < 32)) {
+				described[word] |= ((1u << attribute->size) - 1) << attribute->bit; 
+			} else {
+				described[word] = ~0u; 
+			}
+		}
+	}
+	
+	// Both entry lists are sorted by name, walking them side by side
+	unsigned changed = 0, added = 0, removed = 0; 
+	std::vector<unsigned> changes; 
+	Chunk padded; 
+	auto previous = original.m_entryList.begin(); 
+	for (auto it = this->m_entryList.begin() ; it != this->m_entryList.end() ; it++) {
+		while ((previous != original.m_entryList.end()) && (previous->first < it->first)) {
+			if (previous->first[0] != '!') {
+				out << std::endl; 
+				out << "// Entry " << previous->first << " was removed, patch files can't remove entries" << std::endl; 
+				removed++; 
+			}
+			previous++; 
+		}
+		const Chunk* before = nullptr; 
+		if ((previous != original.m_entryList.end()) && (previous->first == it->first)) {
+			before = &previous->second; 
+			previous++; 
+		}
+		
+		const Chunk& after = it->second; 
+		if (it->first[0] == '!') {
+			continue; 
+		} else if ((before != nullptr) && (sameStrings == true) && (before->size() == after.size()) && (memcmp(before->data(), after.data(), after.size()) == 0)) {
+			continue; 
+		}
+		
+		// Missing bytes count as zeroes, a new entry starts out as zeroes too
+		if ((before != nullptr) && (before->size() != after.size())) {
+			padded = Chunk(after.size()); 
+			memcpy(padded.data(), before->data(), std::min(before->size(), after.size())); 
+			before = &padded; 
+		}
+		unsigned words = after.size() / 4; 
+		changes.assign(words, 0); 
+		for (unsigned word = 0 ; word < words ; word++) {
+			changes[word] = after.getUnsigned(word * 4) ^ ((before != nullptr)? before->getUnsigned(word * 4) : 0); 
+		}
+		
+		// Only looking at the attributes in words that changed
+		unsigned count = 0; 
+		lines.str(""); 
+		for (unsigned index = 0 ; index < attributes.size() ; index++) {
+			const Format::Attribute& attribute = *attributes[index]; 
+			if (attribute.offset + 4 > after.size()) {
+				continue; 
+			}
+			
+			bool differs; 
+			if (before == nullptr) {
+				differs = true; 
+			} else if ((attribute.type == AttributeType::String) && (sameStrings == false)) {
+				differs = (GetStringAt(strings, after.getUnsigned(attribute.offset)) != GetStringAt(originalStrings, before->getUnsigned(attribute.offset))); 
+			} else if ((changes[attribute.offset / 4] == 0) && (changes[(attribute.offset + 3) / 4] == 0)) {
+				differs = false; 
+			} else {
+				switch (attribute.type) {
+					case AttributeType::Boolean: 
+						differs = (after.getBoolean(attribute.offset, attribute.bit) != before->getBoolean(attribute.offset, attribute.bit)); 
+						break; 
+					case AttributeType::Unsigned: 
+					case AttributeType::Signed: 
+						differs = (after.getUnsignedMask(attribute.offset, attribute.bit, attribute.size) != before->getUnsignedMask(attribute.offset, attribute.bit, attribute.size)); 
+						break; 
+					default: 
+						differs = (after.getUnsigned(attribute.offset) != before->getUnsigned(attribute.offset)); 
+				}
+			}
+			if (differs == true) {
+				WriteFormatted(lines, "> %-30s = ", attribute.name.c_str()); 
+				WriteValue(lines, after, attribute, enums[index], strings); 
+				lines << std::endl; 
+				count++; 
+			}
+		}
+		
+		// Bits no attribute describes are written as whole words, typed by the string type list
+		for (unsigned word = 0 ; word < words ; word++) {
+			unsigned mask = (word < described.size())? ~described[word] : ~0u; 
+			unsigned type = (word * 4 < strTypeList.size())? strTypeList.getUnsigned(word * 4) : 0; 
+			bool differs = ((changes[word] & mask) != 0); 
+			if ((mask == ~0u) && (type == 2) && (before != nullptr) && (sameStrings == false)) {
+				differs = (GetStringAt(strings, after.getUnsigned(word * 4)) != GetStringAt(originalStrings, before->getUnsigned(word * 4))); 
+			}
+			if (differs == false) {
+				continue; 
+			}
+			
+			char name[32]; 
+			snprintf(name, sizeof(name), "[0x%04X|%02d|%02d]", word * 4, 0, 32); 
+			WriteFormatted(lines, "> %-30s = ", name); 
+			if ((mask == ~0u) && (type == 1)) {
+				WriteExactFloat(lines, after.getFloat(word * 4)); 
+			} else if ((mask == ~0u) && (type == 2)) {
+				lines << '"' << GetStringAt(strings, after.getUnsigned(word * 4)) << '"'; 
+			} else {
+				WriteFormatted(lines, "0x%08X", after.getUnsigned(word * 4)); 
+			}
+			lines << std::endl; 
+			count++; 
+		}
+		
+		if (count == 0) {
+			continue; 
+		} else if (before == nullptr) {
+			added++; 
+		} else {
+			changed++; 
+		}
+		PrintVerbose("Entry %s: %u attributes changed.", it->first.c_str(), count); 
+		out << std::endl; 
+		out << '@' << it->first << ':' << std::endl; 
+		out << lines.str(); 
+	}
+	for ( ; previous != original.m_entryList.end() ; previous++) {
+		if (previous->first[0] != '!') {
+			out << std::endl; 
+			out << "// Entry " << previous->first << " was removed, patch files can't remove entries" << std::endl; 
+			removed++; 
+		}
+	}
+	
+	// Writing patch file (only if its content changed), from a copy of the stream's buffer
+	MemoryStats::Block output(MemoryTag::ConvertOutput, 2 * static_cast<std::size_t>(out.tellp())); 
+	bool written; 
+	if (!UpdateFile(filename, out.str(), written, true)) {
+		PrintError("Couldn't open file \"%s\".", filename.c_str()); 
+		PrintAbort(); 
+		return false; 
+	}
+	
+	Print("%u entries changed, %u added, %u removed.", changed, added, removed); 
+	Profile::Count(ProfileCounter::EntriesTouched, changed + added); 
+	if (written == false) {
+		Print("Patch file is up to date."); 
+	}
+	PrintDone(); 
+	return true; 
+}
+
+void WPDFile::updateIndexes (const std::string& id, unsigned offset, unsigned previous, unsigned current) {
+	for (auto index = this->m_indexes.begin() ; index != this->m_indexes.end() ; index++) {
+		unsigned before = (previous >> index->bit) & index->mask; 
+		unsigned after = (current >> index->bit) & index->mask; 
+		if ((index->offset == offset) && (before != after)) {
+			index->entries[before].erase(id); 
+			index->entries[after].insert(id); 
+		}
+	}
+}
+
+// Fields only count once the entry holds all four bytes of their word, resize keeps whole words and fills new ones with zeroes
+void WPDFile::resizeEntry (const std::string& id, Chunk& data, unsigned size) {
+	unsigned previous = data.size(); 
+	unsigned current = (size + 3) / 4 * 4; 
+	for (auto index = this->m_indexes.begin() ; index != this->m_indexes.end() ; index++) {
+		if ((id[0] != '!') && (index->offset + 4 <= previous) && (index->offset + 4 > current)) {
+			index->entries[(data.getUnsigned(index->offset) >> index->bit) & index->mask].erase(id); 
+		}
+	}
+	data.resize(size); 
+	for (auto index = this->m_indexes.begin() ; index != this->m_indexes.end() ; index++) {
+		if ((id[0] != '!') && (index->offset + 4 > previous) && (index->offset + 4 <= current)) {
+			index->entries[(data.getUnsigned(index->offset) >> index->bit) & index->mask].insert(id); 
+		}
+	}
+}
+
+const std::set<std::string>& WPDFile::getIndexedEntries (const Format::Attribute& attribute, unsigned value) const {
+	static const std::set<std::string> none; 
+	
+	// Fields are told apart by where they are, whatever their type
+	bool word = (attribute.type == AttributeType::Float) || (attribute.type == AttributeType::String); 
+	unsigned bit = (word == true)? 0 : attribute.bit; 
+	unsigned size = (attribute.type == AttributeType::Boolean)? 1 : (word == true)? 32 : attribute.size; 
+	unsigned mask = (size < 32)? (1U << size) - 1 : 0xFFFFFFFFU; 
+	
+	auto index = this->m_indexes.begin(); 
+	while ((index != this->m_indexes.end()) && ((index->offset != attribute.offset) || (index->bit != bit) || (index->mask != mask))) {
+		index++; 
+	}
+	if (index == this->m_indexes.end()) {
+		Profile::Scope scope("index", attribute.name); 
+		index = this->m_indexes.insert(this->m_indexes.end(), AttributeIndex{attribute.offset, bit, mask, {}}); 
+		for (auto it = this->m_entryList.begin() ; it != this->m_entryList.end() ; it++) {
+			if ((it->first[0] != '!') && (attribute.offset + 4 <= it->second.size())) {
+				std::set<std::string>& entries = index->entries[(it->second.getUnsigned(attribute.offset) >> bit) & mask]; 
+				entries.insert(entries.end(), it->first); 
+			}
+		}
+	}
+	
+	auto it = index->entries.find(value & mask); 
+	return (it != index->entries.end())? it->second : none; 
+}
+
+std::set<std::string> WPDFile::findEntries (const Format::Attribute& attribute, unsigned value) const {
+	return this->getIndexedEntries(attribute, value); 
+}
+
+// Strings of the pool by where they start, the missing ones are appended together at the end
+void WPDFile::appendStrings (const std::vector<std::string_view>& strings, std::vector<unsigned>& references) {
+	Chunk& pool = this->m_entryList["!!string"]; 
+	pool.setTag(MemoryTag::Strings); 
+	references.resize(strings.size()); 
+	
+	std::unordered_map<std::string_view, unsigned> existing; 
+	for (unsigned offset = 0 ; offset < pool.size() ; ) {
+		std::string_view str = pool.getStringView(offset); 
+		existing.emplace(str, offset); 
+		offset += str.size() + 1; 
+	}
+	std::vector<unsigned> missing; 
+	unsigned end = pool.size(); 
+	for (unsigned i = 0 ; i < strings.size() ; i++) {
+		auto it = existing.find(strings[i]); 
+		if (it != existing.end()) {
+			references[i] = it->second; 
+		} else {
+			// Added to the lookup too, a string asked for twice is appended once
+			references[i] = end; 
+			existing.emplace(strings[i], end); 
+			end += strings[i].size() + 1; 
+			missing.push_back(i); 
+		}
+	}
+	existing.clear(); 
+	if (!missing.empty()) {
+		pool.resize(end); 
+		for (auto it = missing.begin() ; it != missing.end() ; it++) {
+			std::memcpy(pool.data() + references[*it], strings[*it].data(), strings[*it].size()); 
+		}
+		Profile::Count(ProfileCounter::StringsAppended, missing.size()); 
+	}
+}
+
 unsigned WPDFile::getStringReference (const std::string& str) {
-	Chunk& strings = this->getEntryData("!!string"); 
+	Chunk& strings = this->m_entryList["!!string"]; 
+	strings.setTag(MemoryTag::Strings); 
 
 	int i = 0; 
 	int offset; 
@@ -583,6 +1861,7 @@ unsigned WPDFile::getStringReference (const std::string& str) {
 	
 	strings.resize(offset+str.size()+1); 
 	strings.setString(offset, str); 
+	Profile::Count(ProfileCounter::StringsAppended, 1); 
 	return offset; 
 }
 
@@ -595,9 +1874,207 @@ const Chunk& WPDFile::getEntryData (const std::string& id) const {
 }
 
 Chunk& WPDFile::getEntryData (const std::string& id) {
+	this->m_indexes.clear(); 
 	return this->m_entryList[id]; 
 }
 
 bool WPDFile::getModified () const {
 	return this->m_modified; 
 }
+
+WPDFile::Transaction::Transaction (WPDFile& file, const Format& format)
+	:m_file(file), m_format(format), m_writes(), m_strings(), m_stringIndex(), m_undo(), m_created(), m_stringsSize(0), m_undoable(false) {} 
+WPDFile::Transaction::~Transaction () {} 
+
+bool WPDFile::Transaction::add (const std::string& entry, const std::string& name, AttributeType type, unsigned value, const std::string* text) {
+	const Format::Attribute* attribute; 
+	try {
+		attribute = &this->m_format.getAttribute(name); 
+	} catch (const std::logic_error& e) {
+		PrintError("In entry %s:", entry.c_str()); 
+		PrintStart(); 
+		PrintError(e.what()); 
+		PrintDone(); 
+		return false; 
+	}
+	if ((entry.empty()) || (entry.size() > 15) || (entry[0] == '!')) {
+		PrintError("Invalid entry name (\"%s\").", entry.c_str()); 
+		return false; 
+	}
+	
+	// Bitfields are checked once here, commit only masks and shifts
+	const char* problem = nullptr; 
+	bool bitfield = (type == AttributeType::Unsigned) || (type == AttributeType::Signed); 
+	if (attribute->type != type) {
+		problem = "Attribute is not of that type."; 
+	} else if (attribute->offset + 4 > this->m_format.getSize()) {
+		problem = "Attribute is past the end of the format."; 
+	} else if (((type == AttributeType::Boolean) && (attribute->bit >= 32)) || ((bitfield == true) && ((attribute->size == 0) || (attribute->bit + attribute->size > 32)))) {
+		problem = "Bitfield goes past its word."; 
+	}
+	if (problem != nullptr) {
+		PrintError("In entry %s, attribute %s:", entry.c_str(), name.c_str()); 
+		PrintStart(); 
+		PrintError(problem); 
+		PrintDone(); 
+		return false; 
+	}
+	
+	Write write; 
+	write.entry = entry; 
+	write.offset = attribute->offset; 
+	write.bit = 0; 
+	write.mask = 0xFFFFFFFFU; 
+	write.value = value; 
+	write.string = -1; 
+	if (type == AttributeType::Boolean) {
+		write.bit = attribute->bit; 
+		write.mask = 1; 
+	} else if ((bitfield == true) && (attribute->size < 32)) {
+		write.bit = attribute->bit; 
+		write.mask = (1U << attribute->size) - 1; 
+		int signedValue = static_cast<int>(value); 
+		int half = 1 << (attribute->size - 1); 
+		bool fits = (type == AttributeType::Unsigned)? (value <= write.mask) : ((signedValue >= -half) && (signedValue < half)); 
+		if (fits == false) {
+			PrintError("In entry %s, attribute %s:", entry.c_str(), name.c_str()); 
+			PrintStart(); 
+			PrintError("Value doesn't fit in %u bits.", attribute->size); 
+			PrintDone(); 
+			return false; 
+		}
+	}
+	
+	// Strings are only looked up in !!string on commit, each of them once
+	if (text != nullptr) {
+		auto it = this->m_stringIndex.find(*text); 
+		if (it == this->m_stringIndex.end()) {
+			it = this->m_stringIndex.emplace(*text, this->m_strings.size()).first; 
+			this->m_strings.push_back(*text); 
+		}
+		write.string = it->second; 
+	}
+	this->m_writes.push_back(std::move(write)); 
+	return true; 
+}
+
+bool WPDFile::Transaction::setBoolean (const std::string& entry, const std::string& attribute, bool value) {
+	return this->add(entry, attribute, AttributeType::Boolean, value? 1 : 0, nullptr); 
+}
+
+bool WPDFile::Transaction::setUnsigned (const std::string& entry, const std::string& attribute, unsigned value) {
+	return this->add(entry, attribute, AttributeType::Unsigned, value, nullptr); 
+}
+
+bool WPDFile::Transaction::setSigned (const std::string& entry, const std::string& attribute, int value) {
+	return this->add(entry, attribute, AttributeType::Signed, static_cast<unsigned>(value), nullptr); 
+}
+
+bool WPDFile::Transaction::setFloat (const std::string& entry, const std::string& attribute, float value) {
+	unsigned u; 
+	std::memcpy(&u, &value, sizeof(u)); 
+	return this->add(entry, attribute, AttributeType::Float, u, nullptr); 
+}
+
+bool WPDFile::Transaction::setString (const std::string& entry, const std::string& attribute, const std::string& value) {
+	return this->add(entry, attribute, AttributeType::String, 0, &value); 
+}
+
+unsigned WPDFile::Transaction::getWriteCount () const {
+	return this->m_writes.size(); 
+}
+
+void WPDFile::Transaction::clear () {
+	this->m_writes.clear(); 
+	this->m_strings.clear(); 
+	this->m_stringIndex.clear(); 
+}
+
+bool WPDFile::Transaction::commit (bool undoable) {
+	Profile::Scope scope("transaction"); 
+	this->m_undo.clear(); 
+	this->m_created.clear(); 
+	this->m_undoable = undoable; 
+	auto pool = this->m_file.m_entryList.find("!!string"); 
+	this->m_stringsSize = (pool != this->m_file.m_entryList.end())? pool->second.size() : 0; 
+	
+	std::vector<unsigned> references; 
+	if (!this->m_strings.empty()) {
+		if ((undoable == true) && (this->m_file.m_entryList.find("!!string") == this->m_file.m_entryList.end())) {
+			this->m_created.insert("!!string"); 
+		}
+		std::vector<std::string_view> strings(this->m_strings.begin(), this->m_strings.end()); 
+		this->m_file.appendStrings(strings, references); 
+	}
+	
+	// One pass over the entries, later writes to the same bits win
+	std::stable_sort(this->m_writes.begin(), this->m_writes.end(), [](const Write& a, const Write& b) {
+		int order = a.entry.compare(b.entry); 
+		return (order < 0) || ((order == 0) && (a.offset < b.offset)); 
+	}); 
+	unsigned entries = 0, changed = 0; 
+	for (auto write = this->m_writes.begin() ; write != this->m_writes.end() ; ) {
+		const std::string& entry = write->entry; 
+		auto it = this->m_file.m_entryList.find(entry); 
+		if (it == this->m_file.m_entryList.end()) {
+			it = this->m_file.m_entryList.emplace(entry, Chunk()).first; 
+			if (undoable == true) {
+				this->m_created.insert(entry); 
+			}
+		} else if (undoable == true) {
+			this->m_undo.emplace(entry, it->second); 
+		}
+		Chunk& data = it->second; 
+		if (data.size() != this->m_format.getSize()) {
+			this->m_file.resizeEntry(entry, data, this->m_format.getSize()); 
+		}
+		entries++; 
+		
+		while ((write != this->m_writes.end()) && (write->entry == entry)) {
+			unsigned offset = write->offset; 
+			unsigned previous = data.getUnsigned(offset); 
+			unsigned word = previous; 
+			for ( ; (write != this->m_writes.end()) && (write->entry == entry) && (write->offset == offset) ; write++) {
+				unsigned value = (write->string >= 0)? references[write->string] : write->value; 
+				word = (word & ~(write->mask << write->bit)) | ((value & write->mask) << write->bit); 
+			}
+			if (word != previous) {
+				data.setUnsigned(offset, word); 
+				changed++; 
+				if (!this->m_file.m_indexes.empty()) {
+					this->m_file.updateIndexes(entry, offset, previous, word); 
+				}
+			}
+		}
+	}
+	
+	PrintVerbose("%u writes committed to %u entries, %u words changed.", static_cast<unsigned>(this->m_writes.size()), entries, changed); 
+	Profile::Count(ProfileCounter::EntriesTouched, entries); 
+	Profile::Count(ProfileCounter::AttributesChanged, changed); 
+	this->m_file.m_modified = true; 
+	this->clear(); 
+	return true; 
+}
+
+bool WPDFile::Transaction::rollback () {
+	if (this->m_undoable == false) {
+		PrintError("Nothing to roll back, the last commit wasn't undoable."); 
+		return false; 
+	}
+	
+	for (auto it = this->m_undo.begin() ; it != this->m_undo.end() ; it++) {
+		this->m_file.m_entryList[it->first] = std::move(it->second); 
+	}
+	for (auto it = this->m_created.begin() ; it != this->m_created.end() ; it++) {
+		this->m_file.m_entryList.erase(*it); 
+	}
+	auto strings = this->m_file.m_entryList.find("!!string"); 
+	if ((strings != this->m_file.m_entryList.end()) && (strings->second.size() > this->m_stringsSize)) {
+		strings->second.resize(this->m_stringsSize); 
+	}
+	this->m_file.m_indexes.clear(); 
+	this->m_undo.clear(); 
+	this->m_created.clear(); 
+	this->m_undoable = false; 
+	return true; 
+}
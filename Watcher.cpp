@@ -0,0 +1,124 @@
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "include/Watcher.hpp"
+
+using namespace dbtool; 
+
+Watcher::Watcher ()
+	:m_fileList(), m_folderList(), m_handle(-1), m_polling(false) {
+#ifdef __linux__
+		this->m_handle = inotify_init1(IN_CLOEXEC); 
+		if (this->m_handle < 0) {
+			PrintVerbose("Couldn't use inotify, polling files instead."); 
+		}
+#endif
+	}
+Watcher::~Watcher () {
+#ifdef __linux__
+	if (this->m_handle >= 0) {
+		close(this->m_handle); 
+	}
+#endif
+}
+
+void Watcher::add (const std::string& filename) {
+	if (this->m_fileList.find(filename) != this->m_fileList.end()) {
+		return; 
+	}
+	File& file = this->m_fileList[filename]; 
+	this->update(filename, file); 
+	
+#ifdef __linux__
+	// Watching folders rather than files, editors often replace a file instead of writing it
+	if (this->m_handle >= 0) {
+		std::string::size_type end = filename.rfind('/'); 
+		std::string folder = (end != std::string::npos)? filename.substr(0, end) : "."; 
+		int watch = inotify_add_watch(this->m_handle, folder.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE); 
+		if (watch >= 0) {
+			this->m_folderList[watch] = folder; 
+		} else {
+			PrintVerbose("Couldn't watch folder \"%s\".", folder.c_str()); 
+			this->m_polling = true; 
+		}
+	}
+#endif
+}
+
+void Watcher::wait (std::list<std::string>& changed) {
+	changed.clear(); 
+	while (changed.empty()) {
+		// Files named by an event count as changed even if their status looks the same
+		std::list<std::string> touched; 
+		if (!this->waitEvents(touched)) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(PollInterval)); 
+		}
+		for (auto it = this->m_fileList.begin() ; it != this->m_fileList.end() ; it++) {
+			if ((this->update(it->first, it->second)) || (std::find(touched.begin(), touched.end(), it->first) != touched.end())) {
+				changed.push_back(it->first); 
+			}
+		}
+	}
+}
+
+unsigned Watcher::getFileCount () const {
+	return this->m_fileList.size(); 
+}
+
+bool Watcher::update (const std::string& filename, File& file) {
+	File current; 
+	current.exists = ReadFileStatus(filename, current.status); 
+	if (current.exists == false) {
+		current.status.size = 0; 
+		current.status.time = 0; 
+	}
+	bool modified = (current.exists != file.exists) || (current.status.size != file.status.size) || (current.status.time != file.status.time); 
+	file = current; 
+	return modified; 
+}
+
+bool Watcher::waitEvents (std::list<std::string>& touched) {
+#ifdef __linux__
+	if (this->m_handle < 0) {
+		return false; 
+	}
+	
+	// Blocking for the first event, then collecting those that follow it closely so a save is handled once. 
+	// Files in folders that couldn't be watched are still polled. 
+	int timeout = this->m_polling? PollInterval : -1; 
+	while (true) {
+		pollfd handle = { this->m_handle, POLLIN, 0 }; 
+		if (poll(&handle, 1, timeout) <= 0) {
+			return true; 
+		}
+		
+		alignas(inotify_event) char buffer[4096]; 
+		ssize_t size = read(this->m_handle, buffer, sizeof(buffer)); 
+		if (size <= 0) {
+			return true; 
+		}
+		for (ssize_t offset = 0 ; offset < size ; ) {
+			const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset); 
+			std::map<int, std::string>::const_iterator folder = this->m_folderList.find(event->wd); 
+			if ((folder != this->m_folderList.end()) && (event->len > 0)) {
+				std::string filename = (folder->second == ".")? std::string(event->name) : folder->second + "/" + event->name; 
+				if (this->m_fileList.find(filename) != this->m_fileList.end()) {
+					touched.push_back(filename); 
+				}
+			}
+			offset += sizeof(inotify_event) + event->len; 
+		}
+		timeout = touched.empty()? (this->m_polling? PollInterval : -1) : SettleDelay; 
+	}
+#else
+	return false; 
+#endif
+}
@@ -0,0 +1,80 @@
+
+#ifndef DBTOOL_HEADER_ARCHIVE
+#define DBTOOL_HEADER_ARCHIVE
+
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "MappedFile.hpp"
+
+namespace dbtool {
+	
+	// Game archive: a file list (filelistc.win32.bin) indexing the files packed in an image (white_imgc.win32.bin). 
+	// 
+	// The file list is little endian: 
+	//   0x0	offset of the chunk table
+	//   0x4	offset of the chunk data
+	//   0x8	file count
+	//   0xC	file table, 8 bytes per file: code, offset of its path in its chunk (16 bits), chunk index (16 bits)
+	//   		chunk table, 12 bytes per chunk: size, compressed size, offset from the chunk data
+	//   		chunk data, zlib streams of null-terminated "position:size:compressed size:path" strings (hexadecimal)
+	// Positions are counted in 0x800 byte sectors of the image, files whose compressed size differs from their size are zlib streams. 
+	class Archive {
+		private: 
+			struct Entry {
+				unsigned		code; 
+				unsigned		chunk; 
+				unsigned		pathOffset; 
+				unsigned		position; 
+				unsigned		size; 
+				unsigned		compressedSize; 
+				std::string		path; 
+			}; 
+			
+			struct PathChunk {
+				std::string		data; 
+				unsigned		size; 
+				bool			modified; 
+			}; 
+			
+			typedef std::vector<Entry> ArchiveEntryList; 
+			typedef std::unordered_map<std::string, unsigned> ArchiveEntryIndex; 
+			ArchiveEntryList m_entryList; 
+			ArchiveEntryIndex m_entryIndex; 
+			std::vector<PathChunk> m_chunkList; 
+			std::string m_listFilename; 
+			std::string m_imageFilename; 
+			MappedFile m_image; 
+			
+			bool saveList (); 
+		
+		public: 
+			static const unsigned SectorSize = 0x800; 
+			
+			Archive (); 
+			~Archive (); 
+			
+			bool open (const std::string& listFilename, const std::string& imageFilename); 
+			
+			// Files are written where the list on disk points to nothing, then the list is replaced: 
+			// an import that stops halfway leaves the archive as it was
+			bool import (const std::list<std::string>& files, const std::string& folder); 
+			
+			// Reading maps the image, files stored as is are returned straight from the mapping and the others decompressed into buffer
+			bool mapImage (); 
+			bool read (const std::string& path, std::string_view& data, std::string& buffer) const; 
+			
+			unsigned getEntryCount () const; 
+			bool hasEntry (const std::string& path) const; 
+			
+			// Size of the file once read, 0 if it is not in the archive
+			unsigned long long getFileSize (const std::string& path) const; 
+			const std::string& getImageFilename () const; 
+	}; 
+	
+}
+
+#endif
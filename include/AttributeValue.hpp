@@ -2,22 +2,25 @@
 #ifndef DBTOOL_HEADER_ATTRIBUTE_VALUE
 #define DBTOOL_HEADER_ATTRIBUTE_VALUE
 
-#include <string>
+#include <string_view>
 
 #include "AttributeType.hpp"
 #include "Tools.hpp"
 
 namespace dbtool {
 	
+	// Small tagged value, trivially copyable. Strings are always borrowed: from the !!string pool, 
+	// or from the enumeration holding the value, which keeps the strings it read (see Enum::addString). 
 	class AttributeValue {
 		private: 
 			union {
-				bool			b; 
-				unsigned		u; 
-				int				i; 
-				float			f; 
-				std::string*	s; 
+				bool				b; 
+				unsigned			u; 
+				int					i; 
+				float				f; 
+				const char*			s; 
 			}					m_value; 
+			unsigned			m_size; 
 			AttributeType		m_type; 
 		
 		public: 
@@ -26,12 +29,10 @@ namespace dbtool {
 			AttributeValue(unsigned u); 
 			AttributeValue(int i); 
 			AttributeValue(float f); 
-			AttributeValue(const std::string& s); 
-			AttributeValue(const AttributeValue& value); 
-			AttributeValue(AttributeValue&& value); 
-			AttributeValue& operator = (const AttributeValue& value); 
-			AttributeValue& operator = (AttributeValue&& value); 
-			~AttributeValue(); 
+			explicit AttributeValue(std::string_view s); 
+			
+			bool operator == (const AttributeValue& value) const; 
+			bool operator != (const AttributeValue& value) const; 
 			
 			AttributeType getType() const; 
 			
@@ -39,13 +40,13 @@ namespace dbtool {
 			unsigned getUnsigned() const; 
 			int getSigned() const; 
 			float getFloat() const; 
-			std::string getString() const; 
+			std::string_view getString() const; 
 			
 			void setBoolean(bool b); 
 			void setUnsigned(unsigned u); 
 			void setSigned(int i); 
 			void setFloat(float f); 
-			void setString(const std::string& s); 
+			void setString(std::string_view s); 
 	}; 
 	
 }
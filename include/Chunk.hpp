@@ -3,6 +3,9 @@
 #define DBTOOL_HEADER_CHUNK
 
 #include <string>
+#include <string_view>
+
+#include "MemoryStats.hpp"
 
 namespace dbtool {
 	
@@ -10,6 +13,7 @@ namespace dbtool {
 		private: 
 			char* m_data; 
 			unsigned m_size; 
+			MemoryTag m_tag; 
 		
 		public: 
 			Chunk (); 
@@ -28,12 +32,18 @@ namespace dbtool {
 			unsigned size () const; 
 			void resize (unsigned size); 
 			
+			// What the payload is accounted to, chunks are Chunks until told otherwise
+			MemoryTag getTag () const; 
+			void setTag (MemoryTag tag); 
+			
 			void read (std::istream& in); 
 			void read (std::istream& in, int offset); 
 			void write (std::ostream& out) const;  
 			void write (std::ostream& out, int offset) const; 
 			
 			char operator [] (unsigned offset) const; 
+			const char* data () const; 
+			char* data (); 
 			
 			bool getBoolean (unsigned offset, unsigned bit) const; 
 			void setBoolean (unsigned offset, unsigned bit, bool value); 
@@ -52,6 +62,7 @@ namespace dbtool {
 			void setFloat (unsigned offset, float value); 
 			
 			std::string getString (unsigned offset) const; 
+			std::string_view getStringView (unsigned offset) const; 
 			void setString (unsigned offset, const std::string& string); 
 			
 			Chunk getChunk (unsigned offset, unsigned size) const; 
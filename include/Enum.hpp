@@ -2,6 +2,12 @@
 #ifndef DBTOOL_HEADER_ENUM
 #define DBTOOL_HEADER_ENUM
 
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string_view>
 #include <unordered_map>
 
 #include "AttributeValue.hpp"
@@ -10,16 +16,42 @@
 namespace dbtool {
 	
 	class Enum; 
+	struct EnumSlot; 
 	typedef std::unordered_map<std::string, AttributeValue> AttributeValueMap; 
-	typedef std::unordered_map<std::string, Enum> EnumMap; 
+	typedef std::unordered_map<std::string, std::unique_ptr<EnumSlot>> EnumMap; 
 	
 	class Enum {
 		private: 
+			friend class SchemaCache; 
+			
 			AttributeValueMap	m_values; 
 			AttributeType		m_type; 
 			std::string			m_name; 
 			bool				m_strict; 
+			std::list<std::string>	m_filenames; 
+			
+			// Text of the String values, which only borrow it. A deque never moves what it holds. 
+			std::deque<std::string>	m_strings; 
 			static EnumMap		s_enums; 
+			static std::shared_mutex	s_mutex; 
+			
+			// For each enumeration being loaded, the one it extends when its loader is waiting for it
+			static std::unordered_map<std::string, std::string>	s_waiting; 
+			static std::mutex	s_waitingMutex; 
+			
+			static bool LoadEnum(const std::string& name, Enum& enumInfo); 
+			static bool WaitFor(const std::string& child, const std::string& parent); 
+			
+			// Roughly what the enumeration holds in the registry, for the memory statistics
+			std::size_t getFootprint() const; 
+			
+			// Values borrow from the enumeration, so it is never copied
+			Enum(const Enum& enumInfo); 
+			Enum& operator = (const Enum& enumInfo); 
+			
+			void clear(); 
+			std::string_view addString(std::string_view s); 
+			void setString(const std::string& name, std::string_view s); 
 			
 		public: 
 			Enum(); 
@@ -27,18 +59,26 @@ namespace dbtool {
 			
 			AttributeType getType() const; 
 			bool getStrict() const; 
+			const std::list<std::string>& getFilenames() const; 
+			const AttributeValueMap& getValues() const; 
 			
 			unsigned getUnsigned(const std::string& name) const; 
 			int getSigned(const std::string& name) const; 
 			float getFloat(const std::string& name) const; 
-			std::string getString(const std::string& name) const; 
+			std::string_view getString(const std::string& name) const; 
 			
-			std::string getName(unsigned u) const; 
-			std::string getName(int i) const; 
-			std::string getName(float f) const; 
-			std::string getName(const std::string& s) const; 
+			const std::string& getName(unsigned u) const; 
+			const std::string& getName(int i) const; 
+			const std::string& getName(float f) const; 
+			const std::string& getName(std::string_view s) const; 
 			
 			static Enum* GetEnum(const std::string& name); 
+			static void Unload(const std::string& filename); 
+	}; 
+	
+	struct EnumSlot {
+		std::once_flag			once; 
+		std::unique_ptr<Enum>	enumInfo; 
 	}; 
 	
 }
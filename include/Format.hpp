@@ -3,6 +3,9 @@
 #define DBTOOL_HEADER_FORMAT
 
 #include <list>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <unordered_map>
 
 #include "AttributeFormat.hpp"
@@ -31,24 +34,46 @@ namespace dbtool {
 			typedef std::list<Attribute> Attributes; 
 			
 		private:
+			friend class SchemaCache; 
+			
 			Attributes		m_attributes; 
 			unsigned		m_size; 
 			std::string		m_name; 
+			std::list<std::string>	m_filenames; 
 		
-			typedef std::unordered_map<std::string, Format> Formats; 
-			static Formats	s_formats; 
+			struct FormatSlot {
+				std::once_flag			once; 
+				std::unique_ptr<Format>	format; 
+			}; 
+			
+			typedef std::unordered_map<std::string, std::unique_ptr<FormatSlot>> Formats; 
+			static Formats				s_formats; 
+			static std::shared_mutex	s_mutex; 
+			
+			static bool LoadFormat(const std::string& name, Format& formatInfo); 
+			
+			// Roughly what the format holds in the registry, for the memory statistics
+			std::size_t getFootprint() const; 
 			
 		public: 
 			Format(); 
 			~Format(); 
 			
 			unsigned getSize() const; 
+			const std::list<std::string>& getFilenames() const; 
 			
 			const Attributes& getAttributes() const; 
 			
 			const Attribute& getAttribute(const std::string& name) const; 
 			
+			// Raw fields are named after their position ([0xOFFS|bit|size]), whole words holding a float or a string are told apart by their value
+			static bool GetRawAttribute(const std::string& name, const std::string& value, Attribute& attribute); 
+			
 			static Format* GetFormat(const std::string& name); 
+			
+			// Loads the formats and their enumerations on up to threads threads (0 for one per core)
+			static void Preload(const std::list<std::string>& names, unsigned threads); 
+			static void Unload(const std::string& filename); 
 	}; 
 }
 
@@ -0,0 +1,85 @@
+
+#ifndef DBTOOL_HEADER_FORMAT_VIEW
+#define DBTOOL_HEADER_FORMAT_VIEW
+
+#include <cstring>
+
+namespace dbtool {
+	
+	// Compile-time field access used by the headers made by tools/GenerateFormat. 
+	// Same layout rules as Chunk: big-endian 32-bit words, bitfields counted from the least significant bit. 
+	namespace FormatView {
+		
+		template<unsigned Size>
+		struct Mask {
+			static constexpr unsigned value = (Size < 32)? ((1U << Size) - 1U) : 0xFFFFFFFFU; 
+		}; 
+		
+		inline unsigned Load (const char* data, unsigned offset) {
+			const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data + offset); 
+			return (static_cast<unsigned>(bytes[0]) << 24) | (static_cast<unsigned>(bytes[1]) << 16) | (static_cast<unsigned>(bytes[2]) << 8) | static_cast<unsigned>(bytes[3]); 
+		}
+		
+		inline void Store (char* data, unsigned offset, unsigned value) {
+			unsigned char* bytes = reinterpret_cast<unsigned char*>(data + offset); 
+			bytes[0] = static_cast<unsigned char>(value >> 24); 
+			bytes[1] = static_cast<unsigned char>(value >> 16); 
+			bytes[2] = static_cast<unsigned char>(value >> 8); 
+			bytes[3] = static_cast<unsigned char>(value); 
+		}
+		
+		template<unsigned Offset, unsigned Bit, unsigned Size>
+		inline unsigned GetUnsigned (const char* data) {
+			return (Load(data, Offset) >> Bit) & Mask<Size>::value; 
+		}
+		
+		template<unsigned Offset, unsigned Bit, unsigned Size>
+		inline void SetUnsigned (char* data, unsigned value) {
+			const unsigned mask = Mask<Size>::value << Bit; 
+			Store(data, Offset, (Load(data, Offset) & ~mask) | ((value << Bit) & mask)); 
+		}
+		
+		template<unsigned Offset, unsigned Bit, unsigned Size>
+		inline int GetSigned (const char* data) {
+			unsigned u = GetUnsigned<Offset, Bit, Size>(data); 
+			if ((Size < 32) && ((u >> (Size - 1)) & 1U)) {
+				u |= ~Mask<Size>::value; 
+			}
+			return static_cast<int>(u); 
+		}
+		
+		template<unsigned Offset, unsigned Bit, unsigned Size>
+		inline void SetSigned (char* data, int value) {
+			SetUnsigned<Offset, Bit, Size>(data, static_cast<unsigned>(value)); 
+		}
+		
+		template<unsigned Offset, unsigned Bit>
+		inline bool GetBoolean (const char* data) {
+			return GetUnsigned<Offset, Bit, 1>(data) != 0; 
+		}
+		
+		template<unsigned Offset, unsigned Bit>
+		inline void SetBoolean (char* data, bool value) {
+			SetUnsigned<Offset, Bit, 1>(data, value? 1U : 0U); 
+		}
+		
+		template<unsigned Offset>
+		inline float GetFloat (const char* data) {
+			unsigned u = Load(data, Offset); 
+			float f; 
+			std::memcpy(&f, &u, sizeof(f)); 
+			return f; 
+		}
+		
+		template<unsigned Offset>
+		inline void SetFloat (char* data, float value) {
+			unsigned u; 
+			std::memcpy(&u, &value, sizeof(u)); 
+			Store(data, Offset, u); 
+		}
+		
+	}
+	
+}
+
+#endif
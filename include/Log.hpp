@@ -0,0 +1,46 @@
+
+#ifndef DBTOOL_HEADER_LOG
+#define DBTOOL_HEADER_LOG
+
+#include <string>
+
+namespace dbtool {
+	
+	// Lines are only formatted when their level is shown, -q keeps errors alone and costs a comparison per line
+	enum class LogLevel {
+		Error, 
+		Info, 
+		Verbose
+	}; 
+	
+	void SetLogLevel(LogLevel level); 
+	LogLevel GetLogLevel(); 
+	
+	// Lines are queued without locking and written by a single thread in the order they were queued.
+	// LogFlush returns once everything queued so far is on the console.
+	void LogFlush(); 
+	
+	int GetPrintIndent(); 
+	void SetPrintIndent(int indent); 
+	
+	// Lines printed by this thread go to the buffer instead of the console, until it is set back to nullptr
+	void SetPrintBuffer(std::string* buffer); 
+	void PrintBuffered(const std::string& buffer); 
+	
+	// Errors printed by this thread are also added to the buffer, a line each without indentation, until it is set back to nullptr
+	void SetErrorBuffer(std::string* buffer); 
+	
+	// What this thread is working on, errors are prefixed with it when nothing else is shown
+	void SetPrintContext(const std::string& context); 
+	
+	void Print(); 
+	void Print(const std::string& format, ...); 
+	void PrintVerbose(const std::string& format, ...); 
+	void PrintError(const std::string& format, ...); 
+	void PrintStart(); 
+	void PrintAbort(); 
+	void PrintDone(); 
+	
+}
+
+#endif
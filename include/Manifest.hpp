@@ -0,0 +1,57 @@
+
+#ifndef DBTOOL_HEADER_MANIFEST
+#define DBTOOL_HEADER_MANIFEST
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "Tools.hpp"
+
+namespace dbtool {
+	
+	// Safe to share between jobs, files are hashed outside of the lock
+	class Manifest {
+		private: 
+			struct File {
+				FileStatus				status; 
+				unsigned long long		hash; 
+			}; 
+			
+			struct Output {
+				unsigned long long		key; 
+				unsigned long long		hash; 
+				std::list<std::string>	inputs; 
+			}; 
+			
+			typedef std::map<std::string, File> ManifestFileList; 
+			typedef std::map<std::string, Output> ManifestOutputList; 
+			ManifestFileList m_fileList; 
+			ManifestOutputList m_outputList; 
+			std::map<std::string, unsigned long long> m_memoryList; 
+			bool m_modified; 
+			mutable std::mutex m_mutex; 
+			
+			unsigned long long getKey(const std::list<std::string>& inputs, const std::string& options); 
+		
+		public: 
+			Manifest (); 
+			~Manifest (); 
+			
+			bool load (const std::string& filename); 
+			bool save (const std::string& filename) const; 
+			
+			bool getFileHash (const std::string& filename, unsigned long long& hash); 
+			void setMemoryHash (const std::string& filename, unsigned long long hash); 
+			
+			bool isUpToDate (const std::string& output, const std::string& options); 
+			void setOutput (const std::string& output, const std::list<std::string>& inputs, const std::string& options); 
+			bool getOutputHash (const std::string& output, unsigned long long& hash) const; 
+			
+			bool getModified () const; 
+	}; 
+	
+}
+
+#endif
@@ -0,0 +1,34 @@
+
+#ifndef DBTOOL_HEADER_MAPPED_FILE
+#define DBTOOL_HEADER_MAPPED_FILE
+
+#include <cstddef>
+#include <string>
+
+namespace dbtool {
+	
+	class MappedFile {
+		private: 
+			const char* m_data; 
+			std::size_t m_size; 
+			void* m_file; 
+			void* m_mapping; 
+			
+			MappedFile (const MappedFile& file); 
+			MappedFile& operator = (const MappedFile& file); 
+		
+		public: 
+			MappedFile (); 
+			~MappedFile (); 
+			
+			bool open (const std::string& filename); 
+			void close (); 
+			
+			bool isOpen () const; 
+			const char* data () const; 
+			std::size_t size () const; 
+	}; 
+	
+}
+
+#endif
@@ -0,0 +1,108 @@
+
+#ifndef DBTOOL_HEADER_MEMORY_STATS
+#define DBTOOL_HEADER_MEMORY_STATS
+
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace dbtool {
+	
+	enum class MemoryTag : unsigned char {
+		Chunks, 
+		Strings, 
+		Schemas, 
+		PatchParsing, 
+		ConvertOutput
+	}; 
+	
+	struct MemoryUsage {
+		long long				current; 
+		long long				peak; 
+		unsigned long long		allocations; 
+	}; 
+	
+	// Bytes held by each part of the tool, in total and for the file the thread is working on.
+	// Chunks account for their payloads themselves, the other tags are recorded where their memory is built,
+	// as one allocation each time (a parsed patch file, a loaded format).
+	// Until it is enabled recording costs a relaxed load.
+	class MemoryStats {
+		private: 
+			struct FileRecord; 
+			
+		public: 
+			// What the thread records also goes to the file until the scope ends
+			class FileScope {
+				private: 
+					FileRecord* m_previous; 
+					
+					FileScope (const FileScope& scope); 
+					FileScope& operator = (const FileScope& scope); 
+					
+				public: 
+					FileScope (const std::string& filename); 
+					~FileScope (); 
+			}; 
+			
+			// Memory held until the block goes out of scope
+			class Block {
+				private: 
+					MemoryTag m_tag; 
+					std::size_t m_size; 
+					
+					Block (const Block& block); 
+					Block& operator = (const Block& block); 
+					
+				public: 
+					Block (MemoryTag tag, std::size_t size); 
+					~Block (); 
+			}; 
+			
+		private: 
+			static std::atomic<bool> s_enabled; 
+			static std::map<std::string, std::unique_ptr<FileRecord>> s_files; 
+			static std::mutex s_mutex; 
+			static thread_local FileRecord* s_currentFile; 
+			
+			static void Record(MemoryTag tag, long long size, unsigned allocations); 
+			
+		public: 
+			static void Enable(); 
+			static bool IsEnabled(); 
+			static void Allocate(MemoryTag tag, std::size_t size); 
+			static void Release(MemoryTag tag, std::size_t size); 
+			static void Retag(MemoryTag from, MemoryTag to, std::size_t size); 
+			
+			// What a string holds outside of itself
+			static std::size_t GetHeapSize(const std::string& str); 
+			
+			// Totals since the last reset, for the benchmark to check its hot paths
+			static MemoryUsage GetUsage(MemoryTag tag); 
+			static void Reset(); 
+			
+			// Prints the totals and each file's share, then starts the peaks and counts over
+			static void Report(); 
+	}; 
+	
+	inline bool MemoryStats::IsEnabled() {
+		return MemoryStats::s_enabled.load(std::memory_order_relaxed); 
+	}
+	
+	inline void MemoryStats::Allocate(MemoryTag tag, std::size_t size) {
+		if (MemoryStats::IsEnabled()) {
+			MemoryStats::Record(tag, size, 1); 
+		}
+	}
+	
+	inline void MemoryStats::Release(MemoryTag tag, std::size_t size) {
+		if (MemoryStats::IsEnabled()) {
+			MemoryStats::Record(tag, -static_cast<long long>(size), 0); 
+		}
+	}
+	
+}
+
+#endif
@@ -0,0 +1,62 @@
+
+#ifndef DBTOOL_HEADER_PROFILE
+#define DBTOOL_HEADER_PROFILE
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+namespace dbtool {
+	
+	enum class ProfileCounter {
+		BytesRead, 
+		BytesWritten, 
+		EntriesTouched, 
+		AttributesChanged, 
+		StringsAppended
+	}; 
+	
+	// Timing spans and counters, recorded per thread and merged when reported.
+	// Until profiling is enabled a span or a count costs a relaxed load.
+	class Profile {
+		public: 
+			class Scope {
+				private: 
+					const char* m_name; 
+					std::string m_detail; 
+					long long m_start; 
+					
+					Scope (const Scope& scope); 
+					Scope& operator = (const Scope& scope); 
+					
+				public: 
+					Scope (const char* name); 
+					Scope (const char* name, const std::string& detail); 
+					~Scope (); 
+			}; 
+			
+		private: 
+			static std::atomic<bool> s_enabled; 
+			static bool s_summary; 
+			static std::string s_traceFilename; 
+			static std::chrono::steady_clock::time_point s_origin; 
+			
+			static long long Begin(); 
+			static void End(const char* name, std::string&& detail, long long start); 
+			
+		public: 
+			static void Enable(bool summary, const std::string& traceFilename); 
+			static bool IsEnabled(); 
+			static void Count(ProfileCounter counter, unsigned long long value); 
+			
+			// Prints the summary and writes the trace file, then starts over
+			static void Report(); 
+	}; 
+	
+	inline bool Profile::IsEnabled() {
+		return Profile::s_enabled.load(std::memory_order_relaxed); 
+	}
+	
+}
+
+#endif
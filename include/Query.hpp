@@ -0,0 +1,91 @@
+
+#ifndef DBTOOL_HEADER_QUERY
+#define DBTOOL_HEADER_QUERY
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Enum.hpp"
+#include "Format.hpp"
+#include "WPDFile.hpp"
+
+namespace dbtool {
+	
+	// Filter, projection and sort over the entries of a WPD file, for example:
+	// select @id, name, attack where attack > 500 and kind = Weapon order by attack desc limit 10
+	// Conditions are evaluated a whole column at a time on the payloads, strings and enumeration names
+	// are only looked at for the entries still selected. Equality on an integer field looks the value up in the index
+	// of the file instead, which the first such query builds and patches keep up to date. 
+	class Query {
+		private: 
+			enum class Operator {
+				Equal, 
+				NotEqual, 
+				Less, 
+				LessEqual, 
+				Greater, 
+				GreaterEqual, 
+				Match, 
+				And, 
+				Or, 
+				Not
+			}; 
+			
+			// A column without an attribute is the entry name (@id)
+			struct Column {
+				std::string					name; 
+				const Format::Attribute*	attribute; 
+				Enum*						enumInfo; 
+			}; 
+			
+			struct Condition {
+				Operator					op; 
+				unsigned					column; 
+				AttributeValue				value; 
+				std::string					text; 
+				std::unique_ptr<Condition>	left; 
+				std::unique_ptr<Condition>	right; 
+			}; 
+			
+			struct Token; 
+			struct Table; 
+			
+			const Format* m_format; 
+			std::vector<Column> m_columns; 
+			std::vector<unsigned> m_select; 
+			std::unique_ptr<Condition> m_where; 
+			int m_orderBy; 
+			bool m_descending; 
+			unsigned m_limit; 
+			std::vector<std::vector<std::string>> m_rows; 
+			
+			bool getColumn (const std::string& name, unsigned& column); 
+			std::unique_ptr<Condition> parseOr (const std::vector<Token>& tokens, std::size_t& position); 
+			std::unique_ptr<Condition> parseAnd (const std::vector<Token>& tokens, std::size_t& position); 
+			std::unique_ptr<Condition> parseCondition (const std::vector<Token>& tokens, std::size_t& position); 
+			const std::vector<unsigned>& extract (Table& table, unsigned column) const; 
+			bool lookup (const Condition& condition, const Table& table, std::vector<unsigned char>& selected) const; 
+			void evaluate (const Condition& condition, Table& table, std::vector<unsigned char>& selected) const; 
+			std::string getText (const Table& table, unsigned column, std::size_t row) const; 
+			
+			template<typename T>
+			static void Compare(Operator op, const T* column, T value, std::vector<unsigned char>& selected); 
+			static bool Compare(Operator op, std::string_view text, const std::string& value); 
+			
+		public: 
+			Query (); 
+			~Query (); 
+			
+			bool parse (const std::string& text, const Format* format); 
+			bool run (const WPDFile& file); 
+			
+			// Rows of the last run, the first one names the columns
+			const std::vector<std::vector<std::string>>& getRows () const; 
+			void print () const; 
+			bool save (const std::string& filename) const; 
+	}; 
+	
+}
+
+#endif
@@ -0,0 +1,47 @@
+
+#ifndef DBTOOL_HEADER_SCHEMA_CACHE
+#define DBTOOL_HEADER_SCHEMA_CACHE
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "Enum.hpp"
+#include "Format.hpp"
+#include "MappedFile.hpp"
+
+namespace dbtool {
+	
+	// Parsed formats and enumerations, kept in a single binary file that is mapped on startup. 
+	// Every record remembers the size and time of the XML files it was built from. 
+	class SchemaCache {
+		private: 
+			typedef std::pair<const char*, std::size_t> SchemaRecord; 
+			typedef std::unordered_map<std::string, SchemaRecord> SchemaRecordIndex; 
+			typedef std::map<std::string, std::string> SchemaRecordList; 
+			
+			static MappedFile			s_file; 
+			static SchemaRecordIndex	s_index; 
+			static SchemaRecordList		s_records; 
+			static std::string			s_filename; 
+			static bool					s_modified; 
+			static std::mutex			s_mutex; 
+			
+			static const char* GetRecord(const std::string& key); 
+			static void SetRecord(const std::string& key, const std::list<std::string>& filenames, const std::string& data); 
+		
+		public: 
+			static bool Open(const std::string& filename); 
+			static bool Save(); 
+			
+			static bool ReadFormat(const std::string& name, Format& format); 
+			static bool ReadEnum(const std::string& name, Enum& enumInfo); 
+			static void WriteFormat(const Format& format); 
+			static void WriteEnum(const Enum& enumInfo); 
+	}; 
+	
+}
+
+#endif
@@ -0,0 +1,59 @@
+
+#ifndef DBTOOL_HEADER_THREAD_POOL
+#define DBTOOL_HEADER_THREAD_POOL
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dbtool {
+	
+	// Work-stealing pool: every worker owns a queue and takes tasks from its front, 
+	// idle workers steal from the back of the others' queues. 
+	class ThreadPool {
+		public: 
+			typedef std::function<void()> Task; 
+		
+		private: 
+			struct Worker {
+				std::deque<Task>	tasks; 
+				std::mutex			mutex; 
+				std::thread			thread; 
+			}; 
+			
+			std::vector<std::unique_ptr<Worker>> m_workers; 
+			std::mutex m_mutex; 
+			std::condition_variable m_wakeUp; 
+			std::condition_variable m_idle; 
+			unsigned m_pending; 
+			unsigned m_next; 
+			bool m_stop; 
+			
+			ThreadPool (const ThreadPool& pool); 
+			ThreadPool& operator = (const ThreadPool& pool); 
+			
+			bool pop (unsigned index, Task& task); 
+			void run (unsigned index); 
+		
+		public: 
+			ThreadPool (unsigned threads); 
+			~ThreadPool (); 
+			
+			void submit (const Task& task); 
+			void wait (); 
+			
+			unsigned getThreadCount () const; 
+			
+			static unsigned GetDefaultThreadCount (); 
+			
+			// Whether the calling thread is a worker of a pool, whose other workers already have the other cores
+			static bool IsWorkerThread (); 
+	}; 
+	
+}
+
+#endif
@@ -2,14 +2,43 @@
 #ifndef DBTOOL_HEADER_TOOLS
 #define DBTOOL_HEADER_TOOLS
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "Log.hpp"
+#include "ThreadPool.hpp"
 
 namespace dbtool {
 
+	struct FileStatus {
+		unsigned long long	size; 
+		unsigned long long	time; 
+	}; 
+	
+	// Folders are created once per run, and statuses are read a whole folder at a time and cached. 
+	// Files written outside of UpdateFile have to be forgotten to be seen again, ReadFileStatus always asks the file system. 
 	void CreateFolderForFile(const std::string& filename); 
+	bool GetFileStatus(const std::string& filename, FileStatus& status); 
+	bool ReadFileStatus(const std::string& filename, FileStatus& status); 
+	void ForgetFileStatus(const std::string& filename); 
+	bool ReadWholeFile(const std::string& filename, std::string& content); 
+	bool UpdateFile(const std::string& filename, const std::string& content, bool& written, bool text = false); 
+	
+	// Moves the temporary file over the file, or removes it when both have the same content
+	bool ReplaceFile(const std::string& filename, const std::string& temporary, bool& written); 
+	
+	unsigned long long HashData(const void* data, std::size_t size, unsigned long long hash = 0xCBF29CE484222325ULL); 
+	unsigned long long HashString(const std::string& str, unsigned long long hash = 0xCBF29CE484222325ULL); 
+	bool HashFile(const std::string& filename, unsigned long long& hash); 
 	
 	bool strmatch(const char* format, const char* string); 
 	bool strmatch(const char* format, const char* string, const char* end); 
@@ -17,39 +46,43 @@ namespace dbtool {
 	
 	std::string strfmt(const std::string& format, ...); 
 	
-	template<typename T, typename S>
-	inline T lexical_cast(const S& in) {
-		T out; 
-		std::stringstream str; 
-		str << in; 
-		str >> out; 
-		if (str.fail()) {
-			throw std::logic_error("Bad lexical cast."); 
-		}
-		return out; 
-	}
+	// Numbers as patch, format and enumeration files write them, parsed in one pass without allocating. 
+	// Unsigned numbers are decimal or 0x hexadecimal, signed and float ones decimal, and decimal ones may end with %. 
+	// Returns std::errc::invalid_argument for anything else, and std::errc::result_out_of_range for a value that doesn't fit a field of that many bits. 
+	std::errc ParseUnsigned(std::string_view text, unsigned& value, unsigned bits = 32); 
+	std::errc ParseHexadecimal(std::string_view text, unsigned& value, unsigned bits = 32); 
+	std::errc ParseSigned(std::string_view text, int& value, unsigned bits = 32); 
+	std::errc ParseFloat(std::string_view text, float& value); 
 	
-	template<typename T, typename S>
-	inline T lexical_cast(const S& in, std::ios_base&(*format)(std::ios_base&)) {
-		T out; 
-		std::stringstream str; 
-		str << format << in; 
-		str >> format >> out; 
-		if (str.fail()) {
-			throw std::logic_error("Bad lexical cast."); 
+	// Calls function(i) for every i in [0, count) on all hardware threads, or at most maxThreads of them, 
+	// or on the calling thread alone when it is a pool worker (a -j job), so a run never has more threads than -j asked for
+	template<typename F>
+	inline void ParallelFor(std::size_t count, F function, unsigned maxThreads = 0) {
+		unsigned hardware = std::max(std::thread::hardware_concurrency(), 1U); 
+		std::size_t threads = std::min<std::size_t>((maxThreads > 0)? std::min(hardware, maxThreads) : hardware, count); 
+		if ((threads <= 1) || (ThreadPool::IsWorkerThread())) {
+			for (std::size_t i = 0 ; i < count ; i++) {
+				function(i); 
+			}
+			return; 
+		}
+		
+		std::atomic<std::size_t> next(0); 
+		int indent = GetPrintIndent(); 
+		std::vector<std::thread> workers; 
+		for (std::size_t t = 0 ; t < threads ; t++) {
+			workers.emplace_back([&next, &function, count, indent]() {
+				SetPrintIndent(indent); 
+				for (std::size_t i = next++ ; i < count ; i = next++) {
+					function(i); 
+				}
+			}); 
+		}
+		for (auto it = workers.begin() ; it != workers.end() ; it++) {
+			it->join(); 
 		}
-		return out; 
 	}
 	
-	void SetVerboseMode(bool verbose); 
-	
-	void Print(); 
-	void Print(const std::string& format, ...); 
-	void PrintVerbose(const std::string& format, ...); 
-	void PrintStart(); 
-	void PrintAbort(); 
-	void PrintDone(); 
-	
 }
 
 #endif
@@ -2,35 +2,136 @@
 #ifndef DBTOOL_HEADER_WPD_FILE
 #define DBTOOL_HEADER_WPD_FILE
 
+#include <iostream>
+#include <list>
 #include <map>
+#include <set>
 #include <string>
-#include <windows.h>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
+#include "Archive.hpp"
 #include "Chunk.hpp"
+#include "Format.hpp"
 #include "Tools.hpp"
 
 namespace dbtool {
 	
 	class WPDFile {
 		private: 
+			friend class Query; 
+			
 			typedef std::map<std::string, Chunk> WPDFileEntryList; 
 			WPDFileEntryList m_entryList; 
 			bool m_modified; 
-			WIN32_FILE_ATTRIBUTE_DATA m_fileAttributes; 
+			
+			// Entry names by attribute value, for the field at offset and the bits the mask keeps after the shift
+			struct AttributeIndex {
+				unsigned		offset; 
+				unsigned		bit; 
+				unsigned		mask; 
+				std::unordered_map<unsigned, std::set<std::string>>	entries; 
+			}; 
+			typedef std::list<AttributeIndex> AttributeIndexList; 
+			mutable AttributeIndexList m_indexes; 
+			
+			bool read (std::string_view data); 
+			bool apply (std::istream& in, const std::string& filename, const std::string& format); 
+			bool applyTable (std::istream& in, const std::string& filename, const std::string& format); 
+			void appendStrings (const std::vector<std::string_view>& strings, std::vector<unsigned>& references); 
+			bool writeDiff (const WPDFile& original, const std::string& filename, const Format* fmt) const; 
+			void updateIndexes (const std::string& id, unsigned offset, unsigned previous, unsigned current); 
+			void resizeEntry (const std::string& id, Chunk& data, unsigned size); 
+			
+			// The set held by the index, only good until the next change to the entries or the indexes
+			const std::set<std::string>& getIndexedEntries (const Format::Attribute& attribute, unsigned value) const; 
 		
 		public:
+			// Attribute writes recorded by entry and checked against the format as they come, then applied together
+			// by commit: sorted by entry and offset, each word read and written once, new strings appended to !!string
+			// in one go. Entries written to end up the size of the format, as they do after a patch. 
+			// A commit made undoable keeps a copy of the entries it changes for rollback. 
+			class Transaction {
+				private: 
+					struct Write {
+						std::string		entry; 
+						unsigned		offset; 
+						unsigned		bit; 
+						unsigned		mask; 
+						unsigned		value; 
+						int				string; 
+					}; 
+					
+					WPDFile& m_file; 
+					const Format& m_format; 
+					std::vector<Write> m_writes; 
+					std::vector<std::string> m_strings; 
+					std::unordered_map<std::string, unsigned> m_stringIndex; 
+					std::map<std::string, Chunk> m_undo; 
+					std::set<std::string> m_created; 
+					unsigned m_stringsSize; 
+					bool m_undoable; 
+					
+					bool add (const std::string& entry, const std::string& name, AttributeType type, unsigned value, const std::string* text); 
+					
+				public: 
+					Transaction (WPDFile& file, const Format& format); 
+					~Transaction (); 
+					
+					bool setBoolean (const std::string& entry, const std::string& attribute, bool value); 
+					bool setUnsigned (const std::string& entry, const std::string& attribute, unsigned value); 
+					bool setSigned (const std::string& entry, const std::string& attribute, int value); 
+					bool setFloat (const std::string& entry, const std::string& attribute, float value); 
+					bool setString (const std::string& entry, const std::string& attribute, const std::string& value); 
+					
+					unsigned getWriteCount () const; 
+					void clear (); 
+					bool commit (bool undoable = false); 
+					bool rollback (); 
+			}; 
+			
 			WPDFile (); 
 			~WPDFile (); 
 			
 			bool load (const std::string& filename); 
+			bool load (const std::string& name, std::string_view data); 
+			bool load (const Archive& archive, const std::string& path); 
 			bool save (const std::string& filename) const; 
+			void save (std::ostream& out) const; 
+			
+			// Applies a patch file, or a table when the name ends with .csv: a header row of attribute names with an @id column,
+			// then a row per entry, empty cells leaving the attribute as it is
 			bool patch (const std::string& filename, const std::string& format); 
+			bool patch (const std::string& name, std::string_view content, const std::string& format); 
+			
 			bool convert (const std::string& filename, const std::string& filter, bool showHidden) const; 
 			bool convert (const std::string& filename, const std::string& format, const std::string& filter, bool showHidden) const; 
 			
+			// Writes the patch file text to the stream, raw words without a format
+			bool convert (std::ostream& out, const std::string& format, const std::string& filter, bool showHidden) const; 
+			
+			// Converts a file without loading it, reading one entry at a time from the data (an empty format for raw words). 
+			// The patch file is the same convert would write. 
+			static bool ConvertStream(std::string_view data, const std::string& filename, const std::string& format, const std::string& filter, bool showHidden); 
+			
+			// Writes a format with an attribute for every word of the entries, typed as !!strtypelist says, to start a new format from
+			bool saveFormat (const std::string& filename) const; 
+			
+			// Writes a patch file turning the original into this file, with only the attributes that changed
+			bool diff (const WPDFile& original, const std::string& filename) const; 
+			bool diff (const WPDFile& original, const std::string& filename, const std::string& format) const; 
+			
+			// Entries whose attribute holds the value (a !!string offset for strings, the bits of floats).
+			// An attribute is indexed on its first lookup, patch keeps the index up to date afterwards. 
+			// The set is a copy, changes made to the file afterwards are only seen by the next lookup. 
+			std::set<std::string> findEntries (const Format::Attribute& attribute, unsigned value) const; 
+			
 			unsigned getEntryCount () const; 
 			unsigned getStringReference (const std::string& str); 
 			const Chunk& getEntryData (const std::string& id) const; 
+			
+			// Changes made through the entry aren't seen by the indexes, they are built again on their next lookup
 			Chunk& getEntryData (const std::string& id); 
 			bool getModified () const; 
 	}; 
@@ -0,0 +1,48 @@
+
+#ifndef DBTOOL_HEADER_WATCHER
+#define DBTOOL_HEADER_WATCHER
+
+#include <list>
+#include <map>
+#include <string>
+
+#include "Tools.hpp"
+
+namespace dbtool {
+	
+	// Waits for files to change, woken up by inotify on Linux and polling their status elsewhere
+	class Watcher {
+		private: 
+			struct File {
+				FileStatus	status; 
+				bool		exists; 
+			}; 
+			
+			typedef std::map<std::string, File> WatcherFileList; 
+			WatcherFileList m_fileList; 
+			std::map<int, std::string> m_folderList; 
+			int m_handle; 
+			bool m_polling; 
+			
+			Watcher (const Watcher& watcher); 
+			Watcher& operator = (const Watcher& watcher); 
+			
+			bool update (const std::string& filename, File& file); 
+			bool waitEvents (std::list<std::string>& touched); 
+		
+		public: 
+			static const unsigned PollInterval = 100; 
+			static const unsigned SettleDelay = 20; 
+			
+			Watcher (); 
+			~Watcher (); 
+			
+			void add (const std::string& filename); 
+			void wait (std::list<std::string>& changed); 
+			
+			unsigned getFileCount () const; 
+	}; 
+	
+}
+
+#endif
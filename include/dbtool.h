@@ -0,0 +1,73 @@
+
+#ifndef DBTOOL_HEADER_C_API
+#define DBTOOL_HEADER_C_API
+
+#include <stddef.h>
+
+// C interface to WPD files, for tools that keep them in memory instead of running dbtool on files.
+// The library is every source file but Main.cpp, with CApi.cpp. Define DBTOOL_SHARED when building or using it
+// as a shared library, and DBTOOL_BUILD when building it.
+// 
+// Functions return DBTOOL_OK or an error code. Nothing is printed: the errors of the last call on a file are kept
+// with it, a line each, and read with dbtool_get_error. Some (a bad value in a patch) don't make the call fail.
+// Formats and enumerations are read from xml/fmt and xml/enum under the current directory, as dbtool does.
+// A file is used from one thread at a time, different files can be used from different threads.
+
+#if defined(DBTOOL_SHARED) && defined(_WIN32)
+	#if defined(DBTOOL_BUILD)
+		#define DBTOOL_API __declspec(dllexport)
+	#else
+		#define DBTOOL_API __declspec(dllimport)
+	#endif
+#elif defined(DBTOOL_SHARED) && defined(__GNUC__)
+	#define DBTOOL_API __attribute__((visibility("default")))
+#else
+	#define DBTOOL_API
+#endif
+
+// Changes when a function changes, functions are only ever added otherwise
+#define DBTOOL_API_VERSION 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct dbtool_file dbtool_file; 
+
+enum {
+	DBTOOL_OK = 0, 
+	DBTOOL_ERROR = 1, 
+	DBTOOL_BUFFER_TOO_SMALL = 2, 
+	DBTOOL_INVALID_ARGUMENT = 3
+}; 
+
+DBTOOL_API int dbtool_get_version(void); 
+
+// An empty file, NULL if out of memory
+DBTOOL_API dbtool_file* dbtool_create(void); 
+DBTOOL_API void dbtool_destroy(dbtool_file* file); 
+
+DBTOOL_API int dbtool_open(dbtool_file* file, const char* path); 
+DBTOOL_API int dbtool_open_buffer(dbtool_file* file, const void* data, size_t size); 
+
+// Applies a patch file (a table when the path ends with .csv), the format names a file of xml/fmt
+DBTOOL_API int dbtool_patch(dbtool_file* file, const char* path, const char* format); 
+DBTOOL_API int dbtool_patch_buffer(dbtool_file* file, const char* text, size_t size, const char* format); 
+
+// Writes the patch file text of the entries matching the filter (NULL for all) to the buffer, raw words when the format is NULL.
+// size is set to the size of the text. When it is more than capacity nothing is written and DBTOOL_BUFFER_TOO_SMALL is returned,
+// the text is kept and the next call with the same arguments copies it without converting again.
+DBTOOL_API int dbtool_convert(dbtool_file* file, const char* format, const char* filter, int show_hidden, char* buffer, size_t capacity, size_t* size); 
+
+// Writes the WPD file, to a buffer the same way dbtool_convert does
+DBTOOL_API int dbtool_save(dbtool_file* file, const char* path); 
+DBTOOL_API int dbtool_save_buffer(dbtool_file* file, void* buffer, size_t capacity, size_t* size); 
+
+// Errors of the last call on the file, an empty string when there were none. Valid until the next call on the file.
+DBTOOL_API const char* dbtool_get_error(const dbtool_file* file); 
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
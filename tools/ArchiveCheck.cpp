@@ -0,0 +1,236 @@
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <list>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+#include "../include/Archive.hpp"
+#include "../include/Tools.hpp"
+
+using namespace dbtool; 
+
+// Checks the archive importer on a synthetic archive, generated in a work folder with the layout described in Archive.hpp.
+// Each round imports new versions of some of the files (larger or smaller, stored or compressed), then reads every file back
+// through the new file list, and through the list from before the import to check the import left the files it described alone.
+// Usage: ArchiveCheck [-w folder] [-f files] [-c files per chunk] [-r rounds]
+
+static const std::string ListPath = "sys/filelistc.win32.bin"; 
+static const std::string ImagePath = "sys/white_imgc.win32.bin"; 
+static const std::string PreviousListPath = "sys/filelistc.previous.bin"; 
+static const std::string ImportFolder = "import"; 
+
+static void PutLittle16 (std::string& data, unsigned value) {
+	data += static_cast<char>(value & 0xFF); 
+	data += static_cast<char>((value >> 8) & 0xFF); 
+}
+
+static void PutLittle32 (std::string& data, unsigned value) {
+	PutLittle16(data, value & 0xFFFF); 
+	PutLittle16(data, value >> 16); 
+}
+
+static bool Compress (const std::string& in, std::string& out) {
+	uLongf length = compressBound(in.size()); 
+	out.resize(length); 
+	if (compress2(reinterpret_cast<Bytef*>(&out[0]), &length, reinterpret_cast<const Bytef*>(in.data()), in.size(), Z_BEST_COMPRESSION) != Z_OK) {
+		return false; 
+	}
+	out.resize(length); 
+	return true; 
+}
+
+static std::string GetPath (unsigned file) {
+	return strfmt("db/file%03u.wdb", file); 
+}
+
+// Every third file is stored as is, the others are zlib streams
+static bool IsCompressed (unsigned file) {
+	return file % 3 != 0; 
+}
+
+// Lengths change from round to round, so files both outgrow their sectors and leave some free
+static std::string GetContent (unsigned file, unsigned round) {
+	unsigned lines = 20 + (file * 37 + round * 211) % 600; 
+	std::string content; 
+	for (unsigned line = 0 ; line < lines ; line++) {
+		content += strfmt("file %03u, round %u, line %04u: %08X\n", file, round, line, (file * 2654435761U) ^ (line * 40503U) ^ round); 
+	}
+	return content; 
+}
+
+static bool GenerateArchive (unsigned files, unsigned perChunk, std::vector<std::string>& contents) {
+	std::string image; 
+	std::vector<std::string> chunks((files + perChunk - 1) / perChunk); 
+	std::string table; 
+	contents.resize(files); 
+	for (unsigned i = 0 ; i < files ; i++) {
+		contents[i] = GetContent(i, 0); 
+		std::string stored = contents[i]; 
+		if ((IsCompressed(i)) && (!Compress(contents[i], stored))) {
+			return false; 
+		}
+		
+		std::string& paths = chunks[i / perChunk]; 
+		PutLittle32(table, 0x1000 + i); 
+		PutLittle16(table, paths.size()); 
+		PutLittle16(table, i / perChunk); 
+		paths += strfmt("%x:%x:%x:%s", static_cast<unsigned>(image.size() / Archive::SectorSize), static_cast<unsigned>(contents[i].size()), static_cast<unsigned>(stored.size()), GetPath(i).c_str()); 
+		paths += '\0'; 
+		
+		image += stored; 
+		image.resize((image.size() + Archive::SectorSize - 1) / Archive::SectorSize * Archive::SectorSize, '\0'); 
+	}
+	
+	std::string list; 
+	unsigned chunkTable = 12 + files * 8; 
+	PutLittle32(list, chunkTable); 
+	PutLittle32(list, chunkTable + chunks.size() * 12); 
+	PutLittle32(list, files); 
+	list += table; 
+	std::string data; 
+	for (auto it = chunks.begin() ; it != chunks.end() ; it++) {
+		std::string compressed; 
+		if (!Compress(*it, compressed)) {
+			return false; 
+		}
+		PutLittle32(list, it->size()); 
+		PutLittle32(list, compressed.size()); 
+		PutLittle32(list, data.size()); 
+		data += compressed; 
+	}
+	list += data; 
+	
+	bool written; 
+	return (UpdateFile(ListPath, list, written)) && (UpdateFile(ImagePath, image, written)); 
+}
+
+// Reads every file through the list, returns how many differ from what is expected
+static unsigned CheckArchive (const std::string& listFilename, const std::vector<std::string>& contents, const char* label) {
+	Archive archive; 
+	if ((!archive.open(listFilename, ImagePath)) || (!archive.mapImage())) {
+		Print("%s: couldn't open the archive.", label); 
+		return contents.size(); 
+	}
+	
+	unsigned failures = 0; 
+	if (archive.getEntryCount() != contents.size()) {
+		Print("%s: %u files instead of %u.", label, archive.getEntryCount(), static_cast<unsigned>(contents.size())); 
+		failures++; 
+	}
+	for (unsigned i = 0 ; i < contents.size() ; i++) {
+		std::string_view data; 
+		std::string buffer; 
+		if (!archive.read(GetPath(i), data, buffer)) {
+			Print("%s: couldn't read file \"%s\".", label, GetPath(i).c_str()); 
+			failures++; 
+		} else if (data != contents[i]) {
+			Print("%s: file \"%s\" differs.", label, GetPath(i).c_str()); 
+			failures++; 
+		}
+	}
+	return failures; 
+}
+
+int main (int argc, char** argv) {
+	std::string folder = "archivecheck"; 
+	unsigned files = 40; 
+	unsigned perChunk = 16; 
+	unsigned rounds = 4; 
+	for (int i = 1 ; i < argc ; i++) {
+		std::string arg = argv[i]; 
+		if ((arg.size() != 2) || (arg[0] != '-') || (i + 1 >= argc)) {
+			Print("Usage: ArchiveCheck [-w folder] [-f files] [-c files per chunk] [-r rounds]"); 
+			return EXIT_FAILURE; 
+		}
+		std::string value = argv[++i]; 
+		unsigned number = 0; 
+		if ((std::strchr("fcr", arg[1]) != nullptr) && ((ParseUnsigned(value, number) != std::errc()) || (number == 0))) {
+			Print("Invalid value for %s (\"%s\").", arg.c_str(), value.c_str()); 
+			return EXIT_FAILURE; 
+		}
+		switch (arg[1]) {
+			case 'w': 
+				folder = value; 
+				break; 
+			case 'f': 
+				files = number; 
+				break; 
+			case 'c': 
+				perChunk = number; 
+				break; 
+			case 'r': 
+				rounds = number; 
+				break; 
+			default: 
+				Print("Unknown option (\"%s\").", arg.c_str()); 
+				return EXIT_FAILURE; 
+		}
+	}
+	
+	std::error_code error; 
+	std::filesystem::create_directories(folder, error); 
+	std::filesystem::current_path(folder, error); 
+	if (error) {
+		Print("Couldn't use folder \"%s\".", folder.c_str()); 
+		return EXIT_FAILURE; 
+	}
+	
+	std::vector<std::string> contents; 
+	if (!GenerateArchive(files, perChunk, contents)) {
+		Print("Couldn't generate the archive."); 
+		return EXIT_FAILURE; 
+	}
+	Print("Archive of %u files in %u chunks generated.", files, (files + perChunk - 1) / perChunk); 
+	
+	SetLogLevel(LogLevel::Error); 
+	unsigned failures = CheckArchive(ListPath, contents, "Generated"); 
+	for (unsigned round = 1 ; round <= rounds ; round++) {
+		// A different third of the files each round, in a single import
+		std::vector<std::string> previous = contents; 
+		std::list<std::string> paths; 
+		for (unsigned i = round % 3 ; i < files ; i += 3) {
+			contents[i] = GetContent(i, round); 
+			bool written; 
+			if (!UpdateFile(ImportFolder + "/" + GetPath(i), contents[i], written)) {
+				Print("Couldn't write file \"%s\".", GetPath(i).c_str()); 
+				return EXIT_FAILURE; 
+			}
+			paths.push_back(GetPath(i)); 
+		}
+		
+		std::string list; 
+		bool written; 
+		if ((!ReadWholeFile(ListPath, list)) || (!UpdateFile(PreviousListPath, list, written))) {
+			Print("Couldn't copy the file list."); 
+			return EXIT_FAILURE; 
+		}
+		
+		Archive archive; 
+		if ((!archive.open(ListPath, ImagePath)) || (!archive.import(paths, ImportFolder))) {
+			SetLogLevel(LogLevel::Info); 
+			Print("Round %u: the import failed.", round); 
+			return EXIT_FAILURE; 
+		}
+		
+		failures += CheckArchive(ListPath, contents, strfmt("Round %u", round).c_str()); 
+		failures += CheckArchive(PreviousListPath, previous, strfmt("Round %u, previous list", round).c_str()); 
+		
+		FileStatus image; 
+		ReadFileStatus(ImagePath, image); 
+		SetLogLevel(LogLevel::Info); 
+		Print("Round %u: %u files imported, image of %llu sectors.", round, static_cast<unsigned>(paths.size()), image.size / Archive::SectorSize); 
+		SetLogLevel(LogLevel::Error); 
+	}
+	SetLogLevel(LogLevel::Info); 
+	
+	if (failures > 0) {
+		Print("%u failures.", failures); 
+	} else {
+		Print("Every file read back as expected."); 
+	}
+	LogFlush(); 
+	return (failures > 0)? EXIT_FAILURE : EXIT_SUCCESS; 
+}
@@ -0,0 +1,434 @@
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../include/Enum.hpp"
+#include "../include/Format.hpp"
+#include "../include/MemoryStats.hpp"
+#include "../include/Query.hpp"
+#include "../include/SchemaCache.hpp"
+#include "../include/Tools.hpp"
+#include "../include/WPDFile.hpp"
+
+using namespace dbtool; 
+
+// Benchmarks the WPD and format code on synthetic files, generated in a work folder at several scales.
+// Usage: Benchmark [-r repeats] [-o results.json] [-w folder] [-e entries] [-s entry size] [-p strings]
+// Without -e, -s or -p the small, medium and large scales are run. Results are printed and written as JSON.
+// Chunk allocations are counted too, the run fails if a hot path allocates more than it should, or if an index lookup
+// doesn't find what a scan of the entries does.
+
+struct Scale {
+	std::string		name; 
+	unsigned		entries; 
+	unsigned		entrySize; 
+	unsigned		strings; 
+}; 
+
+struct Result {
+	std::string				name; 
+	std::string				scale; 
+	unsigned long long		items; 
+	std::vector<double>		times; 
+	unsigned long long		allocations; 
+}; 
+
+static const std::string FormatName = "bench.xml"; 
+static const std::string EnumName = "bench_kind"; 
+static const std::string WPDPath = "sys/bench.wdb"; 
+static const std::string PatchPath = "patch/bench.txt"; 
+
+static bool AllocationsExceeded = false; 
+static bool LookupsMismatched = false; 
+
+// Every 4 bytes of an entry hold one of these, in turn
+enum class Field { Text, Rate, Packed, Delta, Mask }; 
+
+static Field GetField (unsigned word) {
+	return static_cast<Field>(word % 5); 
+}
+
+static void GenerateSchema (const Scale& scale) {
+	std::string enumXml = "<enum type=\"Unsigned\">\n"; 
+	for (unsigned i = 0 ; i < 16 ; i++) {
+		enumXml += strfmt("\t<option name=\"Kind%u\" value=\"%u\"/>\n", i, i); 
+	}
+	enumXml += "</enum>\n"; 
+	
+	std::string formatXml = strfmt("<struct size=\"%u\">\n", scale.entrySize); 
+	for (unsigned word = 0 ; word < scale.entrySize / 4 ; word++) {
+		unsigned offset = word * 4; 
+		switch (GetField(word)) {
+			case Field::Text: 
+				formatXml += strfmt("\t<data name=\"text%u\" type=\"String\" offset=\"%X\"/>\n", word, offset); 
+				break; 
+			case Field::Rate: 
+				formatXml += strfmt("\t<data name=\"rate%u\" type=\"Float\" offset=\"%X\"/>\n", word, offset); 
+				break; 
+			case Field::Packed: 
+				formatXml += strfmt("\t<data name=\"count%u\" type=\"Unsigned\" offset=\"%X\" bit=\"0\" size=\"16\"/>\n", word, offset); 
+				formatXml += strfmt("\t<data name=\"kind%u\" type=\"Unsigned\" offset=\"%X\" bit=\"16\" size=\"8\" enum=\"%s\"/>\n", word, offset, EnumName.c_str()); 
+				formatXml += strfmt("\t<data name=\"flag%u\" type=\"Boolean\" offset=\"%X\" bit=\"24\"/>\n", word, offset); 
+				break; 
+			case Field::Delta: 
+				formatXml += strfmt("\t<data name=\"delta%u\" type=\"Signed\" offset=\"%X\"/>\n", word, offset); 
+				break; 
+			case Field::Mask: 
+				formatXml += strfmt("\t<data name=\"mask%u\" type=\"Unsigned\" offset=\"%X\" format=\"hexa\"/>\n", word, offset); 
+		}
+	}
+	formatXml += "</struct>\n"; 
+	
+	bool written; 
+	UpdateFile(strfmt("xml/enum/%s.xml", EnumName.c_str()), enumXml, written, true); 
+	UpdateFile(strfmt("xml/fmt/%s", FormatName.c_str()), formatXml, written, true); 
+}
+
+static bool GenerateWPD (const Scale& scale) {
+	WPDFile file; 
+	
+	// The string pool, and the type of every word for the raw conversion
+	Chunk& strings = file.getEntryData("!!string"); 
+	std::vector<unsigned> offsets; 
+	std::string pool; 
+	for (unsigned i = 0 ; i < scale.strings ; i++) {
+		offsets.push_back(pool.size()); 
+		pool += strfmt("string %06u", i); 
+		pool += '\0'; 
+	}
+	strings.resize(pool.size()); 
+	std::copy(pool.begin(), pool.end(), strings.data()); 
+	
+	Chunk& types = file.getEntryData("!!strtypelist"); 
+	types.resize(scale.entrySize); 
+	for (unsigned word = 0 ; word < scale.entrySize / 4 ; word++) {
+		types.setUnsigned(word * 4, (GetField(word) == Field::Text)? 2 : (GetField(word) == Field::Rate)? 1 : 0); 
+	}
+	
+	for (unsigned i = 0 ; i < scale.entries ; i++) {
+		Chunk& entry = file.getEntryData(strfmt("e%06u", i)); 
+		entry.resize(scale.entrySize); 
+		for (unsigned word = 0 ; word < scale.entrySize / 4 ; word++) {
+			unsigned offset = word * 4; 
+			switch (GetField(word)) {
+				case Field::Text: 
+					entry.setUnsigned(offset, offsets[(i * 7 + word) % offsets.size()]); 
+					break; 
+				case Field::Rate: 
+					entry.setFloat(offset, i * 0.25f); 
+					break; 
+				case Field::Packed: 
+					entry.setUnsignedMask(offset, 0, 16, i & 0xFFFF); 
+					entry.setUnsignedMask(offset, 16, 8, i % 16); 
+					entry.setBoolean(offset, 24, (i & 1) != 0); 
+					break; 
+				case Field::Delta: 
+					entry.setSigned(offset, -static_cast<int>(i)); 
+					break; 
+				case Field::Mask: 
+					entry.setUnsigned(offset, i * 2654435761U); 
+			}
+		}
+	}
+	return file.save(WPDPath); 
+}
+
+// Every fourth entry gets a new value for each of its first five words, new strings included
+static void GeneratePatch (const Scale& scale) {
+	std::string patch = "// Generated by tools/Benchmark\n"; 
+	for (unsigned i = 0 ; i < scale.entries ; i += 4) {
+		patch += strfmt("\n@e%06u:\n", i); 
+		patch += strfmt("> text0 = \"patched %u\"\n", i); 
+		patch += "> rate1 = 2.50\n"; 
+		patch += strfmt("> count2 = %u\n", (i + 1) & 0xFFFF); 
+		patch += strfmt("> kind2 = Kind%u\n", (i + 3) % 16); 
+		patch += "> flag2 = true\n"; 
+		patch += "> delta3 = -5\n"; 
+		patch += "> mask4 = 0x00FF00FF\n"; 
+	}
+	bool written; 
+	UpdateFile(PatchPath, patch, written, true); 
+}
+
+static unsigned long long GetChunkAllocations () {
+	return MemoryStats::GetUsage(MemoryTag::Chunks).allocations + MemoryStats::GetUsage(MemoryTag::Strings).allocations; 
+}
+
+// Runs setup then the timed function, repeats times. 
+// The timed function may allocate chunk payloads (the string pool included) at most maxAllocations times, -1 for no limit. 
+static Result Measure (const std::string& name, const Scale& scale, unsigned long long items, unsigned repeats, const std::function<void()>& setup, const std::function<void()>& run, long long maxAllocations = -1) {
+	Result result; 
+	result.name = name; 
+	result.scale = scale.name; 
+	result.items = items; 
+	result.allocations = 0; 
+	for (unsigned i = 0 ; i < repeats ; i++) {
+		setup(); 
+		MemoryStats::Reset(); 
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now(); 
+		run(); 
+		result.times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()); 
+		result.allocations = std::max(result.allocations, GetChunkAllocations()); 
+	}
+	if ((maxAllocations >= 0) && (result.allocations > static_cast<unsigned long long>(maxAllocations))) {
+		PrintError("%s allocated chunks %llu times, %lld at most expected.", name.c_str(), result.allocations, maxAllocations); 
+		AllocationsExceeded = true; 
+	}
+	std::sort(result.times.begin(), result.times.end()); 
+	return result; 
+}
+
+static void ForgetOutput (const std::string& filename) {
+	std::error_code error; 
+	std::filesystem::remove(filename, error); 
+	ForgetFileStatus(filename); 
+}
+
+static void RunScale (const Scale& scale, unsigned repeats, std::vector<Result>& results) {
+	std::vector<Result> scaleResults; 
+	GenerateSchema(scale); 
+	if ((Format::GetFormat(FormatName) == nullptr) || (!GenerateWPD(scale))) {
+		PrintError("Couldn't generate the files of scale %s.", scale.name.c_str()); 
+		return; 
+	}
+	GeneratePatch(scale); 
+	auto nothing = []() {}; 
+	
+	// Formats, from their XML and then from the schema cache
+	auto unload = []() {
+		Format::Unload(strfmt("xml/fmt/%s", FormatName.c_str())); 
+		Enum::Unload(strfmt("xml/enum/%s.xml", EnumName.c_str())); 
+	}; 
+	auto loadFormat = []() {
+		Format::GetFormat(FormatName); 
+	}; 
+	unsigned attributes = Format::GetFormat(FormatName)->getAttributes().size(); 
+	scaleResults.push_back(Measure("format.xml", scale, attributes, repeats, unload, loadFormat)); 
+	std::string cacheFilename = strfmt("%s.cache", scale.name.c_str()); 
+	ForgetOutput(cacheFilename); 
+	SchemaCache::Open(cacheFilename); 
+	unload(); 
+	loadFormat(); 
+	SchemaCache::Save(); 
+	SchemaCache::Open(cacheFilename); 
+	scaleResults.push_back(Measure("format.cache", scale, attributes, repeats, unload, loadFormat)); 
+	unload(); 
+	loadFormat(); 
+	
+	// Loading allocates the entries, the string pool and !!strtypelist, and the header and the entry record being read
+	WPDFile file; 
+	scaleResults.push_back(Measure("load", scale, scale.entries, repeats, nothing, [&file]() {
+		file.load(WPDPath); 
+	}, scale.entries + 4)); 
+	scaleResults.push_back(Measure("save", scale, scale.entries, repeats, nothing, [&file]() {
+		file.save("out/bench.wdb"); 
+	}, 2)); 
+	
+	WPDFile patched; 
+	scaleResults.push_back(Measure("patch", scale, (scale.entries + 3) / 4, repeats, [&file, &patched]() {
+		patched = file; 
+	}, [&patched]() {
+		patched.patch(PatchPath, FormatName); 
+	}, (scale.entries + 3) / 4)); 
+	
+	// The same changes as the patch file, through a transaction
+	scaleResults.push_back(Measure("transaction", scale, (scale.entries + 3) / 4, repeats, [&file, &patched]() {
+		patched = file; 
+	}, [&patched, &scale]() {
+		WPDFile::Transaction transaction(patched, *Format::GetFormat(FormatName)); 
+		for (unsigned i = 0 ; i < scale.entries ; i += 4) {
+			std::string entry = strfmt("e%06u", i); 
+			transaction.setString(entry, "text0", strfmt("patched %u", i)); 
+			transaction.setFloat(entry, "rate1", 2.5f); 
+			transaction.setUnsigned(entry, "count2", (i + 1) & 0xFFFF); 
+			transaction.setUnsigned(entry, "kind2", (i + 3) % 16); 
+			transaction.setBoolean(entry, "flag2", true); 
+			transaction.setSigned(entry, "delta3", -5); 
+			transaction.setUnsigned(entry, "mask4", 0x00FF00FF); 
+		}
+		transaction.commit(); 
+	}, 1)); 
+	
+	// Every kind looked up after a patch, which keeps the index built beforehand up to date
+	const Format::Attribute& kind = Format::GetFormat(FormatName)->getAttribute("kind2"); 
+	scaleResults.push_back(Measure("findEntries", scale, 16, repeats, [&file, &patched, &kind]() {
+		patched = file; 
+		patched.findEntries(kind, 0); 
+		patched.patch(PatchPath, FormatName); 
+	}, [&patched, &kind]() {
+		std::size_t found = 0; 
+		for (unsigned value = 0 ; value < 16 ; value++) {
+			found += patched.findEntries(kind, value).size(); 
+		}
+		if (found == 0) {
+			PrintError("Nothing found."); 
+		}
+	}, 0)); 
+	for (unsigned value = 0 ; value < 16 ; value++) {
+		std::set<std::string> scanned; 
+		for (unsigned i = 0 ; i < scale.entries ; i++) {
+			std::string entry = strfmt("e%06u", i); 
+			if (static_cast<const WPDFile&>(patched).getEntryData(entry).getUnsignedMask(kind.offset, kind.bit, kind.size) == value) {
+				scanned.insert(entry); 
+			}
+		}
+		Query query; 
+		std::size_t selected = 0; 
+		if ((query.parse(strfmt("select @id where kind2 = %u", value), Format::GetFormat(FormatName))) && (query.run(patched))) {
+			selected = query.getRows().size() - 1; 
+		}
+		if ((patched.findEntries(kind, value) != scanned) || (selected != scanned.size())) {
+			PrintError("Kind %u: the index finds %zu entries and the query %zu, a scan %zu.", value, patched.findEntries(kind, value).size(), selected, scanned.size()); 
+			LookupsMismatched = true; 
+		}
+	}
+	
+	scaleResults.push_back(Measure("convert.raw", scale, scale.entries, repeats, []() {
+		ForgetOutput("out/bench_raw.txt"); 
+	}, [&file]() {
+		file.convert("out/bench_raw.txt", "*", false); 
+	}, 0)); 
+	scaleResults.push_back(Measure("convert.format", scale, scale.entries, repeats, []() {
+		ForgetOutput("out/bench.txt"); 
+	}, [&file]() {
+		file.convert("out/bench.txt", FormatName, "*", false); 
+	}, 0)); 
+	
+	// Half of the lookups find a string of the pool, the other half append one
+	unsigned lookups = std::min(scale.strings, 2000U); 
+	scaleResults.push_back(Measure("getStringReference", scale, lookups * 2, repeats, [&file, &patched]() {
+		patched = file; 
+	}, [&patched, lookups, &scale]() {
+		for (unsigned i = 0 ; i < lookups ; i++) {
+			patched.getStringReference(strfmt("string %06u", (i * 7919) % scale.strings)); 
+			patched.getStringReference(strfmt("appended %06u", i)); 
+		}
+	}, lookups)); 
+	
+	std::vector<std::string> names; 
+	for (unsigned i = 0 ; i < scale.entries ; i++) {
+		names.push_back(strfmt("e%06u", i)); 
+	}
+	scaleResults.push_back(Measure("strmatch", scale, names.size() * 3, repeats, nothing, [&names]() {
+		unsigned matched = 0; 
+		for (auto it = names.begin() ; it != names.end() ; it++) {
+			matched += strmatch("*", *it); 
+			matched += strmatch("e00*1;e0?5*", *it); 
+			matched += strmatch("x*;*9;e*0?", *it); 
+		}
+		if (matched == 0) {
+			PrintError("Nothing matched."); 
+		}
+	}, 0)); 
+	
+	results.insert(results.end(), scaleResults.begin(), scaleResults.end()); 
+}
+
+int main (int argc, char** argv) {
+	unsigned repeats = 5; 
+	std::string output = "benchmark.json"; 
+	std::string folder = "benchmark"; 
+	Scale custom = { "custom", 0, 0, 0 }; 
+	for (int i = 1 ; i < argc ; i++) {
+		std::string arg = argv[i]; 
+		if ((arg.size() != 2) || (arg[0] != '-') || (i + 1 >= argc)) {
+			Print("Usage: Benchmark [-r repeats] [-o results.json] [-w folder] [-e entries] [-s entry size] [-p strings]"); 
+			return EXIT_FAILURE; 
+		}
+		std::string value = argv[++i]; 
+		unsigned number = 0; 
+		if ((std::strchr("resp", arg[1]) != nullptr) && (ParseUnsigned(value, number) != std::errc())) {
+			Print("Invalid value for %s (\"%s\").", arg.c_str(), value.c_str()); 
+			return EXIT_FAILURE; 
+		}
+		switch (arg[1]) {
+			case 'r': 
+				repeats = std::max(number, 1U); 
+				break; 
+			case 'o': 
+				output = value; 
+				break; 
+			case 'w': 
+				folder = value; 
+				break; 
+			case 'e': 
+				custom.entries = number; 
+				break; 
+			case 's': 
+				custom.entrySize = number; 
+				break; 
+			case 'p': 
+				custom.strings = number; 
+				break; 
+			default: 
+				Print("Unknown option (\"%s\").", arg.c_str()); 
+				return EXIT_FAILURE; 
+		}
+	}
+	
+	std::vector<Scale> scales; 
+	if ((custom.entries > 0) || (custom.entrySize > 0) || (custom.strings > 0)) {
+		custom.entries = std::max(custom.entries, 1U); 
+		custom.entrySize = std::max((custom.entrySize + 3) / 4 * 4, 20U); 
+		custom.strings = std::max(custom.strings, 1U); 
+		scales.push_back(custom); 
+	} else {
+		scales.push_back({ "small", 1000, 64, 500 }); 
+		scales.push_back({ "medium", 10000, 128, 5000 }); 
+		scales.push_back({ "large", 50000, 256, 20000 }); 
+	}
+	
+	// The files are generated in their own folder, the format and enumeration paths are relative
+	std::error_code error; 
+	output = std::filesystem::absolute(output, error).string(); 
+	std::filesystem::create_directories(folder, error); 
+	std::filesystem::current_path(folder, error); 
+	if (error) {
+		Print("Couldn't use folder \"%s\".", folder.c_str()); 
+		return EXIT_FAILURE; 
+	}
+	
+	MemoryStats::Enable(); 
+	std::vector<Result> results; 
+	for (auto scale = scales.begin() ; scale != scales.end() ; scale++) {
+		Print("Scale %s: %u entries of %u bytes, %u strings...", scale->name.c_str(), scale->entries, scale->entrySize, scale->strings); 
+		PrintStart(); 
+		std::size_t first = results.size(); 
+		SetLogLevel(LogLevel::Error); 
+		RunScale(*scale, repeats, results); 
+		SetLogLevel(LogLevel::Info); 
+		for (std::size_t i = first ; i < results.size() ; i++) {
+			const Result& result = results[i]; 
+			double best = result.times.front(); 
+			Print("%-20s %10.3f ms %10.3f ms (median) %14.0f items/s %10llu allocations", result.name.c_str(), best, result.times[result.times.size() / 2], (best > 0)? result.items * 1000.0 / best : 0.0, result.allocations); 
+		}
+		PrintDone(); 
+	}
+	
+	std::string json = "{\n\t\"repeats\": " + strfmt("%u", repeats) + ",\n\t\"results\": [\n"; 
+	for (std::size_t i = 0 ; i < results.size() ; i++) {
+		const Result& result = results[i]; 
+		const Scale& scale = *std::find_if(scales.begin(), scales.end(), [&result](const Scale& scale) {
+			return scale.name == result.scale; 
+		}); 
+		json += strfmt("\t\t{ \"name\": \"%s\", \"scale\": \"%s\", \"entries\": %u, \"entrySize\": %u, \"strings\": %u, \"items\": %llu, \"minMs\": %.4f, \"medianMs\": %.4f, \"maxMs\": %.4f, \"allocations\": %llu }%s\n",
+			result.name.c_str(), scale.name.c_str(), scale.entries, scale.entrySize, scale.strings, result.items,
+			result.times.front(), result.times[result.times.size() / 2], result.times.back(), result.allocations, (i + 1 < results.size())? "," : ""); 
+	}
+	json += "\t]\n}\n"; 
+	
+	bool written; 
+	if (!UpdateFile(output, json, written, true)) {
+		Print("Couldn't write results \"%s\".", output.c_str()); 
+		return EXIT_FAILURE; 
+	}
+	Print("Results written to \"%s\".", output.c_str()); 
+	LogFlush(); 
+	return ((AllocationsExceeded == true) || (LookupsMismatched == true))? EXIT_FAILURE : EXIT_SUCCESS; 
+}
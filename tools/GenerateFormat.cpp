@@ -0,0 +1,241 @@
+
+#include <cctype>
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "../include/Enum.hpp"
+#include "../include/Format.hpp"
+#include "../include/Tools.hpp"
+
+using namespace dbtool; 
+
+// Build-time generator: turns an xml/fmt definition into a header of constexpr offsets and masks 
+// with typed inline accessors (see include/FormatView.hpp). 
+// Usage: GenerateFormat format [output] (run from the folder containing xml/fmt and xml/enum)
+
+static std::string Identifier (const std::string& name, bool capitalize) {
+	std::string id; 
+	bool upper = capitalize; 
+	for (auto it = name.begin() ; it != name.end() ; it++) {
+		unsigned char c = static_cast<unsigned char>(*it); 
+		if (std::isalnum(c)) {
+			id += upper? static_cast<char>(std::toupper(c)) : static_cast<char>(c); 
+			upper = false; 
+		} else {
+			upper = capitalize || (id.size() > 0); 
+		}
+	}
+	if ((id.size() == 0) || (std::isdigit(static_cast<unsigned char>(id[0])))) {
+		id = "_" + id; 
+	}
+	return id; 
+}
+
+static std::string FieldName (const Format::Attribute& attribute) {
+	if (attribute.name[0] == '[') {
+		return strfmt("Raw%04X_%02u_%02u", attribute.offset, attribute.bit, attribute.size); 
+	}
+	return Identifier(attribute.name, true); 
+}
+
+static const char* TypeName (AttributeType type) {
+	switch (type) {
+		case AttributeType::Boolean: 
+			return "Boolean"; 
+		case AttributeType::Signed: 
+			return "Signed"; 
+		case AttributeType::Float: 
+			return "Float"; 
+		case AttributeType::String: 
+			return "String"; 
+		default: 
+			return "Unsigned"; 
+	}
+}
+
+int main (int argc, char** argv) {
+	if (argc < 2) {
+		Print("Usage: GenerateFormat format [output]"); 
+		return EXIT_FAILURE; 
+	}
+	
+	std::string formatName = argv[1]; 
+	std::string baseName = formatName.substr(0, formatName.rfind('.')); 
+	std::string className = Identifier(baseName.substr(baseName.rfind('/') + 1), true); 
+	std::string output = (argc > 2)? argv[2] : strfmt("include/formats/%s.hpp", className.c_str()); 
+	std::string guard = "DBTOOL_FORMAT_" + Identifier(baseName, false); 
+	for (auto it = guard.begin() ; it != guard.end() ; it++) {
+		*it = static_cast<char>(std::toupper(static_cast<unsigned char>(*it))); 
+	}
+	
+	Format* format = Format::GetFormat(formatName); 
+	if (format == nullptr) {
+		return EXIT_FAILURE; 
+	}
+	const Format::Attributes& attributes = format->getAttributes(); 
+	
+	std::string out; 
+	out += "\n// Generated from xml/fmt/" + formatName + " by tools/GenerateFormat, do not edit. \n\n"; 
+	out += "#ifndef " + guard + "\n#define " + guard + "\n\n"; 
+	out += "#include <stdexcept>\n\n"; 
+	out += "#include \"include/Chunk.hpp\"\n#include \"include/Format.hpp\"\n#include \"include/FormatView.hpp\"\n\n"; 
+	out += "namespace dbtool {\n\t\n\tnamespace formats {\n\t\t\n"; 
+	
+	// Integer enumerations become real C++ enumerations
+	std::map<std::string, std::string> enumTypes; 
+	for (auto attribute = attributes.begin() ; attribute != attributes.end() ; attribute++) {
+		if ((attribute->enumName == "") || (enumTypes.count(attribute->enumName) > 0)) {
+			continue; 
+		}
+		Enum* enumInfo = Enum::GetEnum(attribute->enumName); 
+		if ((enumInfo == nullptr) || ((enumInfo->getType() != AttributeType::Unsigned) && (enumInfo->getType() != AttributeType::Signed))) {
+			continue; 
+		}
+		
+		std::string enumType = Identifier(attribute->enumName, true); 
+		enumTypes[attribute->enumName] = enumType; 
+		
+		// Sorting options by value so the generated file is stable
+		std::multimap<long long, std::string> options; 
+		const AttributeValueMap& values = enumInfo->getValues(); 
+		for (auto it = values.begin() ; it != values.end() ; it++) {
+			long long value = (enumInfo->getType() == AttributeType::Unsigned)? static_cast<long long>(it->second.getUnsigned()) : static_cast<long long>(it->second.getSigned()); 
+			options.insert(std::make_pair(value, it->first)); 
+		}
+		
+		out += strfmt("\t\tenum class %s : %s {\n", enumType.c_str(), (enumInfo->getType() == AttributeType::Unsigned)? "unsigned" : "int"); 
+		std::set<std::string> used; 
+		for (auto it = options.begin() ; it != options.end() ; it++) {
+			std::string option = Identifier(it->second, true); 
+			while (used.count(option) > 0) {
+				option += "_"; 
+			}
+			used.insert(option); 
+			out += strfmt("\t\t\t%s = %lld, \n", option.c_str(), it->first); 
+		}
+		out += "\t\t}; \n\t\t\n"; 
+	}
+	
+	// Unique field names, in attribute order
+	std::vector<std::string> fields; 
+	std::set<std::string> usedFields; 
+	for (auto attribute = attributes.begin() ; attribute != attributes.end() ; attribute++) {
+		std::string field = FieldName(*attribute); 
+		while (usedFields.count(field) > 0) {
+			field += "_"; 
+		}
+		usedFields.insert(field); 
+		fields.push_back(field); 
+	}
+	
+	// Read-only view
+	out += strfmt("\t\tclass %sView {\n", className.c_str()); 
+	out += "\t\t\tpublic: \n"; 
+	out += strfmt("\t\t\t\tstatic constexpr unsigned Size = %u; \n\t\t\t\t\n", format->getSize()); 
+	out += "\t\t\t\tstruct Fields {\n"; 
+	unsigned index = 0; 
+	for (auto attribute = attributes.begin() ; attribute != attributes.end() ; attribute++, index++) {
+		out += strfmt("\t\t\t\t\tstruct %s {\n", fields[index].c_str()); 
+		out += strfmt("\t\t\t\t\t\tstatic constexpr unsigned Offset = 0x%04X; \n", attribute->offset); 
+		out += strfmt("\t\t\t\t\t\tstatic constexpr unsigned Bit = %u; \n", attribute->bit); 
+		out += strfmt("\t\t\t\t\t\tstatic constexpr unsigned Length = %u; \n", attribute->size); 
+		out += strfmt("\t\t\t\t\t\tstatic constexpr unsigned Mask = 0x%08X; \n", ((attribute->size < 32)? ((1U << attribute->size) - 1U) : 0xFFFFFFFFU) << attribute->bit); 
+		out += "\t\t\t\t\t}; \n"; 
+	}
+	out += "\t\t\t\t}; \n"; 
+	out += "\t\t\t\n\t\t\tprotected: \n\t\t\t\tconst char* m_data; \n\t\t\t\n\t\t\tpublic: \n"; 
+	out += strfmt("\t\t\t\texplicit %sView (const Chunk& chunk)\n\t\t\t\t\t:m_data(chunk.data()) {\n", className.c_str()); 
+	out += "\t\t\t\t\t\tif (chunk.size() < Size) {\n\t\t\t\t\t\t\tthrow std::range_error(\"Entry is smaller than its format.\"); \n\t\t\t\t\t\t}\n\t\t\t\t\t}\n\t\t\t\t\n"; 
+	
+	index = 0; 
+	for (auto attribute = attributes.begin() ; attribute != attributes.end() ; attribute++, index++) {
+		std::string field = fields[index]; 
+		std::string path = "Fields::" + field; 
+		std::string enumType = (enumTypes.count(attribute->enumName) > 0)? enumTypes[attribute->enumName] : ""; 
+		switch (attribute->type) {
+			case AttributeType::Boolean: 
+				out += strfmt("\t\t\t\tbool get%s () const {\n\t\t\t\t\treturn FormatView::GetBoolean<%s::Offset, %s::Bit>(this->m_data); \n\t\t\t\t}\n", field.c_str(), path.c_str(), path.c_str()); 
+				break; 
+			case AttributeType::Unsigned: 
+			case AttributeType::Signed: {
+				const char* type = (attribute->type == AttributeType::Unsigned)? "unsigned" : "int"; 
+				const char* getter = (attribute->type == AttributeType::Unsigned)? "GetUnsigned" : "GetSigned"; 
+				if (enumType != "") {
+					out += strfmt("\t\t\t\t%s get%s () const {\n\t\t\t\t\treturn static_cast<%s>(FormatView::%s<%s::Offset, %s::Bit, %s::Length>(this->m_data)); \n\t\t\t\t}\n", enumType.c_str(), field.c_str(), enumType.c_str(), getter, path.c_str(), path.c_str(), path.c_str()); 
+				} else {
+					out += strfmt("\t\t\t\t%s get%s () const {\n\t\t\t\t\treturn FormatView::%s<%s::Offset, %s::Bit, %s::Length>(this->m_data); \n\t\t\t\t}\n", type, field.c_str(), getter, path.c_str(), path.c_str(), path.c_str()); 
+				}
+				break; 
+			}
+			case AttributeType::Float: 
+				out += strfmt("\t\t\t\tfloat get%s () const {\n\t\t\t\t\treturn FormatView::GetFloat<%s::Offset>(this->m_data); \n\t\t\t\t}\n", field.c_str(), path.c_str()); 
+				break; 
+			case AttributeType::String: 
+				out += strfmt("\t\t\t\t// Offset of the string in !!string\n"); 
+				out += strfmt("\t\t\t\tunsigned get%s () const {\n\t\t\t\t\treturn FormatView::GetUnsigned<%s::Offset, 0, 32>(this->m_data); \n\t\t\t\t}\n", field.c_str(), path.c_str()); 
+		}
+	}
+	
+	// Checking the generated layout against the runtime format
+	out += "\t\t\t\t\n\t\t\t\ttemplate<typename Field>\n\t\t\t\tstatic bool Matches (const Format::Attribute& attribute, AttributeType type) {\n"; 
+	out += "\t\t\t\t\treturn (attribute.type == type) && (attribute.offset == Field::Offset) && (attribute.bit == Field::Bit) && (attribute.size == Field::Length); \n\t\t\t\t}\n"; 
+	out += "\t\t\t\t\n\t\t\t\t// True if the format loaded at runtime still has the layout this header was generated from\n"; 
+	out += "\t\t\t\tstatic bool Verify (const Format& format) {\n"; 
+	out += "\t\t\t\t\tif (format.getSize() != Size) {\n\t\t\t\t\t\treturn false; \n\t\t\t\t\t}\n"; 
+	out += "\t\t\t\t\ttry {\n"; 
+	index = 0; 
+	for (auto attribute = attributes.begin() ; attribute != attributes.end() ; attribute++, index++) {
+		std::string path = "Fields::" + fields[index]; 
+		out += strfmt("\t\t\t\t\t\tif (!Matches<%s>(format.getAttribute(\"%s\"), AttributeType::%s)) {\n\t\t\t\t\t\t\treturn false; \n\t\t\t\t\t\t}\n", path.c_str(), attribute->name.c_str(), TypeName(attribute->type)); 
+	}
+	out += "\t\t\t\t\t} catch (const std::logic_error& e) {\n\t\t\t\t\t\treturn false; \n\t\t\t\t\t}\n"; 
+	out += "\t\t\t\t\treturn true; \n\t\t\t\t}\n"; 
+	out += "\t\t}; \n\t\t\n"; 
+	
+	// Read-write view
+	out += strfmt("\t\tclass %s : public %sView {\n\t\t\tpublic: \n", className.c_str(), className.c_str()); 
+	out += strfmt("\t\t\t\texplicit %s (Chunk& chunk)\n\t\t\t\t\t:%sView(chunk) {}\n\t\t\t\t\n", className.c_str(), className.c_str()); 
+	index = 0; 
+	for (auto attribute = attributes.begin() ; attribute != attributes.end() ; attribute++, index++) {
+		std::string field = fields[index]; 
+		std::string path = "Fields::" + field; 
+		std::string enumType = (enumTypes.count(attribute->enumName) > 0)? enumTypes[attribute->enumName] : ""; 
+		switch (attribute->type) {
+			case AttributeType::Boolean: 
+				out += strfmt("\t\t\t\tvoid set%s (bool value) {\n\t\t\t\t\tFormatView::SetBoolean<%s::Offset, %s::Bit>(const_cast<char*>(this->m_data), value); \n\t\t\t\t}\n", field.c_str(), path.c_str(), path.c_str()); 
+				break; 
+			case AttributeType::Unsigned: 
+			case AttributeType::Signed: {
+				const char* type = (attribute->type == AttributeType::Unsigned)? "unsigned" : "int"; 
+				const char* setter = (attribute->type == AttributeType::Unsigned)? "SetUnsigned" : "SetSigned"; 
+				if (enumType != "") {
+					out += strfmt("\t\t\t\tvoid set%s (%s value) {\n\t\t\t\t\tFormatView::%s<%s::Offset, %s::Bit, %s::Length>(const_cast<char*>(this->m_data), static_cast<%s>(value)); \n\t\t\t\t}\n", field.c_str(), enumType.c_str(), setter, path.c_str(), path.c_str(), path.c_str(), type); 
+				} else {
+					out += strfmt("\t\t\t\tvoid set%s (%s value) {\n\t\t\t\t\tFormatView::%s<%s::Offset, %s::Bit, %s::Length>(const_cast<char*>(this->m_data), value); \n\t\t\t\t}\n", field.c_str(), type, setter, path.c_str(), path.c_str(), path.c_str()); 
+				}
+				break; 
+			}
+			case AttributeType::Float: 
+				out += strfmt("\t\t\t\tvoid set%s (float value) {\n\t\t\t\t\tFormatView::SetFloat<%s::Offset>(const_cast<char*>(this->m_data), value); \n\t\t\t\t}\n", field.c_str(), path.c_str()); 
+				break; 
+			case AttributeType::String: 
+				out += strfmt("\t\t\t\tvoid set%s (unsigned value) {\n\t\t\t\t\tFormatView::SetUnsigned<%s::Offset, 0, 32>(const_cast<char*>(this->m_data), value); \n\t\t\t\t}\n", field.c_str(), path.c_str()); 
+		}
+	}
+	out += "\t\t}; \n\t\t\n\t}\n\t\n}\n\n#endif\n"; 
+	
+	bool written; 
+	if (!UpdateFile(output, out, written)) {
+		Print("Couldn't write file \"%s\".", output.c_str()); 
+		return EXIT_FAILURE; 
+	}
+	if (written == true) {
+		Print("Generated \"%s\".", output.c_str()); 
+	} else {
+		Print("File \"%s\" is up to date.", output.c_str()); 
+	}
+	return EXIT_SUCCESS; 
+}